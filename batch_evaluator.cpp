@@ -0,0 +1,171 @@
+#include "batch_evaluator.h"
+#include "expr_optimizer.h"
+#include "expr_parser.h"
+#include "thread_pool.h"
+#include <fstream>
+#include <future>
+#include <stdexcept>
+
+namespace {
+
+// ProjectionCollector over several expressions into one trie, remembering the node of each path expression
+class BatchPathCollector : public ProjectionCollector {
+public:
+    using ProjectionCollector::visit;
+
+    std::unordered_map<const Expr *, const ProjectionNode *> nodes;
+
+    void add(const Expr &expr) { collectWhole(expr); }
+
+    ProjectionNode take() { return std::move(root); }
+
+    void visit(const IdentifierExpr &expr) override {
+        ProjectionCollector::visit(expr);
+        record(expr);
+    }
+
+    void visit(const MemberExpr &expr) override {
+        ProjectionCollector::visit(expr);
+        record(expr);
+    }
+
+    void visit(const SubscriptExpr &expr) override {
+        ProjectionCollector::visit(expr);
+        record(expr);
+    }
+
+private:
+    void record(const Expr &expr) {
+        if (current != nullptr) {
+            nodes[&expr] = current;
+        }
+    }
+};
+
+// Navigates every node of the trie below node once. A node whose value is missing, or not of the container
+// type its step needs, is left out: the expressions that reach it evaluate their path themselves and fail
+// with the usual error
+void resolve(const ProjectionNode &node, const JSONValueRef &value,
+             std::unordered_map<const ProjectionNode *, JSONValueRef> &resolved) {
+    if (value.isObject()) {
+        for (const auto &[key, child]: node.members) {
+            if (auto member = value.findKey(key)) {
+                resolve(*child, *member, resolved);
+                resolved.emplace(child.get(), std::move(*member));
+            }
+        }
+    } else if (value.isArray()) {
+        size_t size = value.size();
+        for (const auto &[index, child]: node.elements) {
+            if (index < size) {
+                JSONValueRef element = value.at(index);
+                resolve(*child, element, resolved);
+                resolved.emplace(child.get(), std::move(element));
+            }
+        }
+    }
+}
+
+struct Outcome {
+    std::string output;
+    std::string error;
+};
+
+}
+
+BatchEvaluator::BatchEvaluator(const std::vector<std::string> &expressions) {
+    BatchPathCollector collector;
+    for (const auto &expression: expressions) {
+        try {
+            exprs.push_back(ExprOptimizer::optimize(*ExprParser(expression).parse()));
+            parseErrors.emplace_back();
+            collector.add(*exprs.back());
+        } catch (const std::exception &ex) {
+            exprs.emplace_back();
+            parseErrors.push_back(std::string("Expression parsing error: ") + ex.what());
+        }
+    }
+    pathNodes = std::move(collector.nodes);
+    paths = collector.take();
+}
+
+std::vector<std::string> BatchEvaluator::readExpressions(const std::string &path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Could not open expression file: " + path);
+    }
+    std::vector<std::string> expressions;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.find_first_not_of(" \t") != std::string::npos) {
+            expressions.push_back(line);
+        }
+    }
+    if (file.bad()) {
+        throw std::runtime_error("Could not read expression file: " + path);
+    }
+    return expressions;
+}
+
+size_t BatchEvaluator::run(const JSONValue &root, std::ostream &out, std::ostream &errors) const {
+    return run(JSONValueRef::to(root), &root, nullptr, out, errors);
+}
+
+size_t BatchEvaluator::run(const JSONTape &tape, std::ostream &out, std::ostream &errors) const {
+    return run(JSONValueRef::to(tape.root()), nullptr, &tape, out, errors);
+}
+
+size_t BatchEvaluator::run(const JSONValueRef &document, const JSONValue *root, const JSONTape *tape,
+                           std::ostream &out, std::ostream &errors) const {
+    std::unordered_map<const ProjectionNode *, JSONValueRef> resolved;
+    resolve(paths, document, resolved);
+    PrecomputedResults precomputed;
+    for (const auto &[expr, node]: pathNodes) {
+        auto found = resolved.find(node);
+        if (found != resolved.end()) {
+            precomputed.emplace(expr, found->second);
+        }
+    }
+
+    // Expressions of a batch often repeat a subexpression, e.g. an aggregate they each compare against
+    ExprCache cache;
+    LookupIndexes indexes;
+    auto evaluate = [&](size_t i) {
+        Outcome outcome;
+        if (!exprs[i]) {
+            outcome.error = parseErrors[i];
+            return outcome;
+        }
+        try {
+            ExprEvaluator evaluator = tape != nullptr ? ExprEvaluator(*tape, &precomputed)
+                                                      : ExprEvaluator(*root, &precomputed);
+            evaluator.setCache(&cache, 0);
+            evaluator.setLookupIndexes(&indexes);
+            exprs[i]->accept(evaluator);
+            outcome.output = ExprEvaluator::jsonValueToString(evaluator.result);
+        } catch (const std::exception &ex) {
+            outcome.error = std::string("Evaluation error: ") + ex.what();
+        }
+        return outcome;
+    };
+
+    // evaluate does not throw, so every submitted expression is awaited
+    ThreadPool &pool = ThreadPool::shared();
+    std::vector<std::future<Outcome>> futures(exprs.size());
+    for (size_t i = 1; i < exprs.size(); ++i) {
+        futures[i] = pool.submit([&evaluate, i] { return evaluate(i); });
+    }
+    size_t failures = 0;
+    for (size_t i = 0; i < exprs.size(); ++i) {
+        Outcome outcome = i == 0 ? evaluate(0) : pool.wait(futures[i]);
+        out << outcome.output << '\n';
+        if (!outcome.error.empty()) {
+            errors << "Expression " << i + 1 << ": " << outcome.error << '\n';
+            ++failures;
+        }
+    }
+    return failures;
+}
@@ -0,0 +1,46 @@
+#ifndef BATCH_EVALUATOR_H
+#define BATCH_EVALUATOR_H
+
+#include "expr.h"
+#include "expr_evaluator.h"
+#include "expr_projection.h"
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Evaluates many expressions against one parse of a document (-f or several expression arguments). The
+// static paths of all expressions are merged into one ProjectionNode trie, which is also what the document is
+// parsed with. Each trie node is resolved against the document once, so a prefix the expressions share is
+// navigated once, and the expressions then run concurrently with their paths precomputed and call and operator
+// results shared through an ExprCache. Lookups with find() share the hash indexes they build
+class BatchEvaluator {
+public:
+    // Parses and optimizes every expression. One that does not parse is reported by run
+    explicit BatchEvaluator(const std::vector<std::string> &expressions);
+
+    // Non-blank lines of an expression file (-f); throws std::runtime_error when it cannot be read
+    static std::vector<std::string> readExpressions(const std::string &path);
+
+    // Union of the paths of all expressions
+    [[nodiscard]] const ProjectionNode &projection() const { return paths; }
+
+    // Writes one line per expression to out, in order: the result, or an empty line when the expression
+    // fails, with "Expression <n>: <error>" on errors. Returns the number of failed expressions
+    size_t run(const JSONValue &root, std::ostream &out, std::ostream &errors) const;
+
+    size_t run(const JSONTape &tape, std::ostream &out, std::ostream &errors) const;
+
+private:
+    // nullptr where the expression did not parse, with the message in parseErrors
+    std::vector<ExprPtr> exprs;
+    std::vector<std::string> parseErrors;
+    ProjectionNode paths;
+    // Trie node of every static path node of the expressions
+    std::unordered_map<const Expr *, const ProjectionNode *> pathNodes;
+
+    size_t run(const JSONValueRef &document, const JSONValue *root, const JSONTape *tape, std::ostream &out,
+               std::ostream &errors) const;
+};
+
+#endif // BATCH_EVALUATOR_H
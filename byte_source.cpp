@@ -0,0 +1,44 @@
+#include "byte_source.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+FileByteSource::FileByteSource(const std::string &path) : fd(STDIN_FILENO), owned(false) {
+    if (path == "-") {
+        return;
+    }
+    fd = ::open(path.c_str(), O_RDONLY); // NOLINT
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open JSON file: " + path + " (" + std::strerror(errno) + ")");
+    }
+    owned = true;
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+FileByteSource::~FileByteSource() {
+    if (owned) {
+        ::close(fd);
+    }
+}
+
+size_t FileByteSource::read(char *data, size_t size) {
+    while (true) {
+        ssize_t count = ::read(fd, data, size);
+        if (count >= 0) {
+            return static_cast<size_t>(count);
+        }
+        if (errno != EINTR) {
+            throw std::runtime_error(std::string("Failed to read JSON input: ") + std::strerror(errno));
+        }
+    }
+}
+
+size_t MemoryByteSource::read(char *out, size_t size) {
+    size_t count = std::min(size, data.size() - position);
+    std::memcpy(out, data.data() + position, count);
+    position += count;
+    return count;
+}
@@ -0,0 +1,47 @@
+#ifndef BYTE_SOURCE_H
+#define BYTE_SOURCE_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Sequential source of input bytes for the streaming reader
+class ByteSource {
+public:
+    virtual ~ByteSource() = default;
+
+    // Reads up to size bytes into data. Returns 0 only at the end of the input
+    virtual size_t read(char *data, size_t size) = 0;
+};
+
+// Reads a file (or stdin for "-") with plain read(2) calls, so memory use is whatever buffer the caller passes in
+class FileByteSource : public ByteSource {
+public:
+    explicit FileByteSource(const std::string &path);
+
+    ~FileByteSource() override;
+
+    FileByteSource(const FileByteSource &) = delete;
+
+    FileByteSource &operator=(const FileByteSource &) = delete;
+
+    size_t read(char *data, size_t size) override;
+
+private:
+    int fd;
+    bool owned;
+};
+
+// Serves bytes that are already in memory (e.g. a mapped file), which have to outlive it
+class MemoryByteSource : public ByteSource {
+public:
+    explicit MemoryByteSource(std::string_view data) : data(data) {}
+
+    size_t read(char *out, size_t size) override;
+
+private:
+    std::string_view data;
+    size_t position = 0;
+};
+
+#endif // BYTE_SOURCE_H
@@ -0,0 +1,109 @@
+#include "cli_options.h"
+#include <stdexcept>
+#include <vector>
+
+std::string usage() {
+    return "Usage: ./json_eval [--tape | --stream | --parallel | --ndjson [--unordered]] [--snapshot <file>] [--threads <n>] [--explain] "
+           "<json_file> <expression>...\n"
+           "       ./json_eval [--tape | --parallel] [--snapshot <file>] [--threads <n>] -f <expression_file> <json_file>\n"
+           "       ./json_eval [--tape | --parallel] [--snapshot <file>] [--threads <n>] --serve <socket | -> <json_file>";
+}
+
+Options parseOptions(int argc, char *argv[]) {
+    Options options;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i]; // NOLINT
+        if (arg == "--tape") {
+            options.tape = true;
+        } else if (arg == "--stream") {
+            options.stream = true;
+        } else if (arg == "--parallel") {
+            options.parallel = true;
+        } else if (arg == "--ndjson") {
+            options.ndjson = true;
+        } else if (arg == "--unordered") {
+            options.unordered = true;
+        } else if (arg == "--snapshot") {
+            if (i + 1 == argc) {
+                throw std::runtime_error("--snapshot needs a file name");
+            }
+            options.snapshot = argv[++i]; // NOLINT
+        } else if (arg == "--serve") {
+            if (i + 1 == argc) {
+                throw std::runtime_error("--serve needs a socket path or -");
+            }
+            options.serve = argv[++i]; // NOLINT
+            if (options.serve.empty()) {
+                throw std::runtime_error("--serve needs a socket path or -");
+            }
+        } else if (arg == "-f") {
+            if (i + 1 == argc) {
+                throw std::runtime_error("-f needs an expression file");
+            }
+            options.expressionFile = argv[++i]; // NOLINT
+        } else if (arg == "--explain") {
+            options.explain = true;
+        } else if (arg == "--threads") {
+            if (i + 1 == argc) {
+                throw std::runtime_error("--threads needs a thread count");
+            }
+            std::string count = argv[++i]; // NOLINT
+            if (count.empty() || count.size() > 6 || count.find_first_not_of("0123456789") != std::string::npos ||
+                std::stoul(count) == 0) {
+                throw std::runtime_error("--threads needs a positive thread count, got: " + count);
+            }
+            options.threads = std::stoul(count);
+        } else if (arg.size() > 2 && arg.compare(0, 2, "--") == 0) {
+            throw std::runtime_error("Unknown option: " + arg);
+        } else {
+            positional.push_back(arg);
+        }
+    }
+    if (options.tape + options.stream + options.parallel + options.ndjson > 1) {
+        throw std::runtime_error("Only one of --tape, --stream, --parallel and --ndjson can be given");
+    }
+    if (options.unordered && !options.ndjson) {
+        throw std::runtime_error("--unordered can only be given with --ndjson");
+    }
+    if (!options.snapshot.empty()) {
+        if (options.stream || options.parallel || options.ndjson) {
+            throw std::runtime_error("--snapshot can only be combined with --tape");
+        }
+        options.tape = true;
+    }
+    if (!options.serve.empty()) {
+        if (options.stream || options.ndjson || options.explain || !options.expressionFile.empty()) {
+            throw std::runtime_error("--serve cannot be combined with --stream, --ndjson, --explain or -f");
+        }
+        if (positional.size() != 1) {
+            throw std::runtime_error("Expected a JSON file to serve");
+        }
+        if (options.serve == "-" && positional[0] == "-") {
+            throw std::runtime_error("--serve - reads requests from stdin, so the JSON file cannot be stdin");
+        }
+        options.jsonFile = positional[0];
+        return options;
+    }
+    if (!options.expressionFile.empty()) {
+        if (positional.size() != 1) {
+            throw std::runtime_error("Expected a JSON file, with -f giving the expressions");
+        }
+    } else if (positional.size() < 2) {
+        throw std::runtime_error("Expected a JSON file and an expression");
+    }
+    options.jsonFile = positional[0];
+    options.expressions.assign(positional.begin() + 1, positional.end());
+    bool batch = !options.expressionFile.empty() || options.expressions.size() > 1;
+    if (batch && (options.stream || options.ndjson || options.explain)) {
+        throw std::runtime_error("Several expressions cannot be combined with --stream, --ndjson or --explain");
+    }
+
+    // Remove leading and trailing quotation marks if present
+    for (std::string &expression: options.expressions) {
+        if (expression.size() >= 2 && expression.front() == '"' && expression.back() == '"') {
+            expression = expression.substr(1, expression.size() - 2);
+        }
+    }
+    return options;
+}
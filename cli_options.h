@@ -0,0 +1,40 @@
+#ifndef CLI_OPTIONS_H
+#define CLI_OPTIONS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct Options {
+    std::string jsonFile;
+    // One expression, or several that are evaluated as a batch against one parse of the file
+    std::vector<std::string> expressions;
+    // File with one expression per line to evaluate as a batch (-f)
+    std::string expressionFile;
+    // Parse into a JSONTape instead of a JSONValue tree
+    bool tape = false;
+    // Evaluate while reading the file instead of parsing it first
+    bool stream = false;
+    // Split large containers across threads while parsing
+    bool parallel = false;
+    // Treat the file as JSON Lines and evaluate the expression for every record
+    bool ndjson = false;
+    // With ndjson, write results as records finish instead of in input order
+    bool unordered = false;
+    // Binary snapshot of the parsed document to load, or to write when it is missing or stale. Implies tape
+    std::string snapshot;
+    // Print the optimized expression instead of evaluating it
+    bool explain = false;
+    // Unix socket to answer expressions on, "-" for stdin/stdout, instead of evaluating one expression
+    std::string serve;
+    // Threads used for parallel evaluation, parsing and JSON Lines records, the calling thread included.
+    // 0 uses every hardware thread
+    size_t threads = 0;
+};
+
+// Throws std::runtime_error on a malformed command line
+Options parseOptions(int argc, char *argv[]);
+
+std::string usage();
+
+#endif // CLI_OPTIONS_H
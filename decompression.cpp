@@ -0,0 +1,244 @@
+#include "decompression.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#ifdef JSON_EVAL_WITH_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef JSON_EVAL_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+constexpr std::string_view gzipMagic = "\x1f\x8b";
+constexpr std::string_view zstdMagic = "\x28\xb5\x2f\xfd";
+
+// Hands out bytes that were read ahead for detection before the rest of the source
+class PrefixedByteSource : public ByteSource {
+public:
+    PrefixedByteSource(std::string prefix, std::unique_ptr<ByteSource> rest)
+            : prefix(std::move(prefix)), rest(std::move(rest)) {}
+
+    size_t read(char *data, size_t size) override {
+        if (position < prefix.size()) {
+            size_t count = std::min(size, prefix.size() - position);
+            std::memcpy(data, prefix.data() + position, count);
+            position += count;
+            return count;
+        }
+        return rest->read(data, size);
+    }
+
+private:
+    std::string prefix;
+    size_t position = 0;
+    std::unique_ptr<ByteSource> rest;
+};
+
+}
+
+Compression detectCompression(std::string_view prefix) {
+    if (prefix.substr(0, gzipMagic.size()) == gzipMagic) {
+        return Compression::Gzip;
+    }
+    if (prefix.substr(0, zstdMagic.size()) == zstdMagic) {
+        return Compression::Zstd;
+    }
+    return Compression::None;
+}
+
+DecompressingByteSource::DecompressingByteSource(std::unique_ptr<ByteSource> compressed, Compression compression)
+        : compressed(std::move(compressed)), compression(compression), worker([this]() { run(); }) {}
+
+DecompressingByteSource::~DecompressingByteSource() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    spaceReady.notify_one();
+    worker.join();
+}
+
+size_t DecompressingByteSource::read(char *data, size_t size) {
+    while (offset == current.size()) {
+        std::unique_lock<std::mutex> lock(mutex);
+        blockReady.wait(lock, [this]() { return !blocks.empty() || finished; });
+        if (blocks.empty()) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+            return 0;
+        }
+        current = std::move(blocks.front());
+        blocks.pop_front();
+        offset = 0;
+        spaceReady.notify_one();
+    }
+    size_t count = std::min(size, current.size() - offset);
+    std::memcpy(data, current.data() + offset, count);
+    offset += count;
+    return count;
+}
+
+void DecompressingByteSource::run() {
+    try {
+        if (compression == Compression::Gzip) {
+            inflateGzip();
+        } else {
+            inflateZstd();
+        }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        error = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    finished = true;
+    blockReady.notify_one();
+}
+
+bool DecompressingByteSource::push(std::string block) {
+    std::unique_lock<std::mutex> lock(mutex);
+    spaceReady.wait(lock, [this]() { return blocks.size() < maxQueuedBlocks || stopping; });
+    if (stopping) {
+        return false;
+    }
+    blocks.push_back(std::move(block));
+    blockReady.notify_one();
+    return true;
+}
+
+void DecompressingByteSource::inflateGzip() {
+#ifdef JSON_EVAL_WITH_ZLIB
+    z_stream stream{};
+    // 15 window bits plus 32 detects the gzip (or zlib) header
+    if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+        throw std::runtime_error("Failed to initialize gzip decompression");
+    }
+    std::vector<char> input(blockSize);
+    bool memberEnded = false;
+    bool outputFull = false;
+    try {
+        while (true) {
+            // Read more only once the previous call neither left input nor filled its output
+            if (stream.avail_in == 0 && !outputFull) {
+                size_t count = compressed->read(input.data(), input.size());
+                if (count == 0) {
+                    break;
+                }
+                stream.next_in = reinterpret_cast<Bytef *>(input.data()); // NOLINT
+                stream.avail_in = static_cast<uInt>(count);
+            }
+            if (memberEnded) {
+                // Concatenated gzip members decompress to the concatenation of their contents
+                inflateReset(&stream);
+                memberEnded = false;
+            }
+            std::string block(blockSize, '\0');
+            stream.next_out = reinterpret_cast<Bytef *>(&block[0]); // NOLINT
+            stream.avail_out = static_cast<uInt>(block.size());
+            int status = inflate(&stream, Z_NO_FLUSH);
+            if (status == Z_STREAM_END) {
+                memberEnded = true;
+            } else if (status != Z_OK && status != Z_BUF_ERROR) {
+                throw std::runtime_error(std::string("Invalid gzip data: ") +
+                                         (stream.msg != nullptr ? stream.msg : "corrupt stream"));
+            }
+            // A member can end exactly as the output fills. Nothing of it is left to flush then, and the next
+            // member starts only if more input follows
+            outputFull = status != Z_STREAM_END && stream.avail_out == 0;
+            block.resize(block.size() - stream.avail_out);
+            if (!block.empty() && !push(std::move(block))) {
+                inflateEnd(&stream);
+                return;
+            }
+        }
+        if (!memberEnded) {
+            throw std::runtime_error("Invalid gzip data: unexpected end of input");
+        }
+    } catch (...) {
+        inflateEnd(&stream);
+        throw;
+    }
+    inflateEnd(&stream);
+#else
+    throw std::runtime_error("gzip input is not supported: json_eval was built without zlib");
+#endif
+}
+
+void DecompressingByteSource::inflateZstd() {
+#ifdef JSON_EVAL_WITH_ZSTD
+    std::unique_ptr<ZSTD_DStream, size_t (*)(ZSTD_DStream *)> stream(ZSTD_createDStream(), ZSTD_freeDStream);
+    if (stream == nullptr || ZSTD_isError(ZSTD_initDStream(stream.get()))) {
+        throw std::runtime_error("Failed to initialize zstd decompression");
+    }
+    std::vector<char> input(ZSTD_DStreamInSize());
+    ZSTD_inBuffer in{input.data(), 0, 0};
+    // Nonzero while a frame is incomplete
+    size_t remaining = 0;
+    bool outputFull = false;
+    while (true) {
+        if (in.pos == in.size && !outputFull) {
+            size_t count = compressed->read(input.data(), input.size());
+            if (count == 0) {
+                break;
+            }
+            in = {input.data(), count, 0};
+        }
+        std::string block(blockSize, '\0');
+        ZSTD_outBuffer out{&block[0], block.size(), 0};
+        remaining = ZSTD_decompressStream(stream.get(), &out, &in);
+        if (ZSTD_isError(remaining)) {
+            throw std::runtime_error(std::string("Invalid zstd data: ") + ZSTD_getErrorName(remaining));
+        }
+        outputFull = out.pos == out.size;
+        block.resize(out.pos);
+        if (!block.empty() && !push(std::move(block))) {
+            return;
+        }
+    }
+    if (remaining != 0) {
+        throw std::runtime_error("Invalid zstd data: unexpected end of input");
+    }
+#else
+    throw std::runtime_error("zstd input is not supported: json_eval was built without libzstd");
+#endif
+}
+
+std::unique_ptr<ByteSource> openByteSource(const std::string &path) {
+    auto file = std::make_unique<FileByteSource>(path);
+    // Pipes may deliver the magic number in pieces
+    std::string prefix(zstdMagic.size(), '\0');
+    size_t length = 0;
+    while (length < prefix.size()) {
+        size_t count = file->read(&prefix[length], prefix.size() - length);
+        if (count == 0) {
+            break;
+        }
+        length += count;
+    }
+    prefix.resize(length);
+    Compression compression = detectCompression(prefix);
+    auto source = std::make_unique<PrefixedByteSource>(std::move(prefix), std::move(file));
+    if (compression == Compression::None) {
+        return source;
+    }
+    return std::make_unique<DecompressingByteSource>(std::move(source), compression);
+}
+
+std::string decompress(std::string_view compressed, Compression compression) {
+    DecompressingByteSource source(std::make_unique<MemoryByteSource>(compressed), compression);
+    std::string output;
+    while (true) {
+        size_t size = output.size();
+        output.resize(size + DecompressingByteSource::blockSize);
+        size_t count = source.read(&output[size], DecompressingByteSource::blockSize);
+        output.resize(size + count);
+        if (count == 0) {
+            return output;
+        }
+    }
+}
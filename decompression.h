@@ -0,0 +1,76 @@
+#ifndef DECOMPRESSION_H
+#define DECOMPRESSION_H
+
+#include "byte_source.h"
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+enum class Compression {
+    None, Gzip, Zstd
+};
+
+// Recognizes gzip and zstd input by its magic bytes. A prefix shorter than a magic number is not compressed
+Compression detectCompression(std::string_view prefix);
+
+// Decompresses another source on a background thread. Decompressed blocks are queued (at most
+// maxQueuedBlocks of them) and handed out by read, so decompression runs ahead of the consumer while it parses.
+// Errors in the compressed data are thrown from read, after the blocks decoded before them.
+// Zstd needs json_eval to be built with libzstd; without it, zstd input throws std::runtime_error
+class DecompressingByteSource : public ByteSource {
+public:
+    static constexpr size_t blockSize = 1 << 18;
+    static constexpr size_t maxQueuedBlocks = 4;
+
+    DecompressingByteSource(std::unique_ptr<ByteSource> compressed, Compression compression);
+
+    ~DecompressingByteSource() override;
+
+    DecompressingByteSource(const DecompressingByteSource &) = delete;
+
+    DecompressingByteSource &operator=(const DecompressingByteSource &) = delete;
+
+    size_t read(char *data, size_t size) override;
+
+private:
+    std::unique_ptr<ByteSource> compressed;
+    Compression compression;
+
+    std::mutex mutex;
+    std::condition_variable blockReady;
+    std::condition_variable spaceReady;
+    std::deque<std::string> blocks;
+    bool finished = false;
+    bool stopping = false;
+    std::exception_ptr error;
+
+    // Block being handed out by read, owned by the consumer
+    std::string current;
+    size_t offset = 0;
+
+    // Started last, once everything it uses is initialized
+    std::thread worker;
+
+    void run();
+
+    void inflateGzip();
+
+    void inflateZstd();
+
+    // Queues a decompressed block. Returns false when the consumer has gone away
+    bool push(std::string block);
+};
+
+// Opens a file (or stdin for "-") for streaming and decompresses it when it is gzip or zstd
+std::unique_ptr<ByteSource> openByteSource(const std::string &path);
+
+// Decompresses a whole gzip or zstd document that is already in memory
+std::string decompress(std::string_view compressed, Compression compression);
+
+#endif // DECOMPRESSION_H
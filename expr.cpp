@@ -28,3 +28,7 @@ void CallExpr::accept(ExprVisitor &visitor) const {
 void BinaryExpr::accept(ExprVisitor &visitor) const {
     visitor.visit(*this);
 }
+
+void WildcardExpr::accept(ExprVisitor &visitor) const {
+    visitor.visit(*this);
+}
@@ -1,6 +1,8 @@
 #ifndef EXPR_H
 #define EXPR_H
 
+#include <cstdint>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -17,6 +19,10 @@ public:
     virtual ~Expr() = default;
 
     virtual void accept(ExprVisitor &visitor) const = 0;
+
+    // Set by ExprOptimizer on nodes with more than one parent. Evaluators compute such a node once per
+    // document and reuse its value
+    bool shared = false;
 };
 
 class IdentifierExpr : public Expr {
@@ -31,8 +37,11 @@ public:
 class NumberExpr : public Expr {
 public:
     double value;
+    // Set for integer literals that fit into int64_t, so integer arithmetic stays exact
+    std::optional<int64_t> integer;
 
-    explicit NumberExpr(double value) : value(value) {}
+    explicit NumberExpr(double value, std::optional<int64_t> integer = std::nullopt)
+            : value(value), integer(integer) {}
 
     void accept(ExprVisitor &visitor) const override;
 };
@@ -94,4 +103,28 @@ public:
     void accept(ExprVisitor &visitor) const override;
 };
 
+// array[*] followed by steps, e.g. items[*].price: the steps are applied to every element of the array, and
+// the values they reach form the result array. A nested [*] step flattens, so a[*].b[*].c holds every c.
+// Elements a step does not apply to (a missing member, an index out of range, a value of the wrong type) are
+// left out
+class WildcardExpr : public Expr {
+public:
+    struct Step {
+        enum class Kind {
+            Member, Index, Each
+        };
+        Kind kind;
+        // Member name of a .member step
+        std::string member;
+        // Index of an [index] step, evaluated against the document
+        ExprPtr index;
+    };
+    ExprPtr array;
+    std::vector<Step> steps;
+
+    WildcardExpr(ExprPtr array, std::vector<Step> steps) : array(std::move(array)), steps(std::move(steps)) {}
+
+    void accept(ExprVisitor &visitor) const override;
+};
+
 #endif // EXPR_H
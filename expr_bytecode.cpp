@@ -0,0 +1,497 @@
+#include "expr_bytecode.h"
+#include "expr_functions.h"
+#include "expr_optimizer.h"
+#include "expr_visitor.h"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+
+namespace {
+
+void printSteps(std::ostream &out, const std::vector<WildcardStep> &steps) {
+    out << "[*]";
+    for (const WildcardStep &step: steps) {
+        if (step.kind == WildcardExpr::Step::Kind::Member) {
+            out << '.' << step.member;
+        } else if (step.kind == WildcardExpr::Step::Kind::Index) {
+            out << "[r" << step.index << ']';
+        } else {
+            out << "[*]";
+        }
+    }
+}
+
+}
+
+// Compiles the expression into register 'target'. Registers at and above 'next' are free; a subexpression
+// that needs temporaries takes them from there and gives them back when it is done. Function arguments go
+// to consecutive registers, so a call passes them as one range. Shared nodes get the registers right after
+// register 0, below all temporaries
+class ExprCompiler : public ExprVisitor {
+public:
+    explicit ExprCompiler(ExprProgram &program, size_t sharedCount)
+            : program(program), nextShared(1), next(static_cast<uint32_t>(sharedCount) + 1) {
+        program.registers = next;
+    }
+
+    void compile(const Expr &expr, uint32_t register_) {
+        uint32_t saved = std::exchange(target, register_);
+        if (!expr.shared) {
+            expr.accept(*this);
+        } else {
+            auto [found, first] = sharedRegisters.emplace(&expr, nextShared);
+            if (first) {
+                target = nextShared++;
+                expr.accept(*this);
+                target = register_;
+            }
+            emit(OpCode::Copy, found->second, 0);
+        }
+        target = saved;
+    }
+
+    uint32_t allocate(uint32_t count) {
+        uint32_t first = next;
+        next += count;
+        program.registers = std::max<size_t>(program.registers, next);
+        return first;
+    }
+
+    void visit(const IdentifierExpr &expr) override {
+        if (expr.name == "null") {
+            emitConstant(nullptr);
+        } else if (expr.name == "true") {
+            emitConstant(true);
+        } else if (expr.name == "false") {
+            emitConstant(false);
+        } else {
+            emit(OpCode::GetRootPath, 0, path({&expr.name}));
+        }
+    }
+
+    void visit(const NumberExpr &expr) override {
+        if (expr.integer) {
+            emitConstant(*expr.integer);
+        } else {
+            emitConstant(expr.value);
+        }
+    }
+
+    void visit(const StringExpr &expr) override {
+        emitConstant(expr.value);
+    }
+
+    // The chain of member accesses below expr, down to the first node that is not an unshared MemberExpr,
+    // becomes one path walk. A chain that starts at a document identifier walks from the root
+    void visit(const MemberExpr &expr) override {
+        std::vector<const std::string *> names{&expr.member};
+        const Expr *base = expr.object.get();
+        for (auto *member = dynamic_cast<const MemberExpr *>(base); member != nullptr && !member->shared;
+             member = dynamic_cast<const MemberExpr *>(base)) {
+            names.insert(names.begin(), &member->member);
+            base = member->object.get();
+        }
+        const auto *identifier = dynamic_cast<const IdentifierExpr *>(base);
+        if (identifier != nullptr && !identifier->shared && !isLiteral(identifier->name)) {
+            names.insert(names.begin(), &identifier->name);
+            emit(OpCode::GetRootPath, 0, path(names));
+            return;
+        }
+        compile(*base, target);
+        emit(OpCode::GetPath, target, path(names));
+    }
+
+    void visit(const SubscriptExpr &expr) override {
+        compile(*expr.array, target);
+        uint32_t index = allocate(1);
+        compile(*expr.index, index);
+        emit(OpCode::GetIndex, target, index);
+        next = index;
+    }
+
+    void visit(const CallExpr &expr) override {
+        OpCode op = callOpCode(expr.callee);
+        if (compileProjectedCall(expr, op)) {
+            return;
+        }
+        uint32_t first = allocate(static_cast<uint32_t>(expr.arguments.size()));
+        for (size_t i = 0; i < expr.arguments.size(); ++i) {
+            compile(*expr.arguments[i], first + static_cast<uint32_t>(i));
+        }
+        emit(op, first, static_cast<uint32_t>(expr.arguments.size()));
+        next = first;
+    }
+
+    void visit(const BinaryExpr &expr) override {
+        compile(*expr.left, target);
+        uint32_t right = allocate(1);
+        compile(*expr.right, right);
+        emit(operatorOpCode(expr.op), target, right);
+        next = right;
+    }
+
+    void visit(const WildcardExpr &expr) override {
+        compile(*expr.array, target);
+        uint32_t first = next;
+        emit(OpCode::Project, target, compileSteps(expr));
+        next = first;
+    }
+
+private:
+    ExprProgram &program;
+    std::unordered_map<const Expr *, uint32_t> sharedRegisters;
+    uint32_t nextShared;
+    uint32_t target = 0;
+    uint32_t next;
+
+    void emit(OpCode op, uint32_t a, uint32_t b) {
+        program.code.push_back({op, target, a, b});
+    }
+
+    // Steps of expr into wildcards. Index steps get registers of their own, which stay allocated
+    uint32_t compileSteps(const WildcardExpr &expr) {
+        std::vector<WildcardStep> steps;
+        for (const auto &step: expr.steps) {
+            steps.push_back({step.kind, {}, 0});
+            if (step.kind == WildcardExpr::Step::Kind::Member) {
+                steps.back().member = JSONString::prehashed(step.member);
+            } else if (step.kind == WildcardExpr::Step::Kind::Index) {
+                steps.back().index = allocate(1);
+                compile(*step.index, static_cast<uint32_t>(steps.back().index));
+            }
+        }
+        program.wildcards.push_back(std::move(steps));
+        return static_cast<uint32_t>(program.wildcards.size() - 1);
+    }
+
+    // A call of size or of a numeric aggregate with projected arguments becomes one CallProjected, as
+    // ExprEvaluator fuses it. A shared projection is left alone, since its register is read again later.
+    // Returns false for other calls
+    bool compileProjectedCall(const CallExpr &expr, OpCode op) {
+        BuiltinFunction function = findBuiltinFunction(expr.callee);
+        std::optional<size_t> aggregated;
+        if (function == builtinSize && expr.arguments.size() == 1) {
+            aggregated = 1;
+        } else if (isNumericAggregate(function)) {
+            aggregated = aggregatedArguments(function, expr.arguments.size());
+        }
+        if (!aggregated) {
+            return false;
+        }
+        std::vector<const WildcardExpr *> wildcards;
+        for (size_t i = 0; i < *aggregated; ++i) {
+            const auto *wildcard = dynamic_cast<const WildcardExpr *>(expr.arguments[i].get());
+            wildcards.push_back(wildcard != nullptr && !wildcard->shared ? wildcard : nullptr);
+        }
+        if (std::all_of(wildcards.begin(), wildcards.end(), [](const WildcardExpr *w) { return w == nullptr; })) {
+            return false;
+        }
+
+        auto count = static_cast<uint32_t>(expr.arguments.size());
+        ExprProgram::ProjectedCall call{op, function, count, {}};
+        uint32_t first = allocate(count);
+        for (size_t i = 0; i < expr.arguments.size(); ++i) {
+            auto argument = first + static_cast<uint32_t>(i);
+            if (i < wildcards.size() && wildcards[i] != nullptr) {
+                compile(*wildcards[i]->array, argument);
+                call.projections.emplace_back(compileSteps(*wildcards[i]));
+            } else {
+                compile(*expr.arguments[i], argument);
+                if (i < wildcards.size()) {
+                    call.projections.emplace_back();
+                }
+            }
+        }
+        program.projectedCalls.push_back(std::move(call));
+        emit(OpCode::CallProjected, first, static_cast<uint32_t>(program.projectedCalls.size() - 1));
+        next = first;
+        return true;
+    }
+
+    void emitConstant(JSONValue value) {
+        program.constants.push_back(std::move(value));
+        emit(OpCode::LoadConstant, static_cast<uint32_t>(program.constants.size() - 1), 0);
+    }
+
+    uint32_t path(const std::vector<const std::string *> &names) {
+        std::vector<JSONString> keys;
+        for (const std::string *name: names) {
+            keys.push_back(JSONString::prehashed(*name));
+        }
+        program.paths.push_back(std::move(keys));
+        return static_cast<uint32_t>(program.paths.size() - 1);
+    }
+
+    static bool isLiteral(const std::string &name) {
+        return name == "null" || name == "true" || name == "false";
+    }
+
+    static OpCode callOpCode(const std::string &callee) {
+        BuiltinFunction function = findBuiltinFunction(callee);
+        if (function == builtinMin) {
+            return OpCode::CallMin;
+        }
+        if (function == builtinMax) {
+            return OpCode::CallMax;
+        }
+        if (function == builtinSize) {
+            return OpCode::CallSize;
+        }
+        if (function == builtinAverage) {
+            return OpCode::CallAverage;
+        }
+        if (function == builtinSum) {
+            return OpCode::CallSum;
+        }
+        if (function == builtinCount) {
+            return OpCode::CallCount;
+        }
+        if (function == builtinVariance) {
+            return OpCode::CallVariance;
+        }
+        if (function == builtinStddev) {
+            return OpCode::CallStddev;
+        }
+        if (function == builtinMedian) {
+            return OpCode::CallMedian;
+        }
+        if (function == builtinPercentile) {
+            return OpCode::CallPercentile;
+        }
+        if (function == builtinApproxMedian) {
+            return OpCode::CallApproxMedian;
+        }
+        if (function == builtinApproxPercentile) {
+            return OpCode::CallApproxPercentile;
+        }
+        if (function == builtinFind) {
+            return OpCode::CallFind;
+        }
+        throw std::runtime_error("Unknown function: " + callee);
+    }
+
+    static OpCode operatorOpCode(BinaryExpr::Operator op) {
+        switch (op) {
+            case BinaryExpr::Operator::Add:
+                return OpCode::Add;
+            case BinaryExpr::Operator::Subtract:
+                return OpCode::Subtract;
+            case BinaryExpr::Operator::Multiply:
+                return OpCode::Multiply;
+            case BinaryExpr::Operator::Divide:
+                return OpCode::Divide;
+            case BinaryExpr::Operator::Modulo:
+                return OpCode::Modulo;
+        }
+        throw std::runtime_error("Unknown operator");
+    }
+};
+
+ExprProgram ExprProgram::compile(const Expr &expr) {
+    ExprProgram program;
+    ExprCompiler compiler(program, ExprOptimizer::sharedNodes(expr).size());
+    compiler.compile(expr, 0);
+    return program;
+}
+
+std::string ExprProgram::toString() const {
+    static const char *calls[] = {"min", "max", "size", "average", "sum", "count", "variance", "stddev", "median",
+                                  "percentile", "approx_median", "approx_percentile", "find"};
+    static const char *operators[] = {"+", "-", "*", "/", "%"};
+    std::ostringstream out;
+    for (const Instruction &instruction: code) {
+        out << 'r' << instruction.dst << " = ";
+        switch (instruction.op) {
+            case OpCode::LoadConstant: {
+                const JSONValue &constant = constants[instruction.a];
+                if (constant.isString()) {
+                    out << '"' << constant.asString() << '"';
+                } else if (constant.isNull()) {
+                    out << "null";
+                } else if (constant.isBool()) {
+                    out << (constant.asBool() ? "true" : "false");
+                } else if (constant.isInteger()) {
+                    out << constant.asInteger();
+                } else {
+                    out << constant.asNumber();
+                }
+                break;
+            }
+            case OpCode::GetRootPath:
+            case OpCode::GetPath:
+                if (instruction.op == OpCode::GetRootPath) {
+                    out << "root";
+                } else {
+                    out << 'r' << instruction.a;
+                }
+                for (const JSONString &key: paths[instruction.b]) {
+                    out << '.' << key;
+                }
+                break;
+            case OpCode::Copy:
+                out << 'r' << instruction.a;
+                break;
+            case OpCode::GetIndex:
+                out << 'r' << instruction.a << "[r" << instruction.b << ']';
+                break;
+            case OpCode::Project:
+                out << 'r' << instruction.a;
+                printSteps(out, wildcards[instruction.b]);
+                break;
+            case OpCode::CallMin:
+            case OpCode::CallMax:
+            case OpCode::CallSize:
+            case OpCode::CallAverage:
+            case OpCode::CallSum:
+            case OpCode::CallCount:
+            case OpCode::CallVariance:
+            case OpCode::CallStddev:
+            case OpCode::CallMedian:
+            case OpCode::CallPercentile:
+            case OpCode::CallApproxMedian:
+            case OpCode::CallApproxPercentile:
+            case OpCode::CallFind:
+                out << calls[static_cast<int>(instruction.op) - static_cast<int>(OpCode::CallMin)] << '(';
+                for (uint32_t i = 0; i < instruction.b; ++i) {
+                    out << (i == 0 ? "r" : ", r") << instruction.a + i;
+                }
+                out << ')';
+                break;
+            case OpCode::CallProjected: {
+                const ProjectedCall &call = projectedCalls[instruction.b];
+                out << calls[static_cast<int>(call.call) - static_cast<int>(OpCode::CallMin)] << '(';
+                for (uint32_t i = 0; i < call.arguments; ++i) {
+                    out << (i == 0 ? "r" : ", r") << instruction.a + i;
+                    if (i < call.projections.size() && call.projections[i]) {
+                        printSteps(out, wildcards[*call.projections[i]]);
+                    }
+                }
+                out << ')';
+                break;
+            }
+            default:
+                out << 'r' << instruction.a << ' '
+                    << operators[static_cast<int>(instruction.op) - static_cast<int>(OpCode::Add)] << " r"
+                    << instruction.b;
+                break;
+        }
+        out << '\n';
+    }
+    return out.str();
+}
+
+JSONValue ExprVM::callProjected(const ExprProgram::ProjectedCall &call, const JSONValueRef *args,
+                                const JSONValueRef *r) const {
+    if (call.function == builtinSize) {
+        return JSONValue(static_cast<int64_t>(countWildcard(args[0], program.wildcards[*call.projections[0]], r)));
+    }
+    NumberAggregate aggregate(call.function);
+    for (size_t i = 0; i < call.projections.size(); ++i) {
+        if (call.projections[i]) {
+            aggregate.addWildcard(args[i], program.wildcards[*call.projections[i]], r);
+        } else {
+            aggregate.addArgument(args[i]);
+        }
+    }
+    return aggregate.finish(args + call.projections.size());
+}
+
+ExprVM::ExprVM(const ExprProgram &program) : program(program), registers(program.registers) {}
+
+const JSONValueRef &ExprVM::run(const JSONValue &root) {
+    return run(JSONValueRef::to(root));
+}
+
+const JSONValueRef &ExprVM::run(const JSONTape &tape) {
+    return run(JSONValueRef::to(tape.root()));
+}
+
+const JSONValueRef &ExprVM::run(const JSONValueRef &root) {
+    JSONValueRef *r = registers.data();
+    for (const Instruction &instruction: program.code) {
+        JSONValueRef &dst = r[instruction.dst];
+        switch (instruction.op) {
+            case OpCode::LoadConstant:
+                dst = JSONValueRef::to(program.constants[instruction.a]);
+                break;
+            case OpCode::GetRootPath:
+                if (!root.isObject()) {
+                    throw std::runtime_error("Root JSON is not an object");
+                }
+                dst = getPath(root, program.paths[instruction.b]);
+                break;
+            case OpCode::Copy:
+                dst = r[instruction.a];
+                break;
+            case OpCode::GetPath:
+                dst = getPath(r[instruction.a], program.paths[instruction.b]);
+                break;
+            case OpCode::GetIndex:
+                dst = getIndex(r[instruction.a], r[instruction.b]);
+                break;
+            case OpCode::Project:
+                dst = JSONValueRef::holding(projectWildcard(r[instruction.a], program.wildcards[instruction.b], r));
+                break;
+            case OpCode::CallMin:
+                dst = JSONValueRef::holding(builtinMin(r + instruction.a, instruction.b));
+                break;
+            case OpCode::CallMax:
+                dst = JSONValueRef::holding(builtinMax(r + instruction.a, instruction.b));
+                break;
+            case OpCode::CallSize:
+                dst = JSONValueRef::holding(builtinSize(r + instruction.a, instruction.b));
+                break;
+            case OpCode::CallAverage:
+                dst = JSONValueRef::holding(builtinAverage(r + instruction.a, instruction.b));
+                break;
+            case OpCode::CallSum:
+                dst = JSONValueRef::holding(builtinSum(r + instruction.a, instruction.b));
+                break;
+            case OpCode::CallCount:
+                dst = JSONValueRef::holding(builtinCount(r + instruction.a, instruction.b));
+                break;
+            case OpCode::CallVariance:
+                dst = JSONValueRef::holding(builtinVariance(r + instruction.a, instruction.b));
+                break;
+            case OpCode::CallStddev:
+                dst = JSONValueRef::holding(builtinStddev(r + instruction.a, instruction.b));
+                break;
+            case OpCode::CallMedian:
+                dst = JSONValueRef::holding(builtinMedian(r + instruction.a, instruction.b));
+                break;
+            case OpCode::CallPercentile:
+                dst = JSONValueRef::holding(builtinPercentile(r + instruction.a, instruction.b));
+                break;
+            case OpCode::CallApproxMedian:
+                dst = JSONValueRef::holding(builtinApproxMedian(r + instruction.a, instruction.b));
+                break;
+            case OpCode::CallApproxPercentile:
+                dst = JSONValueRef::holding(builtinApproxPercentile(r + instruction.a, instruction.b));
+                break;
+            case OpCode::CallFind:
+                dst = JSONValueRef::holding(builtinFind(r + instruction.a, instruction.b));
+                break;
+            case OpCode::CallProjected:
+                dst = JSONValueRef::holding(callProjected(program.projectedCalls[instruction.b], r + instruction.a, r));
+                break;
+            case OpCode::Add:
+                dst = JSONValueRef::holding(applyOperator(BinaryExpr::Operator::Add, r[instruction.a], r[instruction.b]));
+                break;
+            case OpCode::Subtract:
+                dst = JSONValueRef::holding(applyOperator(BinaryExpr::Operator::Subtract, r[instruction.a], r[instruction.b]));
+                break;
+            case OpCode::Multiply:
+                dst = JSONValueRef::holding(applyOperator(BinaryExpr::Operator::Multiply, r[instruction.a], r[instruction.b]));
+                break;
+            case OpCode::Divide:
+                dst = JSONValueRef::holding(applyOperator(BinaryExpr::Operator::Divide, r[instruction.a], r[instruction.b]));
+                break;
+            case OpCode::Modulo:
+                dst = JSONValueRef::holding(applyOperator(BinaryExpr::Operator::Modulo, r[instruction.a], r[instruction.b]));
+                break;
+        }
+    }
+    return r[0];
+}
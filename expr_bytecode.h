@@ -0,0 +1,116 @@
+#ifndef EXPR_BYTECODE_H
+#define EXPR_BYTECODE_H
+
+#include "expr.h"
+#include "expr_functions.h"
+#include "json_parser.h"
+#include "json_tape.h"
+#include "json_value_ref.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Register machine code for an expression. Every instruction writes register dst from registers a and b or
+// from an operand table; the result ends up in register 0. Expr::shared nodes are computed once into a
+// register of their own, which later uses copy
+enum class OpCode : uint8_t {
+    LoadConstant, // dst = constants[a]
+    GetRootPath,  // dst = root.paths[b]; the root has to be an object
+    GetPath,      // dst = a.paths[b]
+    Copy,         // dst = a
+    GetIndex,     // dst = a[b]
+    Project,      // dst = a[*] with the steps wildcards[b]
+    CallMin,      // dst = min(a, a + 1, ..., a + b - 1)
+    CallMax,
+    CallSize,
+    CallAverage,
+    CallSum,
+    CallCount,
+    CallVariance,
+    CallStddev,
+    CallMedian,
+    CallPercentile,
+    CallApproxMedian,
+    CallApproxPercentile,
+    CallFind,
+    CallProjected, // dst = projectedCalls[b] of a, a + 1, ...; see ProjectedCall
+    Add,          // dst = a + b
+    Subtract,
+    Multiply,
+    Divide,
+    Modulo
+};
+
+struct Instruction {
+    OpCode op;
+    uint32_t dst;
+    uint32_t a;
+    uint32_t b;
+};
+
+// Expression compiled once into a flat instruction list. Function names are resolved and literals are
+// converted while compiling, so running it involves no tree walk, virtual call or name lookup
+class ExprProgram {
+public:
+    // Throws std::runtime_error for an unknown function
+    static ExprProgram compile(const Expr &expr);
+
+    [[nodiscard]] const std::vector<Instruction> &instructions() const { return code; }
+
+    [[nodiscard]] size_t registerCount() const { return registers; }
+
+    // One instruction per line, e.g. "r0 = root.a.b"
+    [[nodiscard]] std::string toString() const;
+
+private:
+    friend class ExprCompiler;
+
+    friend class ExprVM;
+
+    std::vector<Instruction> code;
+    std::vector<JSONValue> constants;
+    // Member chains such as a.b.c, each walked by one instruction. Keys are hashed while compiling
+    std::vector<std::vector<JSONString>> paths;
+    // Steps of the wildcard projections. The index of an Index step is a register
+    std::vector<std::vector<WildcardStep>> wildcards;
+
+    // Call of size or of a numeric aggregate with projected arguments, which are walked in place instead of
+    // being built into arrays. The register of a projected argument holds the array it projects
+    struct ProjectedCall {
+        // Plain call instruction of the function, for printing
+        OpCode call;
+        BuiltinFunction function;
+        uint32_t arguments;
+        // Per aggregated argument, the index of its steps in wildcards when it is projected
+        std::vector<std::optional<uint32_t>> projections;
+    };
+
+    std::vector<ProjectedCall> projectedCalls;
+    size_t registers = 0;
+};
+
+// Runs an ExprProgram. Registers are allocated once, so running the same program over many documents
+// allocates only for what the expression computes. Not thread-safe; use one ExprVM per thread
+class ExprVM {
+public:
+    // program has to outlive the VM
+    explicit ExprVM(const ExprProgram &program);
+
+    // Value of the expression. It may refer into root and into the program, and is valid until the next run
+    const JSONValueRef &run(const JSONValue &root);
+
+    const JSONValueRef &run(const JSONTape &tape);
+
+private:
+    const ExprProgram &program;
+    std::vector<JSONValueRef> registers;
+
+    const JSONValueRef &run(const JSONValueRef &root);
+
+    // Value of a CallProjected with its arguments at args. r are the registers, which hold the step indices
+    [[nodiscard]] JSONValue callProjected(const ExprProgram::ProjectedCall &call, const JSONValueRef *args,
+                                          const JSONValueRef *r) const;
+};
+
+#endif // EXPR_BYTECODE_H
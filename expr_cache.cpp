@@ -0,0 +1,198 @@
+#include "expr_cache.h"
+#include <cstring>
+
+namespace {
+
+// Rough heap footprint of a value
+size_t valueBytes(const JSONValue &value) {
+    size_t bytes = sizeof(JSONValue);
+    if (value.isString()) {
+        bytes += value.asString().size();
+    } else if (value.isArray()) {
+        for (const auto &element: value.asArray()) {
+            bytes += valueBytes(element);
+        }
+    } else if (value.isObject()) {
+        for (const auto &[key, member]: value.asObject()) {
+            bytes += sizeof(key) + key.size() + valueBytes(member) + 2 * sizeof(void *);
+        }
+    }
+    return bytes;
+}
+
+// List node, index bucket and the key stored twice
+constexpr size_t entryOverhead = 96;
+
+}
+
+std::string ExprCache::structuralKey(const Expr &expr) {
+    ExprCacheKeys keys;
+    keys.add(expr);
+    return keys.structuralKey(expr);
+}
+
+std::optional<JSONValue> ExprCache::find(const std::string &key, uint64_t generation) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto keys = index.find(generation);
+    if (keys != index.end()) {
+        auto found = keys->second.find(key);
+        if (found != keys->second.end()) {
+            ++counters.hits;
+            entries.splice(entries.begin(), entries, found->second);
+            return found->second->value;
+        }
+    }
+    ++counters.misses;
+    return std::nullopt;
+}
+
+void ExprCache::insert(const std::string &key, uint64_t generation, const JSONValue &value) {
+    size_t bytes = 2 * key.size() + valueBytes(value) + entryOverhead;
+    if (bytes > budget) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    auto keys = index.find(generation);
+    if (keys != index.end() && keys->second.count(key) != 0) {
+        // Computed by two queries at once
+        return;
+    }
+    evictTo(budget - bytes);
+    entries.push_front({generation, key, value, bytes});
+    index[generation].emplace(key, entries.begin());
+    counters.bytes += bytes;
+    ++counters.entries;
+}
+
+void ExprCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    index.clear();
+    counters.entries = 0;
+    counters.bytes = 0;
+}
+
+ExprCache::Stats ExprCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+void ExprCache::evictTo(size_t bytes) {
+    while (counters.bytes > bytes && !entries.empty()) {
+        const Entry &last = entries.back();
+        counters.bytes -= last.bytes;
+        --counters.entries;
+        ++counters.evictions;
+        auto keys = index.find(last.generation);
+        keys->second.erase(last.key);
+        if (keys->second.empty()) {
+            index.erase(keys);
+        }
+        entries.pop_back();
+    }
+}
+
+void ExprCacheKeys::add(const Expr &expr) {
+    (void) keyed(expr);
+}
+
+const std::string *ExprCacheKeys::cacheKey(const Expr &expr) const {
+    const Node &node = nodes.at(&expr);
+    return node.cached ? &node.key : nullptr;
+}
+
+void ExprCacheKeys::visit(const IdentifierExpr &expr) {
+    Node node;
+    appendText(node.key, 'I', expr.name);
+    node.readsDocument = true;
+    nodes.emplace(&expr, std::move(node));
+}
+
+void ExprCacheKeys::visit(const NumberExpr &expr) {
+    Node node;
+    if (expr.integer) {
+        node.key = 'i' + std::to_string(*expr.integer) + ';';
+    } else {
+        // The exact bits, so that every double has a key of its own
+        uint64_t bits = 0;
+        std::memcpy(&bits, &expr.value, sizeof(bits));
+        node.key = 'd' + std::to_string(bits) + ';';
+    }
+    nodes.emplace(&expr, std::move(node));
+}
+
+void ExprCacheKeys::visit(const StringExpr &expr) {
+    Node node;
+    appendText(node.key, 'S', expr.value);
+    nodes.emplace(&expr, std::move(node));
+}
+
+void ExprCacheKeys::visit(const MemberExpr &expr) {
+    const Node &object = keyed(*expr.object);
+    Node node{"M(" + object.key + ')', object.readsDocument, object.iterates};
+    appendText(node.key, '.', expr.member);
+    nodes.emplace(&expr, std::move(node));
+}
+
+void ExprCacheKeys::visit(const SubscriptExpr &expr) {
+    const Node &array = keyed(*expr.array);
+    const Node &index = keyed(*expr.index);
+    Node node{"X(" + array.key + ")[" + index.key + ']', array.readsDocument || index.readsDocument,
+              array.iterates || index.iterates};
+    nodes.emplace(&expr, std::move(node));
+}
+
+void ExprCacheKeys::visit(const CallExpr &expr) {
+    Node node;
+    appendText(node.key, 'C', expr.callee);
+    node.key += '(';
+    for (const auto &arg: expr.arguments) {
+        const Node &argument = keyed(*arg);
+        node.key += argument.key;
+        node.key += ',';
+        node.readsDocument = node.readsDocument || argument.readsDocument;
+    }
+    node.key += ')';
+    node.iterates = true;
+    node.cached = node.readsDocument;
+    nodes.emplace(&expr, std::move(node));
+}
+
+void ExprCacheKeys::visit(const BinaryExpr &expr) {
+    const Node &left = keyed(*expr.left);
+    const Node &right = keyed(*expr.right);
+    Node node{'B' + std::to_string(static_cast<int>(expr.op)) + '(' + left.key + ',' + right.key + ')',
+              left.readsDocument || right.readsDocument, left.iterates || right.iterates};
+    node.cached = node.readsDocument && node.iterates;
+    nodes.emplace(&expr, std::move(node));
+}
+
+void ExprCacheKeys::visit(const WildcardExpr &expr) {
+    const Node &array = keyed(*expr.array);
+    Node node{"W(" + array.key + ')', array.readsDocument, true};
+    for (const auto &step: expr.steps) {
+        if (step.kind == WildcardExpr::Step::Kind::Member) {
+            appendText(node.key, '.', step.member);
+        } else if (step.kind == WildcardExpr::Step::Kind::Index) {
+            const Node &index = keyed(*step.index);
+            node.key += '[' + index.key + ']';
+            node.readsDocument = node.readsDocument || index.readsDocument;
+        } else {
+            node.key += "[*]";
+        }
+    }
+    nodes.emplace(&expr, std::move(node));
+}
+
+const ExprCacheKeys::Node &ExprCacheKeys::keyed(const Expr &expr) {
+    auto found = nodes.find(&expr);
+    if (found != nodes.end()) {
+        return found->second;
+    }
+    expr.accept(*this);
+    return nodes.at(&expr);
+}
+
+void ExprCacheKeys::appendText(std::string &key, char tag, const std::string &value) {
+    key += tag + std::to_string(value.size()) + ':' + value;
+}
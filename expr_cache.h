@@ -0,0 +1,114 @@
+#ifndef EXPR_CACHE_H
+#define EXPR_CACHE_H
+
+#include "expr.h"
+#include "expr_visitor.h"
+#include "json_parser.h"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+// Results of call and operator subexpressions, kept across the queries of a session against one document
+// (--serve, batches). An entry is keyed by the structure of its subtree, so the same subexpression in a later
+// query is a hit, and by the generation of the document it was computed on, so a new version of the document
+// never sees old results. Entries are evicted least recently used first once their estimated size exceeds
+// the budget. Safe to use from several threads
+class ExprCache {
+public:
+    static constexpr size_t defaultBudget = size_t{64} << 20;
+
+    struct Stats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    explicit ExprCache(size_t budgetBytes = defaultBudget) : budget(budgetBytes) {}
+
+    // Canonical text of the subtree: equal for structurally equal subtrees and different otherwise
+    static std::string structuralKey(const Expr &expr);
+
+    // Counts a hit or a miss
+    std::optional<JSONValue> find(const std::string &key, uint64_t generation);
+
+    // Values larger than the whole budget are not kept
+    void insert(const std::string &key, uint64_t generation, const JSONValue &value);
+
+    void clear();
+
+    [[nodiscard]] Stats stats() const;
+
+private:
+    struct Entry {
+        uint64_t generation;
+        std::string key;
+        JSONValue value;
+        size_t bytes;
+    };
+
+    size_t budget;
+    mutable std::mutex mutex;
+    // Most recently used first
+    std::list<Entry> entries;
+    // By generation, then by structural key
+    std::unordered_map<uint64_t, std::unordered_map<std::string, std::list<Entry>::iterator>> index;
+    Stats counters;
+
+    void evictTo(size_t bytes);
+};
+
+// Structural keys of the subexpressions of one expression, each built once from the keys of its children, so
+// one pass over an expression keys all of it. Only subexpressions worth a lookup get a cache key: calls, and
+// operators over calls or projections, that read the document. Paths and arithmetic on them are faster to
+// compute than to look up, and literals alone never change
+class ExprCacheKeys : public ExprVisitor {
+public:
+    // Keys expr and everything below it that is not keyed yet. Does not modify anything once expr is keyed
+    void add(const Expr &expr);
+
+    // Key to cache a keyed expr under, nullptr when it is not worth caching
+    [[nodiscard]] const std::string *cacheKey(const Expr &expr) const;
+
+    // Key of a keyed expr, as ExprCache::structuralKey
+    [[nodiscard]] const std::string &structuralKey(const Expr &expr) const { return nodes.at(&expr).key; }
+
+    void visit(const IdentifierExpr &expr) override;
+
+    void visit(const NumberExpr &expr) override;
+
+    void visit(const StringExpr &expr) override;
+
+    void visit(const MemberExpr &expr) override;
+
+    void visit(const SubscriptExpr &expr) override;
+
+    void visit(const CallExpr &expr) override;
+
+    void visit(const BinaryExpr &expr) override;
+
+    void visit(const WildcardExpr &expr) override;
+
+private:
+    struct Node {
+        std::string key;
+        bool readsDocument = false;
+        // Contains a call or a projection, which may walk whole arrays
+        bool iterates = false;
+        bool cached = false;
+    };
+
+    std::unordered_map<const Expr *, Node> nodes;
+
+    const Node &keyed(const Expr &expr);
+
+    // Names and strings are length-prefixed, so no two different subtrees print alike
+    static void appendText(std::string &key, char tag, const std::string &value);
+};
+
+#endif // EXPR_CACHE_H
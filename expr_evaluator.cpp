@@ -1,262 +1,447 @@
 #include "expr_evaluator.h"
-#include <stdexcept>
+#include "expr_functions.h"
+#include "thread_pool.h"
 #include <algorithm>
+#include <stdexcept>
 #include <cmath>
 #include <sstream>
-#include <future>
+#include <utility>
 
-ExprEvaluator::ExprEvaluator(const JSONValue &root) : root(root) {
-    initializeFunctions();
-}
+namespace {
 
-void ExprEvaluator::initializeFunctions() { // NOLINT
-    functions["min"] = [](const std::vector<JSONValue> &args) -> JSONValue {
-        if (args.empty()) {
-            throw std::runtime_error("min() requires at least one argument");
-        }
-        double minValue = std::numeric_limits<double>::max();
-        for (const auto &arg: args) {
-            if (arg.isNumber()) {
-                minValue = std::min(minValue, arg.asNumber());
-            } else if (arg.isArray()) {
-                for (const auto &item: arg.asArray()) {
-                    if (item.isNumber()) {
-                        minValue = std::min(minValue, item.asNumber());
-                    }
-                }
-            } else {
-                throw std::runtime_error("min() arguments must be numbers or arrays of numbers");
-            }
-        }
-        return minValue;
-    };
+// Whether expr is cheap enough that handing it to another thread costs more than evaluating it: literals
+// and short paths without calls or arithmetic
+class TrivialExprCheck : public ExprVisitor {
+public:
+    static bool check(const Expr &expr) {
+        TrivialExprCheck checker;
+        expr.accept(checker);
+        return checker.trivial;
+    }
 
-    functions["max"] = [](const std::vector<JSONValue> &args) -> JSONValue {
-        if (args.empty()) {
-            throw std::runtime_error("max() requires at least one argument");
-        }
-        double maxValue = std::numeric_limits<double>::lowest();
-        for (const auto &arg: args) {
-            if (arg.isNumber()) {
-                maxValue = std::max(maxValue, arg.asNumber());
-            } else if (arg.isArray()) {
-                for (const auto &item: arg.asArray()) {
-                    if (item.isNumber()) {
-                        maxValue = std::max(maxValue, item.asNumber());
-                    }
-                }
-            } else {
-                throw std::runtime_error("max() arguments must be numbers or arrays of numbers");
-            }
-        }
-        return maxValue;
-    };
+    void visit(const IdentifierExpr &) override { count(); }
 
-    functions["size"] = [](const std::vector<JSONValue> &args) -> JSONValue {
-        if (args.size() != 1) {
-            throw std::runtime_error("size() requires exactly one argument");
-        }
-        const auto &arg = args[0];
-        if (arg.isObject()) {
-            return static_cast<double>(arg.asObject().size());
-        }
-        if (arg.isArray()) {
-            return static_cast<double>(arg.asArray().size());
-        }
-        if (arg.isString()) {
-            return static_cast<double>(arg.asString().size());
+    void visit(const NumberExpr &) override { count(); }
+
+    void visit(const StringExpr &) override { count(); }
+
+    void visit(const MemberExpr &expr) override {
+        count();
+        expr.object->accept(*this);
+    }
+
+    void visit(const SubscriptExpr &expr) override {
+        count();
+        expr.array->accept(*this);
+        expr.index->accept(*this);
+    }
+
+    void visit(const CallExpr &) override { trivial = false; }
+
+    void visit(const BinaryExpr &) override { trivial = false; }
+
+    void visit(const WildcardExpr &) override { trivial = false; }
+
+private:
+    static constexpr size_t maxNodes = 8;
+    size_t nodes = 0;
+    bool trivial = true;
+
+    void count() {
+        if (++nodes > maxNodes) {
+            trivial = false;
         }
-        throw std::runtime_error("size() argument must be an object, array, or string");
-    };
+    }
+};
+
+// Appends the outermost Expr::shared nodes of expr that are not in nodes yet. Nodes below a shared node are
+// left to its evaluation
+class SharedExprCollector : public ExprVisitor {
+public:
+    static void collect(const Expr &expr, std::vector<const Expr *> &nodes) {
+        SharedExprCollector collector(nodes);
+        collector.reach(expr);
+    }
+
+    void visit(const IdentifierExpr &) override {}
 
-    functions["average"] = [](const std::vector<JSONValue> &args) -> JSONValue {
-        if (args.empty()) {
-            throw std::runtime_error("average() requires at least one argument");
+    void visit(const NumberExpr &) override {}
+
+    void visit(const StringExpr &) override {}
+
+    void visit(const MemberExpr &expr) override { reach(*expr.object); }
+
+    void visit(const SubscriptExpr &expr) override {
+        reach(*expr.array);
+        reach(*expr.index);
+    }
+
+    void visit(const CallExpr &expr) override {
+        for (const auto &arg: expr.arguments) {
+            reach(*arg);
         }
-        double sum = 0;
-        size_t count = 0;
-        for (const auto &arg: args) {
-            if (arg.isNumber()) {
-                sum += arg.asNumber();
-                ++count;
-            } else if (arg.isArray()) {
-                for (const auto &item: arg.asArray()) {
-                    if (item.isNumber()) {
-                        sum += item.asNumber();
-                        ++count;
-                    }
-                }
-            } else {
-                throw std::runtime_error("average() arguments must be numbers or arrays of numbers");
+    }
+
+    void visit(const BinaryExpr &expr) override {
+        reach(*expr.left);
+        reach(*expr.right);
+    }
+
+    void visit(const WildcardExpr &expr) override {
+        reach(*expr.array);
+        for (const auto &step: expr.steps) {
+            if (step.index != nullptr) {
+                reach(*step.index);
             }
         }
-        if (count == 0) {
-            throw std::runtime_error("average() requires at least one numeric value");
+    }
+
+private:
+    std::vector<const Expr *> &nodes;
+
+    explicit SharedExprCollector(std::vector<const Expr *> &nodes) : nodes(nodes) {}
+
+    void reach(const Expr &expr) {
+        if (!expr.shared) {
+            expr.accept(*this);
+        } else if (std::find(nodes.begin(), nodes.end(), &expr) == nodes.end()) {
+            nodes.push_back(&expr);
         }
-        return sum / count;
-    };
+    }
+};
+
 }
 
+ExprEvaluator::ExprEvaluator(const JSONValue &root, const PrecomputedResults *precomputed)
+        : root(&root), precomputed(precomputed) {}
+
+ExprEvaluator::ExprEvaluator(const JSONTape &tape, const PrecomputedResults *precomputed)
+        : tape(&tape), precomputed(precomputed) {}
+
 void ExprEvaluator::visit(const IdentifierExpr &expr) {
+    if (takePrecomputed(expr)) {
+        return;
+    }
     if (expr.name == "null") {
-        result = nullptr;
+        current = JSONValueRef();
     } else if (expr.name == "true") {
-        result = true;
+        current = JSONValueRef::holding(true);
     } else if (expr.name == "false") {
-        result = false;
+        current = JSONValueRef::holding(false);
     } else {
-        if (!root.isObject()) {
+        JSONValueRef document = tape != nullptr ? JSONValueRef::to(tape->root()) : JSONValueRef::to(*root);
+        if (!document.isObject()) {
             throw std::runtime_error("Root JSON is not an object");
         }
-        result = getValue(root, expr.name);
+        current = getMember(document, expr.name);
     }
+    publish();
 }
 
 void ExprEvaluator::visit(const NumberExpr &expr) {
-    result = expr.value;
+    if (expr.integer) {
+        current = JSONValueRef::holding(*expr.integer);
+    } else {
+        current = JSONValueRef::holding(expr.value);
+    }
+    publish();
 }
 
 void ExprEvaluator::visit(const StringExpr &expr) {
-    result = expr.value;
+    current = JSONValueRef::holding(expr.value);
+    publish();
 }
 
 void ExprEvaluator::visit(const MemberExpr &expr) {
-    expr.object->accept(*this);
-    if (!result.isObject()) {
-        throw std::runtime_error("Attempted to access member of non-object");
+    if (takePrecomputed(expr)) {
+        return;
     }
-    result = getValue(result, expr.member);
+    JSONValueRef object = evaluate(*expr.object);
+    current = getMember(object, expr.member);
+    publish();
 }
 
 void ExprEvaluator::visit(const SubscriptExpr &expr) {
-    expr.array->accept(*this);
-    JSONValue arrayValue = result;
+    if (takePrecomputed(expr)) {
+        return;
+    }
+    JSONValueRef container = evaluate(*expr.array);
+    JSONValueRef index = evaluate(*expr.index);
+    current = getIndex(container, index);
+    publish();
+}
 
-    expr.index->accept(*this);
-    JSONValue indexValue = result;
+void ExprEvaluator::visit(const CallExpr &expr) {
+    const std::string *key = nullptr;
+    if (takePrecomputed(expr) || takeCached(expr, key)) {
+        return;
+    }
+    BuiltinFunction function = findBuiltinFunction(expr.callee);
+    if (function == nullptr) {
+        throw std::runtime_error("Unknown function: " + expr.callee);
+    }
 
-    if (arrayValue.isArray()) {
-        if (!indexValue.isNumber()) {
-            throw std::runtime_error("Array index must be a number");
+    if (!fuseWildcards(expr, function)) {
+        std::vector<const Expr *> operands;
+        for (const auto &arg: expr.arguments) {
+            operands.push_back(arg.get());
         }
-        auto index = static_cast<size_t>(indexValue.asNumber());
-        result = getValue(arrayValue, index);
-    } else if (arrayValue.isObject()) {
-        if (!indexValue.isString()) {
-            throw std::runtime_error("Object index must be a string");
+        std::vector<JSONValueRef> args = evaluateOperands(operands);
+        if (function == builtinFind && indexes != nullptr) {
+            // The element found is referred to, not copied
+            std::string value = findArguments(args.data(), args.size());
+            auto found = args[1].withString([&](std::string_view key) { return indexes->find(args[0], key, value); });
+            current = found ? std::move(*found) : JSONValueRef();
+        } else {
+            current = JSONValueRef::holding(function(args.data(), args.size()));
         }
-        result = getValue(arrayValue, indexValue.asString());
-    } else {
-        throw std::runtime_error("Attempted to index non-array/non-object");
     }
+    publish();
+    storeCached(key);
 }
 
-void ExprEvaluator::visit(const CallExpr &expr) {
-    auto it = functions.find(expr.callee);
-    if (it == functions.end()) {
-        throw std::runtime_error("Unknown function: " + expr.callee);
+void ExprEvaluator::visit(const BinaryExpr &expr) {
+    const std::string *key = nullptr;
+    if (takeCached(expr, key)) {
+        return;
     }
+    std::vector<JSONValueRef> operands = evaluateOperands({expr.left.get(), expr.right.get()});
+    current = JSONValueRef::holding(applyOperator(expr.op, operands[0], operands[1]));
+    publish();
+    storeCached(key);
+}
+
+void ExprEvaluator::visit(const WildcardExpr &expr) {
+    JSONValueRef array = evaluate(*expr.array);
+    std::vector<JSONValueRef> indices;
+    std::vector<WildcardStep> steps = wildcardSteps(expr, indices);
+    current = JSONValueRef::holding(projectWildcard(array, steps, indices.data()));
+    publish();
+}
+
+JSONValueRef ExprEvaluator::evaluate(const Expr &expr) {
+    if (expr.shared) {
+        auto found = sharedValues.find(&expr);
+        if (found != sharedValues.end()) {
+            return found->second;
+        }
+    }
+    ++depth;
+    try {
+        expr.accept(*this);
+    } catch (...) {
+        --depth;
+        throw;
+    }
+    --depth;
+    if (expr.shared) {
+        sharedValues.emplace(&expr, current);
+    }
+    return std::move(current);
+}
 
-    // Evaluate arguments in parallel. For thread safety new ExprEvaluator is created for each argument
-    std::vector<std::future<JSONValue>> futures;
-    for (const auto &arg: expr.arguments) {
-        futures.push_back(std::async(std::launch::async, [this, &arg]() -> JSONValue {
-            ExprEvaluator evaluator(this->root);
-            arg->accept(evaluator);
-            return evaluator.result;
-        }));
+void ExprEvaluator::publish() {
+    if (depth == 0) {
+        result = current.toJSONValue();
     }
+}
 
-    std::vector<JSONValue> args;
-    for (auto &fut: futures) {
-        args.push_back(fut.get());
+bool ExprEvaluator::takePrecomputed(const Expr &expr) {
+    if (precomputed == nullptr) {
+        return false;
+    }
+    auto found = precomputed->find(&expr);
+    if (found == precomputed->end()) {
+        return false;
     }
+    current = found->second;
+    publish();
+    return true;
+}
 
-    result = it->second(args);
+std::vector<WildcardStep> ExprEvaluator::wildcardSteps(const WildcardExpr &expr,
+                                                       std::vector<JSONValueRef> &indices) {
+    std::vector<WildcardStep> steps;
+    for (const auto &step: expr.steps) {
+        steps.push_back({step.kind, {}, indices.size()});
+        if (step.kind == WildcardExpr::Step::Kind::Member) {
+            steps.back().member = JSONString::prehashed(step.member);
+        } else if (step.kind == WildcardExpr::Step::Kind::Index) {
+            indices.push_back(evaluate(*step.index));
+        }
+    }
+    return steps;
 }
 
-void ExprEvaluator::visit(const BinaryExpr &expr) {
-    // Evaluate left and right operands in parallel. Safe as long as JSON is immutable
-    auto leftFuture = std::async(std::launch::async, [this, &expr]() -> JSONValue {
-        ExprEvaluator evaluator(this->root);
-        expr.left->accept(evaluator);
-        return evaluator.result;
-    });
-
-    auto rightFuture = std::async(std::launch::async, [this, &expr]() -> JSONValue {
-        ExprEvaluator evaluator(this->root);
-        expr.right->accept(evaluator);
-        return evaluator.result;
-    });
-
-    JSONValue leftValue = leftFuture.get();
-    JSONValue rightValue = rightFuture.get();
-
-    if (!leftValue.isNumber() || !rightValue.isNumber()) {
-        throw std::runtime_error("Binary operations require numeric operands");
-    }
-
-    double leftNum = leftValue.asNumber();
-    double rightNum = rightValue.asNumber();
-    switch (expr.op) {
-        case BinaryExpr::Operator::Add:
-            result = leftNum + rightNum;
-            break;
-        case BinaryExpr::Operator::Subtract:
-            result = leftNum - rightNum;
-            break;
-        case BinaryExpr::Operator::Multiply:
-            result = leftNum * rightNum;
-            break;
-        case BinaryExpr::Operator::Divide:
-            if (rightNum == 0) {
-                throw std::runtime_error("Division by zero");
-            }
-            result = leftNum / rightNum;
-            break;
-        case BinaryExpr::Operator::Modulo:
-            if (rightNum == 0) {
-                throw std::runtime_error("Division by zero in modulo operation");
-            }
-            result = std::fmod(leftNum, rightNum);
-            break;
+bool ExprEvaluator::fuseWildcards(const CallExpr &expr, BuiltinFunction function) {
+    bool counts = function == builtinSize && expr.arguments.size() == 1;
+    std::optional<size_t> aggregated;
+    if (counts) {
+        aggregated = 1;
+    } else if (isNumericAggregate(function)) {
+        aggregated = aggregatedArguments(function, expr.arguments.size());
+    }
+    if (!aggregated) {
+        return false;
+    }
+    // A wildcard among the aggregated arguments contributes its array as the operand
+    std::vector<const WildcardExpr *> wildcards;
+    std::vector<const Expr *> operands;
+    bool anyWildcard = false;
+    for (size_t i = 0; i < expr.arguments.size(); ++i) {
+        const Expr *arg = expr.arguments[i].get();
+        wildcards.push_back(i < *aggregated ? dynamic_cast<const WildcardExpr *>(arg) : nullptr);
+        operands.push_back(wildcards.back() != nullptr ? wildcards.back()->array.get() : arg);
+        anyWildcard = anyWildcard || wildcards.back() != nullptr;
+    }
+    if (!anyWildcard) {
+        return false;
+    }
+    std::vector<JSONValueRef> values = evaluateOperands(operands);
+
+    if (counts) {
+        std::vector<JSONValueRef> indices;
+        std::vector<WildcardStep> steps = wildcardSteps(*wildcards[0], indices);
+        current = JSONValueRef::holding(static_cast<int64_t>(countWildcard(values[0], steps, indices.data())));
+        return true;
     }
+    NumberAggregate aggregate(function);
+    for (size_t i = 0; i < *aggregated; ++i) {
+        if (wildcards[i] == nullptr) {
+            aggregate.addArgument(values[i]);
+            continue;
+        }
+        std::vector<JSONValueRef> indices;
+        std::vector<WildcardStep> steps = wildcardSteps(*wildcards[i], indices);
+        aggregate.addWildcard(values[i], steps, indices.data());
+    }
+    current = JSONValueRef::holding(aggregate.finish(values.data() + *aggregated));
+    return true;
 }
 
-JSONValue ExprEvaluator::getValue(const JSONValue &value, const std::string &key) {
-    if (!value.isObject()) {
-        throw std::runtime_error("Attempted to access member of non-object");
+bool ExprEvaluator::takeCached(const Expr &expr, const std::string *&key) {
+    if (cache == nullptr) {
+        return false;
+    }
+    if (cacheKeys == nullptr) {
+        cacheKeys = std::make_shared<ExprCacheKeys>();
+    }
+    cacheKeys->add(expr);
+    key = cacheKeys->cacheKey(expr);
+    if (key == nullptr) {
+        return false;
     }
-    const auto &obj = value.asObject();
-    auto itr = obj.find(key);
-    if (itr == obj.end()) {
-        throw std::runtime_error("Key not found: " + key);
+    std::optional<JSONValue> cached = cache->find(*key, generation);
+    if (!cached) {
+        return false;
+    }
+    current = JSONValueRef::holding(std::move(*cached));
+    publish();
+    return true;
+}
+
+void ExprEvaluator::storeCached(const std::string *key) {
+    if (key != nullptr) {
+        // The outermost value was just copied into result by publish
+        cache->insert(*key, generation, depth == 0 ? result : current.toJSONValue());
     }
-    return itr->second;
 }
 
-JSONValue ExprEvaluator::getValue(const JSONValue &value, size_t index) {
-    if (!value.isArray()) {
-        throw std::runtime_error("Attempted to index non-array");
+JSONValueRef ExprEvaluator::evaluateIsolated(const Expr &expr,
+                                             std::unordered_map<const Expr *, JSONValueRef> shared) const {
+    ExprEvaluator evaluator = tape != nullptr ? ExprEvaluator(*tape, precomputed) : ExprEvaluator(*root, precomputed);
+    evaluator.setCache(cache, generation);
+    evaluator.cacheKeys = cacheKeys;
+    evaluator.setLookupIndexes(indexes);
+    evaluator.threadPool = threadPool;
+    evaluator.sharedValues = std::move(shared);
+    // References into the document stay valid on any thread. Values the evaluator holds move with the reference
+    return evaluator.evaluate(expr);
+}
+
+std::vector<JSONValueRef> ExprEvaluator::evaluateOperands(const std::vector<const Expr *> &operands) {
+    ThreadPool &pool = threadPool != nullptr ? *threadPool : ThreadPool::shared();
+    bool spawn = parallel && pool.concurrency() > 1;
+
+    // Non-trivial operands but the last go to the pool. For thread safety each gets a new ExprEvaluator,
+    // which is safe as long as JSON is immutable. The rest run here while the pool works on those
+    std::vector<std::optional<std::vector<const Expr *>>> sharedBelow(operands.size());
+    for (size_t i = 0; spawn && i + 1 < operands.size(); ++i) {
+        if (!TrivialExprCheck::check(*operands[i])) {
+            sharedBelow[i].emplace();
+            SharedExprCollector::collect(*operands[i], *sharedBelow[i]);
+        }
+    }
+    // Every evaluator would compute a shared node again, so they are computed once here and handed down
+    for (const auto &nodes: sharedBelow) {
+        if (!nodes) {
+            continue;
+        }
+        for (const Expr *node: *nodes) {
+            (void) evaluate(*node);
+        }
+    }
+    std::vector<std::optional<std::future<JSONValueRef>>> futures(operands.size());
+    for (size_t i = 0; i < operands.size(); ++i) {
+        if (!sharedBelow[i] || sharedValues.count(operands[i]) != 0) {
+            continue;
+        }
+        std::unordered_map<const Expr *, JSONValueRef> shared;
+        for (const Expr *node: *sharedBelow[i]) {
+            shared.emplace(node, sharedValues.at(node));
+        }
+        const Expr *operand = operands[i];
+        futures[i] = pool.submit([this, operand, shared = std::move(shared)]() mutable {
+            return evaluateIsolated(*operand, std::move(shared));
+        });
+    }
+
+    std::vector<JSONValueRef> values(operands.size());
+    std::exception_ptr error;
+    for (size_t i = 0; i < operands.size(); ++i) {
+        if (futures[i] || error) {
+            continue;
+        }
+        try {
+            values[i] = evaluate(*operands[i]);
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+    // Submitted tasks reference the operands, so they are awaited even when an inline one failed
+    for (size_t i = 0; i < operands.size(); ++i) {
+        if (!futures[i]) {
+            continue;
+        }
+        try {
+            values[i] = pool.wait(*futures[i]);
+        } catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
     }
-    const auto &arr = value.asArray();
-    if (index >= arr.size()) {
-        throw std::runtime_error("Array index out of bounds");
+    if (error) {
+        std::rethrow_exception(error);
     }
-    return arr[index];
+    return values;
 }
 
-std::string ExprEvaluator::jsonValueToString(const JSONValue &value) const {
+std::string ExprEvaluator::jsonValueToString(const JSONValue &value) {
     if (value.isNull()) {
         return "null";
     }
     if (value.isBool()) {
         return value.asBool() ? "true" : "false";
     }
+    if (value.isInteger()) {
+        return std::to_string(value.asInteger());
+    }
     if (value.isNumber()) {
         double num = value.asNumber();
-        if (std::trunc(num) == num) {
-            // Number is an integer
+        // Whole numbers strictly inside the int64 range print without an exponent. A double at -2^63 or
+        // beyond, or an infinity, is what an overflowing integer became, and does not fit
+        if (std::trunc(num) == num && num > -9223372036854775808.0 && num < 9223372036854775808.0) {
             std::ostringstream oss;
             oss << static_cast<int64_t>(num);
             return oss.str();
@@ -267,7 +452,7 @@ std::string ExprEvaluator::jsonValueToString(const JSONValue &value) const {
         return oss.str();
     }
     if (value.isString()) {
-        return value.asString();
+        return value.asString().str();
     }
     if (value.isArray()) {
         std::string result = "[ ";
@@ -281,7 +466,7 @@ std::string ExprEvaluator::jsonValueToString(const JSONValue &value) const {
     if (value.isObject()) {
         std::string result = "{ ";
         for (const auto &[key, val]: value.asObject()) {
-            result += "\"" + key + "\": " + jsonValueToString(val) + ", ";
+            result += "\"" + key.str() + "\": " + jsonValueToString(val) + ", ";
         }
         if (result.size() > 2) { result.resize(result.size() - 2); }
         result += " }";
@@ -1,13 +1,45 @@
 #ifndef EXPR_EVALUATOR_H
 #define EXPR_EVALUATOR_H
 
+#include "expr_cache.h"
+#include "expr_functions.h"
+#include "lookup_index.h"
 #include "expr_visitor.h"
-#include <functional>
+#include "json_tape.h"
+#include "json_value_ref.h"
+#include "thread_pool.h"
+#include <memory>
+#include <optional>
 #include <unordered_map>
 
+// Values computed ahead of evaluation (e.g. aggregates folded into a streaming pass, or paths a batch of
+// expressions shares), keyed by call or path node. The evaluator takes them instead of visiting the node
+using PrecomputedResults = std::unordered_map<const Expr *, JSONValueRef>;
+
 class ExprEvaluator : public ExprVisitor {
 public:
-    explicit ExprEvaluator(const JSONValue &root);
+    explicit ExprEvaluator(const JSONValue &root, const PrecomputedResults *precomputed = nullptr);
+
+    // Evaluates against a tape. Paths are navigated on the tape itself, functions read the tape directly,
+    // and only the final result is copied into a JSONValue
+    explicit ExprEvaluator(const JSONTape &tape, const PrecomputedResults *precomputed = nullptr);
+
+    // Whether function arguments and operator operands may be handed to the shared ThreadPool (the default).
+    // Callers that already run many evaluations side by side turn it off and evaluate everything inline
+    void setParallel(bool value) { parallel = value; }
+
+    // Pool that operands are handed to instead of the shared one
+    void setThreadPool(ThreadPool &value) { threadPool = &value; }
+
+    // Looks call and operator results up in cache before computing them, and stores what was computed.
+    // generation identifies the version of the document being evaluated
+    void setCache(ExprCache *value, uint64_t documentGeneration) {
+        cache = value;
+        generation = documentGeneration;
+    }
+
+    // Answers find() from the hash indexes in indexes, which are kept with the document, instead of a scan
+    void setLookupIndexes(LookupIndexes *value) { indexes = value; }
 
     void visit(const IdentifierExpr &expr) override;
 
@@ -23,20 +55,63 @@ public:
 
     void visit(const BinaryExpr &expr) override;
 
-    [[nodiscard]] std::string jsonValueToString(const JSONValue &value) const;
+    void visit(const WildcardExpr &expr) override;
 
-private:
-    const JSONValue &root;
-    JSONValue currentValue;
-
-    using FunctionType = std::function<JSONValue(const std::vector<JSONValue> &)>;
-    std::unordered_map<std::string, FunctionType> functions;
-
-    [[nodiscard]] static JSONValue getValue(const JSONValue &value, const std::string &key);
+    [[nodiscard]] static std::string jsonValueToString(const JSONValue &value);
 
-    [[nodiscard]] static JSONValue getValue(const JSONValue &value, size_t index);
-
-    void initializeFunctions();
+private:
+    const JSONValue *root = nullptr;
+    const JSONTape *tape = nullptr;
+    const PrecomputedResults *precomputed = nullptr;
+
+    // Value of the last visited expression. Paths refer into the document instead of copying it, so
+    // navigating to an array and aggregating over it copies nothing. Only the value of the outermost
+    // expression is copied, into result
+    JSONValueRef current;
+    // Nesting of evaluate calls; visits at depth 0 are outermost
+    size_t depth = 0;
+    // Values of the Expr::shared nodes evaluated so far. Operands handed to other threads start with the
+    // values of the shared nodes below them
+    std::unordered_map<const Expr *, JSONValueRef> sharedValues;
+    bool parallel = true;
+    ThreadPool *threadPool = nullptr;
+    ExprCache *cache = nullptr;
+    uint64_t generation = 0;
+    // Cache keys of the expression being evaluated, built on the first lookup. Operands handed to other
+    // threads lie below a node keyed before, so they only read the keys
+    std::shared_ptr<ExprCacheKeys> cacheKeys;
+    LookupIndexes *indexes = nullptr;
+
+    // Visits a subexpression and takes its value, or the value it had if it is shared and was evaluated before
+    [[nodiscard]] JSONValueRef evaluate(const Expr &expr);
+
+    // Ends a visit: copies current into result when the visited expression is the outermost one
+    void publish();
+
+    // Takes the precomputed value of expr into current and publishes it, if there is one
+    bool takePrecomputed(const Expr &expr);
+
+    // Takes the cached value of expr into current and publishes it, if there is one. Otherwise sets key to
+    // the key to store the computed value under, or nullptr when expr is not worth caching
+    bool takeCached(const Expr &expr, const std::string *&key);
+
+    void storeCached(const std::string *key);
+
+    // Evaluates the index expressions of the steps of expr into indices and returns the steps
+    [[nodiscard]] std::vector<WildcardStep> wildcardSteps(const WildcardExpr &expr, std::vector<JSONValueRef> &indices);
+
+    // Computes a call of size or of a numeric aggregate with a wildcard argument over the projected values
+    // directly, without building the projected array. Returns false for other calls
+    bool fuseWildcards(const CallExpr &expr, BuiltinFunction function);
+
+    // Evaluates expr with a fresh evaluator over the same document, so it can run on another thread. shared
+    // holds the values of shared nodes below expr
+    [[nodiscard]] JSONValueRef evaluateIsolated(const Expr &expr,
+                                                std::unordered_map<const Expr *, JSONValueRef> shared) const;
+
+    // Evaluates the operands, submitting the non-trivial ones to the ThreadPool when parallel. Shared nodes
+    // below the submitted ones are evaluated here first, so no task computes them again
+    [[nodiscard]] std::vector<JSONValueRef> evaluateOperands(const std::vector<const Expr *> &operands);
 };
 
 #endif // EXPR_EVALUATOR_H
@@ -0,0 +1,481 @@
+#include "expr_functions.h"
+#include "lookup_index.h"
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace {
+
+struct NamedFunction {
+    const char *name;
+    BuiltinFunction function;
+};
+
+const NamedFunction builtins[] = {
+        {"min",               builtinMin},
+        {"max",               builtinMax},
+        {"size",              builtinSize},
+        {"average",           builtinAverage},
+        {"sum",               builtinSum},
+        {"count",             builtinCount},
+        {"variance",          builtinVariance},
+        {"stddev",            builtinStddev},
+        {"median",            builtinMedian},
+        {"percentile",        builtinPercentile},
+        {"approx_median",     builtinApproxMedian},
+        {"approx_percentile", builtinApproxPercentile},
+        {"find",              builtinFind},
+};
+
+const char *functionName(BuiltinFunction function) {
+    for (const NamedFunction &builtin: builtins) {
+        if (builtin.function == function) {
+            return builtin.name;
+        }
+    }
+    return "unknown";
+}
+
+bool takesPercentile(BuiltinFunction function) {
+    return function == builtinPercentile || function == builtinApproxPercentile;
+}
+
+// A call to a numeric aggregate
+JSONValue aggregateNumbers(BuiltinFunction function, const JSONValueRef *args, size_t count) {
+    std::optional<size_t> aggregated = aggregatedArguments(function, count);
+    if (!aggregated) {
+        throw std::runtime_error(std::string(functionName(function)) +
+                                 (takesPercentile(function) ? "() requires exactly two arguments"
+                                                            : "() requires at least one argument"));
+    }
+    NumberAggregate aggregate(function);
+    for (size_t i = 0; i < *aggregated; ++i) {
+        aggregate.addArgument(args[i]);
+    }
+    return aggregate.finish(args + *aggregated);
+}
+
+template<typename Element, typename State>
+void addNumber(const Element &element, State &state) {
+    if (element.isInteger()) {
+        state.addInteger(element.asInteger());
+    } else if (element.isNumber()) {
+        state.addDouble(element.asNumber());
+    }
+}
+
+// Folds the numbers among the elements of array into state, in parallel chunks for large arrays
+template<typename State>
+void foldElements(const JSONValueRef &array, State &state) {
+    auto foldRange = [&array](size_t begin, size_t end, State &partial) {
+        array.forEachElementIn(begin, end, [&partial](const auto &element) { addNumber(element, partial); });
+        return true;
+    };
+    size_t count = array.size();
+    if (auto chunked = reduceChunks<State>(count, 1, foldRange)) {
+        state.merge(std::move(*chunked));
+        return;
+    }
+    foldRange(0, count, state);
+}
+
+// Calls emit(value) for every value that steps[step], steps[step + 1], ... reach from value
+template<typename Emit>
+void walkWildcard(const JSONValueRef &value, const std::vector<WildcardStep> &steps, size_t step,
+                  const JSONValueRef *indices, Emit &emit) {
+    if (step == steps.size()) {
+        emit(value);
+        return;
+    }
+    const WildcardStep &current = steps[step];
+    switch (current.kind) {
+        case WildcardExpr::Step::Kind::Member:
+            if (value.isObject()) {
+                if (auto member = value.findKey(current.member)) {
+                    walkWildcard(*member, steps, step + 1, indices, emit);
+                }
+            }
+            return;
+        case WildcardExpr::Step::Kind::Index: {
+            const JSONValueRef &index = indices[current.index];
+            if (value.isArray() && index.isNumber()) {
+                double position = index.asNumber();
+                if (position >= 0 && position < static_cast<double>(value.size())) {
+                    walkWildcard(value.at(static_cast<size_t>(position)), steps, step + 1, indices, emit);
+                }
+            } else if (value.isObject() && index.isString()) {
+                auto member = index.withString([&value](std::string_view key) { return value.find(key); });
+                if (member) {
+                    walkWildcard(*member, steps, step + 1, indices, emit);
+                }
+            }
+            return;
+        }
+        case WildcardExpr::Step::Kind::Each:
+            if (value.isArray()) {
+                value.forEachElement([&](const auto &element) {
+                    walkWildcard(JSONValueRef::to(element), steps, step + 1, indices, emit);
+                });
+            }
+            return;
+    }
+}
+
+// Folds add(partial, value) over the values of array[*].steps, in parallel chunks for large arrays
+template<typename Partial, typename Add>
+Partial reduceWildcard(const JSONValueRef &array, const std::vector<WildcardStep> &steps,
+                       const JSONValueRef *indices, Add add) {
+    if (!array.isArray()) {
+        throw std::runtime_error("Attempted to apply [*] to non-array");
+    }
+    // Walking never throws, as reduceChunks requires
+    auto reduceRange = [&](size_t begin, size_t end, Partial &partial) {
+        auto emit = [&partial, &add](const JSONValueRef &value) { add(partial, value); };
+        array.forEachElementIn(begin, end, [&](const auto &element) {
+            walkWildcard(JSONValueRef::to(element), steps, 0, indices, emit);
+        });
+        return true;
+    };
+    size_t count = array.size();
+    if (auto chunked = reduceChunks<Partial>(count, 1, reduceRange)) {
+        return std::move(*chunked);
+    }
+    Partial partial;
+    reduceRange(0, count, partial);
+    return partial;
+}
+
+struct WildcardValues {
+    JSONArray values;
+
+    void merge(WildcardValues &&other) {
+        values.insert(values.end(), std::make_move_iterator(other.values.begin()),
+                      std::make_move_iterator(other.values.end()));
+    }
+};
+
+struct WildcardCount {
+    size_t count = 0;
+
+    void merge(const WildcardCount &other) { count += other.count; }
+};
+
+// Integer arithmetic for two int64 operands. Returns nothing when the result does not fit or is not an
+// integer, and the caller falls back to doubles
+std::optional<int64_t> integerArithmetic(BinaryExpr::Operator op, int64_t left, int64_t right) {
+    int64_t result = 0;
+    switch (op) {
+        case BinaryExpr::Operator::Add:
+            return __builtin_add_overflow(left, right, &result) ? std::nullopt : std::optional(result);
+        case BinaryExpr::Operator::Subtract:
+            return __builtin_sub_overflow(left, right, &result) ? std::nullopt : std::optional(result);
+        case BinaryExpr::Operator::Multiply:
+            return __builtin_mul_overflow(left, right, &result) ? std::nullopt : std::optional(result);
+        case BinaryExpr::Operator::Divide:
+            if (right == 0 || (left == std::numeric_limits<int64_t>::min() && right == -1) || left % right != 0) {
+                return std::nullopt;
+            }
+            return left / right;
+        case BinaryExpr::Operator::Modulo:
+            // Same sign convention as std::fmod: the result takes the sign of the dividend
+            if (right == 0) {
+                return std::nullopt;
+            }
+            return right == -1 ? 0 : left % right;
+    }
+    return std::nullopt;
+}
+
+}
+
+JSONValue builtinMin(const JSONValueRef *args, size_t count) {
+    return aggregateNumbers(builtinMin, args, count);
+}
+
+JSONValue builtinMax(const JSONValueRef *args, size_t count) {
+    return aggregateNumbers(builtinMax, args, count);
+}
+
+JSONValue builtinSize(const JSONValueRef *args, size_t count) {
+    if (count != 1) {
+        throw std::runtime_error("size() requires exactly one argument");
+    }
+    const JSONValueRef &arg = args[0];
+    if (arg.isObject() || arg.isArray() || arg.isString()) {
+        return static_cast<int64_t>(arg.size());
+    }
+    throw std::runtime_error("size() argument must be an object, array, or string");
+}
+
+JSONValue builtinAverage(const JSONValueRef *args, size_t count) {
+    return aggregateNumbers(builtinAverage, args, count);
+}
+
+JSONValue builtinSum(const JSONValueRef *args, size_t count) {
+    return aggregateNumbers(builtinSum, args, count);
+}
+
+JSONValue builtinCount(const JSONValueRef *args, size_t count) {
+    return aggregateNumbers(builtinCount, args, count);
+}
+
+JSONValue builtinVariance(const JSONValueRef *args, size_t count) {
+    return aggregateNumbers(builtinVariance, args, count);
+}
+
+JSONValue builtinStddev(const JSONValueRef *args, size_t count) {
+    return aggregateNumbers(builtinStddev, args, count);
+}
+
+JSONValue builtinMedian(const JSONValueRef *args, size_t count) {
+    return aggregateNumbers(builtinMedian, args, count);
+}
+
+JSONValue builtinPercentile(const JSONValueRef *args, size_t count) {
+    return aggregateNumbers(builtinPercentile, args, count);
+}
+
+JSONValue builtinApproxMedian(const JSONValueRef *args, size_t count) {
+    return aggregateNumbers(builtinApproxMedian, args, count);
+}
+
+JSONValue builtinApproxPercentile(const JSONValueRef *args, size_t count) {
+    return aggregateNumbers(builtinApproxPercentile, args, count);
+}
+
+JSONValue builtinFind(const JSONValueRef *args, size_t count) {
+    std::string value = findArguments(args, count);
+    auto found = args[1].withString([&](std::string_view key) { return scanLookup(args[0], key, value); });
+    return found ? found->toJSONValue() : JSONValue();
+}
+
+std::string findArguments(const JSONValueRef *args, size_t count) {
+    if (count != 3) {
+        throw std::runtime_error("find() requires exactly three arguments");
+    }
+    if (!args[0].isArray()) {
+        throw std::runtime_error("find() first argument must be an array");
+    }
+    if (!args[1].isString()) {
+        throw std::runtime_error("find() second argument must be a string");
+    }
+    std::optional<std::string> value = lookupKey(args[2]);
+    if (!value) {
+        throw std::runtime_error("find() value must be a number, string, boolean or null");
+    }
+    return std::move(*value);
+}
+
+BuiltinFunction findBuiltinFunction(std::string_view name) {
+    for (const NamedFunction &builtin: builtins) {
+        if (name == builtin.name) {
+            return builtin.function;
+        }
+    }
+    return nullptr;
+}
+
+bool isNumericAggregate(BuiltinFunction function) {
+    return function != nullptr && function != builtinSize && function != builtinFind;
+}
+
+std::optional<size_t> aggregatedArguments(BuiltinFunction function, size_t count) {
+    if (takesPercentile(function)) {
+        return count == 2 ? std::optional<size_t>(1) : std::nullopt;
+    }
+    return count != 0 ? std::optional(count) : std::nullopt;
+}
+
+NumberAggregate::NumberAggregate(BuiltinFunction function) : function(function) {
+    if (function == builtinVariance || function == builtinStddev) {
+        state = NumericMoments();
+    } else if (function == builtinMedian || function == builtinPercentile) {
+        state = NumberSample();
+    } else if (function == builtinApproxMedian || function == builtinApproxPercentile) {
+        state = QuantileSketch();
+    }
+}
+
+void NumberAggregate::addInteger(int64_t integer) {
+    std::visit([integer](auto &numbers) { numbers.addInteger(integer); }, state);
+}
+
+void NumberAggregate::addDouble(double number) {
+    std::visit([number](auto &numbers) { numbers.addDouble(number); }, state);
+}
+
+void NumberAggregate::addArgument(const JSONValueRef &arg) {
+    if (arg.isNumber()) {
+        addNumber(arg, *this);
+    } else if (!arg.isArray()) {
+        throw std::runtime_error(std::string(functionName(function)) +
+                                 "() arguments must be numbers or arrays of numbers");
+    } else if (auto *summary = std::get_if<NumericSummary>(&state)) {
+        // Through the vector kernels
+        arg.summarizeNumbers(*summary);
+    } else {
+        std::visit([&arg](auto &numbers) { foldElements(arg, numbers); }, state);
+    }
+}
+
+void NumberAggregate::addWildcard(const JSONValueRef &array, const std::vector<WildcardStep> &steps,
+                                  const JSONValueRef *indices) {
+    // The numbers among the projected values, as an array argument contributes them
+    std::visit([&](auto &numbers) {
+        using State = std::decay_t<decltype(numbers)>;
+        numbers.merge(reduceWildcard<State>(array, steps, indices, [](State &partial, const JSONValueRef &value) {
+            addNumber(value, partial);
+        }));
+    }, state);
+}
+
+JSONValue NumberAggregate::finish(const JSONValueRef *parameters) {
+    std::string name = functionName(function);
+    double q = 0.5;
+    if (takesPercentile(function)) {
+        const JSONValueRef &p = parameters[0];
+        if (!p.isNumber() || !(p.asNumber() >= 0 && p.asNumber() <= 100)) {
+            throw std::runtime_error(name + "() p must be a number between 0 and 100");
+        }
+        q = p.asNumber() / 100;
+    }
+    auto empty = [&name] { return std::runtime_error(name + "() requires at least one numeric value"); };
+
+    if (auto *moments = std::get_if<NumericMoments>(&state)) {
+        if (moments->count == 0) {
+            throw empty();
+        }
+        return function == builtinStddev ? std::sqrt(moments->variance()) : moments->variance();
+    }
+    if (auto *sample = std::get_if<NumberSample>(&state)) {
+        if (sample->numbers.empty()) {
+            throw empty();
+        }
+        return exactQuantile(sample->numbers, q);
+    }
+    if (auto *sketch = std::get_if<QuantileSketch>(&state)) {
+        if (sketch->count() == 0) {
+            throw empty();
+        }
+        return sketch->quantile(q);
+    }
+
+    const auto &summary = std::get<NumericSummary>(state);
+    if (function == builtinMin) {
+        return summary.min(std::numeric_limits<double>::max());
+    }
+    if (function == builtinMax) {
+        return summary.max(std::numeric_limits<double>::lowest());
+    }
+    if (function == builtinCount) {
+        return static_cast<int64_t>(summary.count());
+    }
+    if (function == builtinSum) {
+        double total = summary.total();
+        if (summary.doubles == 0 && std::fabs(total) < 9007199254740992.0) {
+            return static_cast<int64_t>(total);
+        }
+        return total;
+    }
+    if (summary.count() == 0) {
+        throw empty();
+    }
+    return summary.total() / static_cast<double>(summary.count());
+}
+
+JSONValue projectWildcard(const JSONValueRef &array, const std::vector<WildcardStep> &steps,
+                          const JSONValueRef *indices) {
+    auto values = reduceWildcard<WildcardValues>(array, steps, indices, [](WildcardValues &partial,
+                                                                           const JSONValueRef &value) {
+        partial.values.push_back(value.toJSONValue());
+    });
+    return std::move(values.values);
+}
+
+size_t countWildcard(const JSONValueRef &array, const std::vector<WildcardStep> &steps,
+                     const JSONValueRef *indices) {
+    return reduceWildcard<WildcardCount>(array, steps, indices, [](WildcardCount &partial, const JSONValueRef &) {
+        ++partial.count;
+    }).count;
+}
+
+JSONValueRef getMember(const JSONValueRef &object, std::string_view key) {
+    if (!object.isObject()) {
+        throw std::runtime_error("Attempted to access member of non-object");
+    }
+    auto member = object.find(key);
+    if (!member) {
+        throw std::runtime_error("Key not found: " + std::string(key));
+    }
+    return std::move(*member);
+}
+
+JSONValueRef getPath(const JSONValueRef &object, const std::vector<JSONString> &keys) {
+    JSONValueRef value = object;
+    for (const JSONString &key: keys) {
+        if (!value.isObject()) {
+            throw std::runtime_error("Attempted to access member of non-object");
+        }
+        auto member = value.findKey(key);
+        if (!member) {
+            throw std::runtime_error("Key not found: " + key.str());
+        }
+        value = std::move(*member);
+    }
+    return value;
+}
+
+JSONValueRef getIndex(const JSONValueRef &container, const JSONValueRef &index) {
+    if (container.isArray()) {
+        if (!index.isNumber()) {
+            throw std::runtime_error("Array index must be a number");
+        }
+        return container.at(static_cast<size_t>(index.asNumber()));
+    }
+    if (container.isObject()) {
+        if (!index.isString()) {
+            throw std::runtime_error("Object index must be a string");
+        }
+        return index.withString([&container](std::string_view key) { return getMember(container, key); });
+    }
+    throw std::runtime_error("Attempted to index non-array/non-object");
+}
+
+JSONValue applyOperator(BinaryExpr::Operator op, const JSONValueRef &left, const JSONValueRef &right) {
+    if (!left.isNumber() || !right.isNumber()) {
+        throw std::runtime_error("Binary operations require numeric operands");
+    }
+
+    if (left.isInteger() && right.isInteger()) {
+        auto integer = integerArithmetic(op, left.asInteger(), right.asInteger());
+        if (integer) {
+            return *integer;
+        }
+    }
+
+    double leftNum = left.asNumber();
+    double rightNum = right.asNumber();
+    switch (op) {
+        case BinaryExpr::Operator::Add:
+            return leftNum + rightNum;
+        case BinaryExpr::Operator::Subtract:
+            return leftNum - rightNum;
+        case BinaryExpr::Operator::Multiply:
+            return leftNum * rightNum;
+        case BinaryExpr::Operator::Divide:
+            if (rightNum == 0) {
+                throw std::runtime_error("Division by zero");
+            }
+            return leftNum / rightNum;
+        case BinaryExpr::Operator::Modulo:
+            if (rightNum == 0) {
+                throw std::runtime_error("Division by zero in modulo operation");
+            }
+            return std::fmod(leftNum, rightNum);
+    }
+    return nullptr;
+}
@@ -0,0 +1,122 @@
+#ifndef EXPR_FUNCTIONS_H
+#define EXPR_FUNCTIONS_H
+
+#include "expr.h"
+#include "json_statistics.h"
+#include "json_value_ref.h"
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+// Operations of the expression language, shared by ExprEvaluator and ExprVM so both evaluate (and fail)
+// exactly alike. Errors are thrown as std::runtime_error
+
+// Builtin function over count arguments starting at args
+using BuiltinFunction = JSONValue (*)(const JSONValueRef *args, size_t count);
+
+JSONValue builtinMin(const JSONValueRef *args, size_t count);
+
+JSONValue builtinMax(const JSONValueRef *args, size_t count);
+
+JSONValue builtinSize(const JSONValueRef *args, size_t count);
+
+JSONValue builtinAverage(const JSONValueRef *args, size_t count);
+
+// Sum of the numbers; an integer while every number is one and the sum stays below 2^53
+JSONValue builtinSum(const JSONValueRef *args, size_t count);
+
+// Number of numbers
+JSONValue builtinCount(const JSONValueRef *args, size_t count);
+
+// Population variance and standard deviation, in a single pass
+JSONValue builtinVariance(const JSONValueRef *args, size_t count);
+
+JSONValue builtinStddev(const JSONValueRef *args, size_t count);
+
+// median(args...) and percentile(values, p) with 0 <= p <= 100, exact: every number is kept and the ranks
+// are selected in linear time
+JSONValue builtinMedian(const JSONValueRef *args, size_t count);
+
+JSONValue builtinPercentile(const JSONValueRef *args, size_t count);
+
+// Same as median and percentile, estimated from a QuantileSketch in constant memory
+JSONValue builtinApproxMedian(const JSONValueRef *args, size_t count);
+
+JSONValue builtinApproxPercentile(const JSONValueRef *args, size_t count);
+
+// find(array, key, value): the first element of array that is an object whose member key equals value, or
+// null. Numbers are equal by value; found by a linear scan
+JSONValue builtinFind(const JSONValueRef *args, size_t count);
+
+// Checks the arguments of find() and returns the lookupKey of its value
+std::string findArguments(const JSONValueRef *args, size_t count);
+
+// nullptr for an unknown name
+BuiltinFunction findBuiltinFunction(std::string_view name);
+
+// Member of an object
+JSONValueRef getMember(const JSONValueRef &object, std::string_view key);
+
+// object.keys[0].keys[1]..., with the errors of a getMember per step
+JSONValueRef getPath(const JSONValueRef &object, const std::vector<JSONString> &keys);
+
+// container[index]: an element for an array and a numeric index, a member for an object and a string index
+JSONValueRef getIndex(const JSONValueRef &container, const JSONValueRef &index);
+
+// Whether function folds the numbers of its arguments: min, max, average, sum, count, variance, stddev and the
+// medians and percentiles
+bool isNumericAggregate(BuiltinFunction function);
+
+// Number of leading arguments of a call to the numeric aggregate function whose numbers are folded; the rest
+// are parameters (the p of percentile). Nothing when function does not take count arguments
+std::optional<size_t> aggregatedArguments(BuiltinFunction function, size_t count);
+
+// Step of a wildcard projection (see WildcardExpr). An Index step reads its index from indices[index]
+struct WildcardStep {
+    WildcardExpr::Step::Kind kind;
+    // Hashed once, for a Member step
+    JSONString member;
+    size_t index = 0;
+};
+
+// array[*].steps as an array. Large arrays are projected in parallel chunks. Throws on a non-array
+JSONValue projectWildcard(const JSONValueRef &array, const std::vector<WildcardStep> &steps,
+                          const JSONValueRef *indices);
+
+// Same as the size of projectWildcard, without building the projected array
+size_t countWildcard(const JSONValueRef &array, const std::vector<WildcardStep> &steps,
+                     const JSONValueRef *indices);
+
+// State of a call to a numeric aggregate while the numbers of its arguments are folded in, with the same
+// bookkeeping and errors as the builtin
+class NumberAggregate {
+public:
+    // function has to be a numeric aggregate
+    explicit NumberAggregate(BuiltinFunction function);
+
+    void addInteger(int64_t integer);
+
+    void addDouble(double number);
+
+    // A number, or the numbers among the elements of an array (in parallel chunks for large arrays)
+    void addArgument(const JSONValueRef &arg);
+
+    // The numbers among the values of array[*].steps, without building the projected array
+    void addWildcard(const JSONValueRef &array, const std::vector<WildcardStep> &steps,
+                     const JSONValueRef *indices);
+
+    // Result of the call. parameters are its arguments after the aggregated ones
+    [[nodiscard]] JSONValue finish(const JSONValueRef *parameters);
+
+private:
+    BuiltinFunction function;
+    std::variant<NumericSummary, NumericMoments, NumberSample, QuantileSketch> state;
+};
+
+// Stays in exact integer arithmetic while both operands are integers and the result is one
+JSONValue applyOperator(BinaryExpr::Operator op, const JSONValueRef &left, const JSONValueRef &right);
+
+#endif // EXPR_FUNCTIONS_H
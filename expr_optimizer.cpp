@@ -0,0 +1,336 @@
+#include "expr_optimizer.h"
+#include "expr_functions.h"
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <optional>
+#include <sstream>
+
+namespace {
+
+// Value of a number or string literal
+std::optional<JSONValue> literalValue(const Expr &expr) {
+    if (const auto *number = dynamic_cast<const NumberExpr *>(&expr); number != nullptr) {
+        return number->integer ? JSONValue(*number->integer) : JSONValue(number->value);
+    }
+    if (const auto *string = dynamic_cast<const StringExpr *>(&expr); string != nullptr) {
+        return JSONValue(string->value);
+    }
+    return std::nullopt;
+}
+
+// Literal for a folded value, nullptr for values that have no literal syntax
+ExprPtr literalExpr(const JSONValue &value) {
+    if (value.isInteger()) {
+        return std::make_shared<NumberExpr>(static_cast<double>(value.asInteger()), value.asInteger());
+    }
+    if (value.isNumber()) {
+        return std::make_shared<NumberExpr>(value.asNumber());
+    }
+    if (value.isString()) {
+        return std::make_shared<StringExpr>(value.asString().str());
+    }
+    return nullptr;
+}
+
+char operatorSymbol(BinaryExpr::Operator op) {
+    switch (op) {
+        case BinaryExpr::Operator::Add:
+            return '+';
+        case BinaryExpr::Operator::Subtract:
+            return '-';
+        case BinaryExpr::Operator::Multiply:
+            return '*';
+        case BinaryExpr::Operator::Divide:
+            return '/';
+        case BinaryExpr::Operator::Modulo:
+            return '%';
+    }
+    return '?';
+}
+
+// Counts the parents of every node of a DAG, visiting each node's children once
+class ParentCounter : public ExprVisitor {
+public:
+    std::unordered_map<Expr *, size_t> parents;
+
+    void count(const ExprPtr &child) {
+        if (parents[child.get()]++ == 0) {
+            child->accept(*this);
+        }
+    }
+
+    void visit(const IdentifierExpr &) override {}
+
+    void visit(const NumberExpr &) override {}
+
+    void visit(const StringExpr &) override {}
+
+    void visit(const MemberExpr &expr) override { count(expr.object); }
+
+    void visit(const SubscriptExpr &expr) override {
+        count(expr.array);
+        count(expr.index);
+    }
+
+    void visit(const CallExpr &expr) override {
+        for (const auto &argument: expr.arguments) {
+            count(argument);
+        }
+    }
+
+    void visit(const BinaryExpr &expr) override {
+        count(expr.left);
+        count(expr.right);
+    }
+
+    void visit(const WildcardExpr &expr) override {
+        count(expr.array);
+        for (const auto &step: expr.steps) {
+            if (step.index) {
+                count(step.index);
+            }
+        }
+    }
+};
+
+// Prints an expression, binding each shared node to a name the first time it is reached
+class ExplainPrinter : public ExprVisitor {
+public:
+    std::string bindings;
+    std::string text;
+
+    std::string print(const Expr &expr) {
+        if (expr.shared) {
+            auto found = names.find(&expr);
+            if (found != names.end()) {
+                return found->second;
+            }
+        }
+        expr.accept(*this);
+        if (!expr.shared) {
+            return text;
+        }
+        std::string name = "$" + std::to_string(names.size() + 1);
+        bindings += name + " = " + text + '\n';
+        names.emplace(&expr, name);
+        return name;
+    }
+
+    void visit(const IdentifierExpr &expr) override { text = expr.name; }
+
+    void visit(const NumberExpr &expr) override {
+        std::ostringstream out;
+        if (expr.integer) {
+            out << *expr.integer;
+        } else {
+            out << std::setprecision(std::numeric_limits<double>::digits10) << expr.value;
+        }
+        text = out.str();
+    }
+
+    void visit(const StringExpr &expr) override {
+        text = "\"";
+        for (char c: expr.value) {
+            if (c == '"' || c == '\\') {
+                text += '\\';
+            }
+            text += c;
+        }
+        text += '"';
+    }
+
+    void visit(const MemberExpr &expr) override { text = print(*expr.object) + "." + expr.member; }
+
+    void visit(const SubscriptExpr &expr) override {
+        std::string array = print(*expr.array);
+        text = array + "[" + print(*expr.index) + "]";
+    }
+
+    void visit(const CallExpr &expr) override {
+        std::string call = expr.callee + "(";
+        for (size_t i = 0; i < expr.arguments.size(); ++i) {
+            call += (i == 0 ? "" : ", ") + print(*expr.arguments[i]);
+        }
+        text = call + ")";
+    }
+
+    void visit(const BinaryExpr &expr) override {
+        std::string left = operand(*expr.left);
+        std::string right = operand(*expr.right);
+        text = left + " " + operatorSymbol(expr.op) + " " + right;
+    }
+
+    void visit(const WildcardExpr &expr) override {
+        std::string projection = print(*expr.array) + "[*]";
+        for (const auto &step: expr.steps) {
+            if (step.kind == WildcardExpr::Step::Kind::Member) {
+                projection += "." + step.member;
+            } else if (step.kind == WildcardExpr::Step::Kind::Index) {
+                projection += "[" + print(*step.index) + "]";
+            } else {
+                projection += "[*]";
+            }
+        }
+        text = projection;
+    }
+
+private:
+    std::unordered_map<const Expr *, std::string> names;
+
+    // Operators nested in operators are parenthesized instead of relying on precedence
+    std::string operand(const Expr &expr) {
+        std::string printed = print(expr);
+        bool nested = !expr.shared && dynamic_cast<const BinaryExpr *>(&expr) != nullptr;
+        return nested ? "(" + printed + ")" : printed;
+    }
+};
+
+}
+
+ExprPtr ExprOptimizer::optimize(const Expr &expr) {
+    ExprOptimizer optimizer;
+    ExprPtr root = optimizer.rewrite(expr);
+
+    ParentCounter counter;
+    root->accept(counter);
+    for (auto &[node, parents]: counter.parents) {
+        // Literals cost nothing to evaluate again
+        node->shared = parents > 1 && !literalValue(*node);
+    }
+    return root;
+}
+
+std::vector<const Expr *> ExprOptimizer::sharedNodes(const Expr &expr) {
+    ParentCounter counter;
+    expr.accept(counter);
+    std::vector<const Expr *> shared;
+    for (const auto &[node, parents]: counter.parents) {
+        if (node->shared) {
+            shared.push_back(node);
+        }
+    }
+    return shared;
+}
+
+std::string ExprOptimizer::explain(const Expr &expr) {
+    ExplainPrinter printer;
+    std::string root = printer.print(expr);
+    return printer.bindings + root + '\n';
+}
+
+void ExprOptimizer::visit(const IdentifierExpr &expr) {
+    intern("I" + expr.name, std::make_shared<IdentifierExpr>(expr.name));
+}
+
+void ExprOptimizer::visit(const NumberExpr &expr) {
+    std::string key;
+    if (expr.integer) {
+        key = "Ni" + std::to_string(*expr.integer);
+    } else {
+        uint64_t bits = 0;
+        std::memcpy(&bits, &expr.value, sizeof(bits));
+        key = "Nd" + std::to_string(bits);
+    }
+    intern(key, std::make_shared<NumberExpr>(expr.value, expr.integer));
+}
+
+void ExprOptimizer::visit(const StringExpr &expr) {
+    intern("S" + expr.value, std::make_shared<StringExpr>(expr.value));
+}
+
+void ExprOptimizer::visit(const MemberExpr &expr) {
+    ExprPtr object = rewrite(*expr.object);
+    std::string key = "M" + id(object) + "." + expr.member;
+    intern(key, std::make_shared<MemberExpr>(object, expr.member));
+}
+
+void ExprOptimizer::visit(const SubscriptExpr &expr) {
+    ExprPtr array = rewrite(*expr.array);
+    ExprPtr index = rewrite(*expr.index);
+    std::string key = "X" + id(array) + "[" + id(index);
+    intern(key, std::make_shared<SubscriptExpr>(array, index));
+}
+
+void ExprOptimizer::visit(const CallExpr &expr) {
+    std::vector<ExprPtr> arguments;
+    std::vector<JSONValueRef> literals;
+    std::string key = "C" + expr.callee + "(";
+    for (const auto &argument: expr.arguments) {
+        arguments.push_back(rewrite(*argument));
+        key += id(arguments.back()) + ",";
+        if (auto value = literalValue(*arguments.back())) {
+            literals.push_back(JSONValueRef::holding(std::move(*value)));
+        }
+    }
+
+    BuiltinFunction function = findBuiltinFunction(expr.callee);
+    if (function != nullptr && literals.size() == arguments.size()) {
+        try {
+            if (ExprPtr folded = literalExpr(function(literals.data(), literals.size()))) {
+                folded->accept(*this);
+                return;
+            }
+        } catch (const std::exception &) {
+            // Left to fail at evaluation
+        }
+    }
+    intern(key, std::make_shared<CallExpr>(expr.callee, std::move(arguments)));
+}
+
+void ExprOptimizer::visit(const BinaryExpr &expr) {
+    ExprPtr left = rewrite(*expr.left);
+    ExprPtr right = rewrite(*expr.right);
+
+    auto leftValue = literalValue(*left);
+    auto rightValue = literalValue(*right);
+    if (leftValue && rightValue) {
+        try {
+            JSONValue value = applyOperator(expr.op, JSONValueRef::holding(std::move(*leftValue)),
+                                            JSONValueRef::holding(std::move(*rightValue)));
+            if (ExprPtr folded = literalExpr(value)) {
+                folded->accept(*this);
+                return;
+            }
+        } catch (const std::exception &) {
+            // Left to fail at evaluation
+        }
+    }
+    std::string key = std::string("B") + operatorSymbol(expr.op) + id(left) + "," + id(right);
+    intern(key, std::make_shared<BinaryExpr>(left, expr.op, right));
+}
+
+void ExprOptimizer::visit(const WildcardExpr &expr) {
+    ExprPtr array = rewrite(*expr.array);
+    std::string key = "W" + id(array);
+    std::vector<WildcardExpr::Step> steps;
+    for (const auto &step: expr.steps) {
+        steps.push_back(step);
+        if (step.kind == WildcardExpr::Step::Kind::Member) {
+            key += "." + step.member;
+        } else if (step.kind == WildcardExpr::Step::Kind::Index) {
+            steps.back().index = rewrite(*step.index);
+            key += "[" + id(steps.back().index) + "]";
+        } else {
+            key += "[*]";
+        }
+    }
+    intern(key, std::make_shared<WildcardExpr>(array, std::move(steps)));
+}
+
+ExprPtr ExprOptimizer::rewrite(const Expr &expr) {
+    expr.accept(*this);
+    return optimized;
+}
+
+void ExprOptimizer::intern(const std::string &key, ExprPtr node) {
+    auto [found, inserted] = nodes.emplace(key, std::move(node));
+    if (inserted) {
+        ids.emplace(found->second.get(), ids.size());
+    }
+    optimized = found->second;
+}
+
+std::string ExprOptimizer::id(const ExprPtr &node) const {
+    return std::to_string(ids.at(node.get()));
+}
@@ -0,0 +1,55 @@
+#ifndef EXPR_OPTIMIZER_H
+#define EXPR_OPTIMIZER_H
+
+#include "expr_visitor.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Rewrites a parsed expression before it is evaluated:
+//   - Constant folding: operators and calls whose operands are all literals become their value. A subtree
+//     that fails, such as 1 / 0, is kept, so the error still surfaces at evaluation
+//   - Hash-consing: structurally equal subexpressions become one node, so the result is a DAG. Nodes with
+//     more than one parent are marked Expr::shared and evaluated once per document. This also hoists
+//     common path prefixes: in a.b[0] + size(a.b), a.b is navigated once
+class ExprOptimizer : public ExprVisitor {
+public:
+    static ExprPtr optimize(const Expr &expr);
+
+    // Distinct Expr::shared nodes of an optimized expression
+    static std::vector<const Expr *> sharedNodes(const Expr &expr);
+
+    // The expression in expression syntax. Shared nodes are bound to $1, $2, ... on lines of their own first
+    static std::string explain(const Expr &expr);
+
+    void visit(const IdentifierExpr &expr) override;
+
+    void visit(const NumberExpr &expr) override;
+
+    void visit(const StringExpr &expr) override;
+
+    void visit(const MemberExpr &expr) override;
+
+    void visit(const SubscriptExpr &expr) override;
+
+    void visit(const CallExpr &expr) override;
+
+    void visit(const BinaryExpr &expr) override;
+
+    void visit(const WildcardExpr &expr) override;
+
+private:
+    // Node of every structure seen so far, keyed by its kind, its fields and the ids of its children
+    std::unordered_map<std::string, ExprPtr> nodes;
+    std::unordered_map<const Expr *, size_t> ids;
+    ExprPtr optimized;
+
+    ExprPtr rewrite(const Expr &expr);
+
+    // Sets optimized to the existing node for key, or to node if there is none yet
+    void intern(const std::string &key, ExprPtr node);
+
+    std::string id(const ExprPtr &node) const;
+};
+
+#endif // EXPR_OPTIMIZER_H
@@ -1,8 +1,10 @@
 #include "expr_parser.h"
+#include "json_scalar.h"
+#include <charconv>
 #include <cctype>
 #include <stdexcept>
 
-ExprParser::ExprParser(const std::string &input) : input(input), pos(0) {}
+ExprParser::ExprParser(std::string_view input) : input(input), pos(0) {}
 
 void ExprParser::skipWhitespace() {
     while (pos < input.size() && std::isspace(static_cast<unsigned char>(input[pos])) != 0) {
@@ -82,6 +84,9 @@ ExprPtr ExprParser::parseFactor() {
             std::string member = parseIdentifier()->name;
             expr = std::make_shared<MemberExpr>(expr, member);
         } else if (match('[')) {
+            if (matchWildcard()) {
+                return parseWildcard(expr);
+            }
             ExprPtr index = parseExpression();
             if (!match(']')) {
                 throw std::runtime_error("Expected ']'");
@@ -94,6 +99,42 @@ ExprPtr ExprParser::parseFactor() {
     return expr;
 }
 
+ExprPtr ExprParser::parseWildcard(ExprPtr array) {
+    std::vector<WildcardExpr::Step> steps;
+    while (true) {
+        if (match('.')) {
+            steps.push_back({WildcardExpr::Step::Kind::Member, parseIdentifier()->name, nullptr});
+        } else if (match('[')) {
+            if (matchWildcard()) {
+                steps.push_back({WildcardExpr::Step::Kind::Each, {}, nullptr});
+                continue;
+            }
+            ExprPtr index = parseExpression();
+            if (!match(']')) {
+                throw std::runtime_error("Expected ']'");
+            }
+            steps.push_back({WildcardExpr::Step::Kind::Index, {}, index});
+        } else {
+            break;
+        }
+    }
+    return std::make_shared<WildcardExpr>(std::move(array), std::move(steps));
+}
+
+bool ExprParser::matchWildcard() {
+    size_t start = pos;
+    skipWhitespace();
+    if (match('*')) {
+        skipWhitespace();
+        if (match(']')) {
+            return true;
+        }
+        throw std::runtime_error("Expected ']'");
+    }
+    pos = start;
+    return false;
+}
+
 ExprPtr ExprParser::parsePrimary() {
     skipWhitespace();
     char chr = peek();
@@ -143,59 +184,34 @@ ExprPtr ExprParser::parseNumber() {
     while (std::isdigit(static_cast<unsigned char>(peek())) != 0) {
         get();
     }
+    bool integral = true;
     if (match('.')) {
+        integral = false;
         while (std::isdigit(static_cast<unsigned char>(peek())) != 0) {
             get();
         }
     }
-    double number = std::stod(input.substr(start, pos - start));
+    const char *first = input.data() + start;
+    const char *last = input.data() + pos;
+    if (integral) {
+        int64_t integer = 0;
+        auto [end, error] = std::from_chars(first, last, integer);
+        if (error == std::errc() && end == last) {
+            return std::make_shared<NumberExpr>(static_cast<double>(integer), integer);
+        }
+    }
+    double number = 0;
+    auto [end, error] = std::from_chars(first, last, number);
+    if (error != std::errc() || end != last) {
+        throw std::runtime_error("Invalid number: " + std::string(first, last));
+    }
     return std::make_shared<NumberExpr>(number);
 }
 
 ExprPtr ExprParser::parseString() {
+    // Same rules as strings in JSON documents, \u escapes and UTF-8 validation included
     std::string result;
-    match('"');
-    while (true) {
-        char chr = get();
-        if (chr == '"') {
-            break;
-        }
-        if (chr == '\\') {
-            chr = get();
-            switch (chr) {
-                case '"':
-                    result += '"';
-                    break;
-                case '\\':
-                    result += '\\';
-                    break;
-                case '/':
-                    result += '/';
-                    break;
-                case 'b':
-                    result += '\b';
-                    break;
-                case 'f':
-                    result += '\f';
-                    break;
-                case 'n':
-                    result += '\n';
-                    break;
-                case 'r':
-                    result += '\r';
-                    break;
-                case 't':
-                    result += '\t';
-                    break;
-                default:
-                    throw std::runtime_error("Invalid escape sequence in string");
-            }
-        }
-        if (chr == '\0') {
-            throw std::runtime_error("Unterminated string literal");
-        }
-        result += chr;
-    }
+    pos = parseJSONString(input, pos, result);
     return std::make_shared<StringExpr>(result);
 }
 
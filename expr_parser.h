@@ -3,15 +3,16 @@
 
 #include "expr.h"
 #include <string>
+#include <string_view>
 
 class ExprParser {
 public:
-    explicit ExprParser(const std::string &input);
+    explicit ExprParser(std::string_view input);
 
     ExprPtr parse();
 
 private:
-    const std::string &input;
+    std::string_view input;
     size_t pos;
 
     void skipWhitespace();
@@ -30,6 +31,12 @@ private:
 
     ExprPtr parsePrimary();
 
+    // The steps after array[*], up to the end of the factor
+    ExprPtr parseWildcard(ExprPtr array);
+
+    // Consumes "*]" after a '[' and returns true, or consumes nothing and returns false
+    bool matchWildcard();
+
     std::shared_ptr<IdentifierExpr> parseIdentifier();
 
     ExprPtr parseNumber();
@@ -0,0 +1,118 @@
+#include "expr_projection.h"
+
+ProjectionNode &ProjectionNode::member(const std::string &name) {
+    auto &child = members[name];
+    if (!child) {
+        child = std::make_unique<ProjectionNode>();
+    }
+    return *child;
+}
+
+ProjectionNode &ProjectionNode::element(size_t index) {
+    auto &child = elements[index];
+    if (!child) {
+        child = std::make_unique<ProjectionNode>();
+    }
+    return *child;
+}
+
+ProjectionNode ProjectionCollector::collect(const Expr &expr) {
+    ProjectionCollector collector;
+    collector.collectWhole(expr);
+    return std::move(collector.root);
+}
+
+bool ProjectionCollector::isStaticPath(const Expr &expr) {
+    if (const auto *identifier = dynamic_cast<const IdentifierExpr *>(&expr); identifier != nullptr) {
+        return identifier->name != "null" && identifier->name != "true" && identifier->name != "false";
+    }
+    if (const auto *member = dynamic_cast<const MemberExpr *>(&expr); member != nullptr) {
+        return isStaticPath(*member->object);
+    }
+    if (const auto *subscript = dynamic_cast<const SubscriptExpr *>(&expr); subscript != nullptr) {
+        const auto *number = dynamic_cast<const NumberExpr *>(subscript->index.get());
+        bool literalIndex = (number != nullptr && number->value >= 0) ||
+                            dynamic_cast<const StringExpr *>(subscript->index.get()) != nullptr;
+        return literalIndex && isStaticPath(*subscript->array);
+    }
+    return false;
+}
+
+void ProjectionCollector::collectWhole(const Expr &expr) {
+    current = nullptr;
+    expr.accept(*this);
+    if (current != nullptr) {
+        current->whole = true;
+    }
+    current = nullptr;
+}
+
+void ProjectionCollector::visit(const IdentifierExpr &expr) {
+    // Same literals ExprEvaluator recognises
+    if (expr.name == "null" || expr.name == "true" || expr.name == "false") {
+        current = nullptr;
+    } else {
+        current = &root.member(expr.name);
+    }
+}
+
+void ProjectionCollector::visit(const NumberExpr &) {
+    current = nullptr;
+}
+
+void ProjectionCollector::visit(const StringExpr &) {
+    current = nullptr;
+}
+
+void ProjectionCollector::visit(const MemberExpr &expr) {
+    expr.object->accept(*this);
+    if (current != nullptr) {
+        current = &current->member(expr.member);
+    }
+}
+
+void ProjectionCollector::visit(const SubscriptExpr &expr) {
+    expr.array->accept(*this);
+    ProjectionNode *container = current;
+
+    if (const auto *number = dynamic_cast<const NumberExpr *>(expr.index.get());
+            number != nullptr && number->value >= 0) {
+        current = container != nullptr ? &container->element(static_cast<size_t>(number->value)) : nullptr;
+        return;
+    }
+    if (const auto *string = dynamic_cast<const StringExpr *>(expr.index.get()); string != nullptr) {
+        current = container != nullptr ? &container->member(string->value) : nullptr;
+        return;
+    }
+
+    // Dynamic subscript: the container is needed in full, and so is whatever the index reads
+    collectWhole(*expr.index);
+    if (container != nullptr) {
+        container->whole = true;
+    }
+    current = nullptr;
+}
+
+void ProjectionCollector::visit(const CallExpr &expr) {
+    for (const auto &arg: expr.arguments) {
+        collectWhole(*arg);
+    }
+    current = nullptr;
+}
+
+void ProjectionCollector::visit(const BinaryExpr &expr) {
+    collectWhole(*expr.left);
+    collectWhole(*expr.right);
+    current = nullptr;
+}
+
+void ProjectionCollector::visit(const WildcardExpr &expr) {
+    // Every element can be reached, so the array is needed in full
+    collectWhole(*expr.array);
+    for (const auto &step: expr.steps) {
+        if (step.index) {
+            collectWhole(*step.index);
+        }
+    }
+    current = nullptr;
+}
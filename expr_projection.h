@@ -0,0 +1,59 @@
+#ifndef EXPR_PROJECTION_H
+#define EXPR_PROJECTION_H
+
+#include "expr_visitor.h"
+#include "json_string.h"
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// Tree of the document paths an expression can reach. A node marked whole is needed in full; otherwise
+// only its listed members/elements are. JSONParser uses it to build just those parts of the document
+struct ProjectionNode {
+    bool whole = false;
+    std::unordered_map<JSONString, std::unique_ptr<ProjectionNode>> members;
+    // Ordered, so the parser knows the highest index it has to keep
+    std::map<size_t, std::unique_ptr<ProjectionNode>> elements;
+
+    ProjectionNode &member(const std::string &name);
+
+    ProjectionNode &element(size_t index);
+};
+
+// Collects the static paths of an expression: IdentifierExpr -> MemberExpr -> SubscriptExpr chains with
+// literal subscripts. A chain that ends in a dynamic subscript such as a.b[a.b[1]] needs its whole
+// container, because the index is only known after evaluation
+class ProjectionCollector : public ExprVisitor {
+public:
+    static ProjectionNode collect(const Expr &expr);
+
+    // True for identifier/member chains with only literal subscripts
+    static bool isStaticPath(const Expr &expr);
+
+    void visit(const IdentifierExpr &expr) override;
+
+    void visit(const NumberExpr &expr) override;
+
+    void visit(const StringExpr &expr) override;
+
+    void visit(const MemberExpr &expr) override;
+
+    void visit(const SubscriptExpr &expr) override;
+
+    void visit(const CallExpr &expr) override;
+
+    void visit(const BinaryExpr &expr) override;
+
+    void visit(const WildcardExpr &expr) override;
+
+protected:
+    ProjectionNode root;
+    // Node the visited expression resolves to, nullptr when it is not a static path
+    ProjectionNode *current = nullptr;
+
+    // Visits an expression whose value is consumed as a whole (function argument, operand, result)
+    void collectWhole(const Expr &expr);
+};
+
+#endif // EXPR_PROJECTION_H
@@ -22,6 +22,8 @@ public:
 
     virtual void visit(const BinaryExpr &expr) = 0;
 
+    virtual void visit(const WildcardExpr &expr) = 0;
+
     JSONValue result;
 };
 
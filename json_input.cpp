@@ -0,0 +1,113 @@
+#include "json_input.h"
+#include "decompression.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+constexpr size_t readChunkSize = 1 << 16;
+
+JSONInput::JSONInput(const std::string &path) {
+    if (path == "-") {
+        readAll(STDIN_FILENO);
+        decompressIfNeeded();
+        return;
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY); // NOLINT
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open JSON file: " + path + " (" + std::strerror(errno) + ")");
+    }
+
+    struct stat info{};
+    if (::fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        auto size = static_cast<size_t>(info.st_size);
+        void *addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED) {
+            // The parser walks the document front to back, so let the kernel read ahead aggressively
+            ::madvise(addr, size, MADV_SEQUENTIAL);
+            ::madvise(addr, size, MADV_WILLNEED);
+            mappedData = static_cast<const char *>(addr);
+            mappedSize = size;
+            ::close(fd);
+            decompressIfNeeded();
+            return;
+        }
+    }
+
+    // Not mappable (pipe, device, empty or exotic file system). Read it the ordinary way
+    try {
+        readAll(fd);
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+    decompressIfNeeded();
+}
+
+JSONInput::~JSONInput() {
+    release();
+}
+
+JSONInput::JSONInput(JSONInput &&other) noexcept
+        : mappedData(std::exchange(other.mappedData, nullptr)),
+          mappedSize(std::exchange(other.mappedSize, 0)),
+          buffer(std::move(other.buffer)) {}
+
+JSONInput &JSONInput::operator=(JSONInput &&other) noexcept {
+    if (this != &other) {
+        release();
+        mappedData = std::exchange(other.mappedData, nullptr);
+        mappedSize = std::exchange(other.mappedSize, 0);
+        buffer = std::move(other.buffer);
+    }
+    return *this;
+}
+
+std::string_view JSONInput::view() const {
+    if (mappedData != nullptr) {
+        return {mappedData, mappedSize};
+    }
+    return buffer;
+}
+
+void JSONInput::readAll(int fd) {
+    while (true) {
+        size_t oldSize = buffer.size();
+        buffer.resize(oldSize + readChunkSize);
+        ssize_t count = ::read(fd, &buffer[oldSize], readChunkSize);
+        if (count < 0) {
+            if (errno == EINTR) {
+                buffer.resize(oldSize);
+                continue;
+            }
+            throw std::runtime_error(std::string("Failed to read JSON input: ") + std::strerror(errno));
+        }
+        buffer.resize(oldSize + static_cast<size_t>(count));
+        if (count == 0) {
+            break;
+        }
+    }
+}
+
+void JSONInput::decompressIfNeeded() {
+    Compression compression = detectCompression(view());
+    if (compression != Compression::None) {
+        std::string text = decompress(view(), compression);
+        release();
+        buffer = std::move(text);
+    }
+}
+
+void JSONInput::release() {
+    if (mappedData != nullptr) {
+        ::munmap(const_cast<char *>(mappedData), mappedSize); // NOLINT
+        mappedData = nullptr;
+        mappedSize = 0;
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef JSON_INPUT_H
+#define JSON_INPUT_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Read-only contents of a JSON file. Regular files are memory-mapped so the parser can work
+// directly on the page cache without copying. Pipes, character devices and stdin ("-") fall back
+// to a buffered read into an owned string. Gzip and zstd files are recognized by their magic bytes and
+// decompressed into the owned string.
+class JSONInput {
+public:
+    explicit JSONInput(const std::string &path);
+
+    ~JSONInput();
+
+    JSONInput(const JSONInput &) = delete;
+
+    JSONInput &operator=(const JSONInput &) = delete;
+
+    JSONInput(JSONInput &&other) noexcept;
+
+    JSONInput &operator=(JSONInput &&other) noexcept;
+
+    [[nodiscard]] std::string_view view() const;
+
+    [[nodiscard]] bool isMapped() const { return mappedData != nullptr; }
+
+private:
+    const char *mappedData = nullptr;
+    size_t mappedSize = 0;
+    std::string buffer;
+
+    void readAll(int fd);
+
+    // Replaces compressed contents with their decompressed text
+    void decompressIfNeeded();
+
+    void release();
+};
+
+#endif // JSON_INPUT_H
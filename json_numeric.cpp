@@ -0,0 +1,280 @@
+#include "json_numeric.h"
+#include "json_tape.h"
+#include <algorithm>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define JSON_EVAL_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+void NumericSummary::merge(const NumericSummary &other) {
+    minDouble = std::min(minDouble, other.minDouble);
+    maxDouble = std::max(maxDouble, other.maxDouble);
+    minInteger = std::min(minInteger, other.minInteger);
+    maxInteger = std::max(maxInteger, other.maxInteger);
+    doubles += other.doubles;
+    integers += other.integers;
+    addToSum(other.sum);
+    compensation += other.compensation;
+}
+
+JSONValue NumericSummary::min(double initial) const {
+    if (doubles == 0) {
+        return integers == 0 ? JSONValue(initial) : JSONValue(minInteger);
+    }
+    return integers == 0 ? minDouble : std::min(minDouble, static_cast<double>(minInteger));
+}
+
+JSONValue NumericSummary::max(double initial) const {
+    if (doubles == 0) {
+        return integers == 0 ? JSONValue(initial) : JSONValue(maxInteger);
+    }
+    return integers == 0 ? maxDouble : std::max(maxDouble, static_cast<double>(maxInteger));
+}
+
+namespace {
+
+constexpr uint64_t doubleTag = static_cast<uint64_t>(TapeTag::Double);
+constexpr uint64_t integerTag = static_cast<uint64_t>(TapeTag::Integer);
+
+size_t summarizeRunScalar(const uint64_t *words, size_t count, NumericSummary &summary) {
+    size_t i = 0;
+    for (; i + 1 < count; i += 2) {
+        uint64_t tag = words[i] >> JSONTape::tagShift;
+        if (tag == doubleTag) {
+            double number = 0;
+            std::memcpy(&number, &words[i + 1], sizeof(number));
+            summary.addDouble(number);
+        } else if (tag == integerTag) {
+            summary.addInteger(static_cast<int64_t>(words[i + 1]));
+        } else {
+            break;
+        }
+    }
+    return i;
+}
+
+// Per-lane accumulators of a vector kernel, stored to memory and folded into summary
+template<size_t Lanes>
+struct LaneTotals {
+    alignas(64) double sum[Lanes];
+    alignas(64) double compensation[Lanes];
+    alignas(64) double minDouble[Lanes];
+    alignas(64) double maxDouble[Lanes];
+    alignas(64) int64_t minInteger[Lanes];
+    alignas(64) int64_t maxInteger[Lanes];
+    size_t doubles = 0;
+    size_t integers = 0;
+
+    void foldInto(NumericSummary &summary) const {
+        NumericSummary lanes;
+        for (size_t lane = 0; lane < Lanes; ++lane) {
+            lanes.addToSum(sum[lane]);
+            lanes.compensation += compensation[lane];
+            lanes.minDouble = std::min(lanes.minDouble, minDouble[lane]);
+            lanes.maxDouble = std::max(lanes.maxDouble, maxDouble[lane]);
+            lanes.minInteger = std::min(lanes.minInteger, minInteger[lane]);
+            lanes.maxInteger = std::max(lanes.maxInteger, maxInteger[lane]);
+        }
+        lanes.doubles = doubles;
+        lanes.integers = integers;
+        summary.merge(lanes);
+    }
+};
+
+#ifdef JSON_EVAL_X86_KERNELS
+
+// Neumaier's compensated addition, lane by lane
+__attribute__((target("avx2")))
+inline void addToSumAVX2(__m256d &sum, __m256d &compensation, __m256d numbers) {
+    const __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x(std::numeric_limits<int64_t>::max()));
+    __m256d total = _mm256_add_pd(sum, numbers);
+    __m256d sumIsLarger = _mm256_cmp_pd(_mm256_and_pd(sum, absMask), _mm256_and_pd(numbers, absMask), _CMP_GE_OQ);
+    __m256d larger = _mm256_blendv_pd(numbers, sum, sumIsLarger);
+    __m256d smaller = _mm256_blendv_pd(sum, numbers, sumIsLarger);
+    compensation = _mm256_add_pd(compensation, _mm256_add_pd(_mm256_sub_pd(larger, total), smaller));
+    sum = total;
+}
+
+// Four number pairs per step: two loads, whose even words are the tags and odd words the values. A step
+// of doubles or of integers is reduced in the vector lanes, a mixed one goes through the scalar loop
+__attribute__((target("avx2")))
+size_t summarizeRunAVX2(const uint64_t *words, size_t count, NumericSummary &summary) {
+    const __m256i doubleTags = _mm256_set1_epi64x(static_cast<int64_t>(doubleTag));
+    const __m256i integerTags = _mm256_set1_epi64x(static_cast<int64_t>(integerTag));
+    __m256d sum = _mm256_setzero_pd();
+    __m256d compensation = _mm256_setzero_pd();
+    __m256d minDouble = _mm256_set1_pd(std::numeric_limits<double>::max());
+    __m256d maxDouble = _mm256_set1_pd(std::numeric_limits<double>::lowest());
+    __m256i minInteger = _mm256_set1_epi64x(std::numeric_limits<int64_t>::max());
+    __m256i maxInteger = _mm256_set1_epi64x(std::numeric_limits<int64_t>::min());
+    LaneTotals<4> totals;
+
+    size_t i = 0;
+    while (i + 8 <= count) {
+        __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words + i));
+        __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(words + i + 4));
+        __m256i tags = _mm256_srli_epi64(_mm256_unpacklo_epi64(low, high), JSONTape::tagShift);
+        __m256i bits = _mm256_unpackhi_epi64(low, high);
+        if (_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(tags, doubleTags))) == 0xF) {
+            __m256d numbers = _mm256_castsi256_pd(bits);
+            minDouble = _mm256_min_pd(minDouble, numbers);
+            maxDouble = _mm256_max_pd(maxDouble, numbers);
+            addToSumAVX2(sum, compensation, numbers);
+            totals.doubles += 4;
+            i += 8;
+        } else if (_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(tags, integerTags))) == 0xF) {
+            minInteger = _mm256_blendv_epi8(minInteger, bits, _mm256_cmpgt_epi64(minInteger, bits));
+            maxInteger = _mm256_blendv_epi8(maxInteger, bits, _mm256_cmpgt_epi64(bits, maxInteger));
+            // AVX2 has no int64 to double conversion
+            alignas(32) int64_t integers[4];
+            _mm256_store_si256(reinterpret_cast<__m256i *>(integers), bits);
+            addToSumAVX2(sum, compensation,
+                         _mm256_setr_pd(static_cast<double>(integers[0]), static_cast<double>(integers[1]),
+                                        static_cast<double>(integers[2]), static_cast<double>(integers[3])));
+            totals.integers += 4;
+            i += 8;
+        } else {
+            size_t taken = summarizeRunScalar(words + i, 8, summary);
+            i += taken;
+            if (taken < 8) {
+                break;
+            }
+        }
+    }
+    i += summarizeRunScalar(words + i, i < count ? count - i : 0, summary);
+
+    _mm256_store_pd(totals.sum, sum);
+    _mm256_store_pd(totals.compensation, compensation);
+    _mm256_store_pd(totals.minDouble, minDouble);
+    _mm256_store_pd(totals.maxDouble, maxDouble);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(totals.minInteger), minInteger);
+    _mm256_store_si256(reinterpret_cast<__m256i *>(totals.maxInteger), maxInteger);
+    totals.foldInto(summary);
+    return i;
+}
+
+__attribute__((target("avx512f")))
+inline void addToSumAVX512(__m512d &sum, __m512d &compensation, __m512d numbers) {
+    __m512d total = _mm512_add_pd(sum, numbers);
+    __mmask8 sumIsLarger = _mm512_cmp_pd_mask(_mm512_abs_pd(sum), _mm512_abs_pd(numbers), _CMP_GE_OQ);
+    __m512d larger = _mm512_mask_blend_pd(sumIsLarger, numbers, sum);
+    __m512d smaller = _mm512_mask_blend_pd(sumIsLarger, sum, numbers);
+    compensation = _mm512_add_pd(compensation, _mm512_add_pd(_mm512_sub_pd(larger, total), smaller));
+    sum = total;
+}
+
+// Same as the AVX2 kernel with eight pairs per step, and integers converted in the vector unit
+__attribute__((target("avx512f,avx512dq")))
+size_t summarizeRunAVX512(const uint64_t *words, size_t count, NumericSummary &summary) {
+    const __m512i doubleTags = _mm512_set1_epi64(static_cast<int64_t>(doubleTag));
+    const __m512i integerTags = _mm512_set1_epi64(static_cast<int64_t>(integerTag));
+    // Operations below use their zero-masked forms with every lane selected. The plain ones start from an
+    // undefined vector, which GCC reports as possibly uninitialized under -Wall
+    const __mmask8 allLanes = 0xFF;
+    __m512d sum = _mm512_setzero_pd();
+    __m512d compensation = _mm512_setzero_pd();
+    __m512d minDouble = _mm512_set1_pd(std::numeric_limits<double>::max());
+    __m512d maxDouble = _mm512_set1_pd(std::numeric_limits<double>::lowest());
+    __m512i minInteger = _mm512_set1_epi64(std::numeric_limits<int64_t>::max());
+    __m512i maxInteger = _mm512_set1_epi64(std::numeric_limits<int64_t>::min());
+    LaneTotals<8> totals;
+
+    size_t i = 0;
+    while (i + 16 <= count) {
+        __m512i low = _mm512_loadu_si512(words + i);
+        __m512i high = _mm512_loadu_si512(words + i + 8);
+        __m512i tags = _mm512_maskz_srli_epi64(allLanes, _mm512_maskz_unpacklo_epi64(allLanes, low, high),
+                                               JSONTape::tagShift);
+        __m512i bits = _mm512_maskz_unpackhi_epi64(allLanes, low, high);
+        if (_mm512_cmpeq_epi64_mask(tags, doubleTags) == 0xFF) {
+            __m512d numbers = _mm512_castsi512_pd(bits);
+            minDouble = _mm512_maskz_min_pd(allLanes, minDouble, numbers);
+            maxDouble = _mm512_maskz_max_pd(allLanes, maxDouble, numbers);
+            addToSumAVX512(sum, compensation, numbers);
+            totals.doubles += 8;
+            i += 16;
+        } else if (_mm512_cmpeq_epi64_mask(tags, integerTags) == 0xFF) {
+            minInteger = _mm512_maskz_min_epi64(allLanes, minInteger, bits);
+            maxInteger = _mm512_maskz_max_epi64(allLanes, maxInteger, bits);
+            addToSumAVX512(sum, compensation, _mm512_maskz_cvtepi64_pd(allLanes, bits));
+            totals.integers += 8;
+            i += 16;
+        } else {
+            size_t taken = summarizeRunScalar(words + i, 16, summary);
+            i += taken;
+            if (taken < 16) {
+                break;
+            }
+        }
+    }
+    i += summarizeRunScalar(words + i, i < count ? count - i : 0, summary);
+
+    _mm512_store_pd(totals.sum, sum);
+    _mm512_store_pd(totals.compensation, compensation);
+    _mm512_store_pd(totals.minDouble, minDouble);
+    _mm512_store_pd(totals.maxDouble, maxDouble);
+    _mm512_store_si512(totals.minInteger, minInteger);
+    _mm512_store_si512(totals.maxInteger, maxInteger);
+    totals.foldInto(summary);
+    return i;
+}
+
+#endif // JSON_EVAL_X86_KERNELS
+
+} // namespace
+
+bool isNumericKernelSupported(NumericKernel kernel) {
+    switch (kernel) {
+        case NumericKernel::Scalar:
+            return true;
+#ifdef JSON_EVAL_X86_KERNELS
+        case NumericKernel::AVX2:
+            return __builtin_cpu_supports("avx2") != 0;
+        case NumericKernel::AVX512:
+            return __builtin_cpu_supports("avx512f") != 0 && __builtin_cpu_supports("avx512dq") != 0;
+#endif
+        default:
+            return false;
+    }
+}
+
+NumericKernel bestNumericKernel() {
+    static const NumericKernel best = [] {
+        if (isNumericKernelSupported(NumericKernel::AVX512)) {
+            return NumericKernel::AVX512;
+        }
+        if (isNumericKernelSupported(NumericKernel::AVX2)) {
+            return NumericKernel::AVX2;
+        }
+        return NumericKernel::Scalar;
+    }();
+    return best;
+}
+
+const char *numericKernelName(NumericKernel kernel) {
+    switch (kernel) {
+        case NumericKernel::Scalar:
+            return "scalar";
+        case NumericKernel::AVX2:
+            return "avx2";
+        case NumericKernel::AVX512:
+            return "avx512";
+    }
+    return "unknown";
+}
+
+size_t summarizeNumberRun(const uint64_t *words, size_t count, NumericSummary &summary, NumericKernel kernel) {
+#ifdef JSON_EVAL_X86_KERNELS
+    if (kernel == NumericKernel::AVX512 && isNumericKernelSupported(kernel)) {
+        return summarizeRunAVX512(words, count, summary);
+    }
+    if (kernel == NumericKernel::AVX2 && isNumericKernelSupported(kernel)) {
+        return summarizeRunAVX2(words, count, summary);
+    }
+#else
+    (void) kernel;
+#endif
+    return summarizeRunScalar(words, count, summary);
+}
@@ -0,0 +1,130 @@
+#ifndef JSON_NUMERIC_H
+#define JSON_NUMERIC_H
+
+#include "json_parser.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Running min, max and sum over numbers, as min(), max() and average() need them. Integers are tracked
+// exactly beside the doubles, so min and max stay integers while every number seen is one. The sum is
+// compensated (Neumaier's variant of Kahan summation): its error stays at a few ulps however many numbers
+// are added and in whichever order the kernels below add them
+struct NumericSummary {
+    // Over the doubles only; integers are folded in by min() and max()
+    double minDouble = std::numeric_limits<double>::max();
+    double maxDouble = std::numeric_limits<double>::lowest();
+    int64_t minInteger = std::numeric_limits<int64_t>::max();
+    int64_t maxInteger = std::numeric_limits<int64_t>::min();
+    size_t doubles = 0;
+    size_t integers = 0;
+    double sum = 0;
+    double compensation = 0;
+
+    void addInteger(int64_t integer) {
+        minInteger = integer < minInteger ? integer : minInteger;
+        maxInteger = integer > maxInteger ? integer : maxInteger;
+        ++integers;
+        addToSum(static_cast<double>(integer));
+    }
+
+    void addDouble(double number) {
+        minDouble = number < minDouble ? number : minDouble;
+        maxDouble = number > maxDouble ? number : maxDouble;
+        ++doubles;
+        addToSum(number);
+    }
+
+    void addToSum(double number) {
+        double total = sum + number;
+        if ((sum < 0 ? -sum : sum) >= (number < 0 ? -number : number)) {
+            compensation += (sum - total) + number;
+        } else {
+            compensation += (number - total) + sum;
+        }
+        sum = total;
+    }
+
+    void merge(const NumericSummary &other);
+
+    [[nodiscard]] size_t count() const { return doubles + integers; }
+
+    [[nodiscard]] double total() const { return sum + compensation; }
+
+    // initial when no number was added
+    [[nodiscard]] JSONValue min(double initial) const;
+
+    [[nodiscard]] JSONValue max(double initial) const;
+};
+
+// Vector unit that reduces runs of numbers on a JSONTape. A number there is a (tag, bits) word pair, so a
+// run of them is a strided array of doubles or integers that the kernels load whole and deinterleave
+enum class NumericKernel {
+    Scalar, AVX2, AVX512
+};
+
+NumericKernel bestNumericKernel();
+
+bool isNumericKernelSupported(NumericKernel kernel);
+
+const char *numericKernelName(NumericKernel kernel);
+
+// Adds the run of number pairs at the start of the tape words [words, words + count) to summary and
+// returns how many words it took: the run ends at the first word that is not a number tag
+size_t summarizeNumberRun(const uint64_t *words, size_t count, NumericSummary &summary,
+                          NumericKernel kernel = bestNumericKernel());
+
+// Arrays of at least this many elements are summarized in chunks on the shared ThreadPool
+constexpr size_t parallelSummaryThreshold = size_t{1} << 18;
+
+// Splits [0, count) into chunks of a multiple of granularity, calls reduceRange(begin, end, partial) for each
+// on pool and merges the partials in order with Partial::merge. reduceRange returns false when its chunk cannot
+// be reduced on its own. Then, or when the pool has a single thread, nothing is returned and the caller
+// reduces the whole range itself
+template<typename Partial, typename Fn>
+std::optional<Partial> reduceChunks(size_t count, size_t granularity, Fn &&reduceRange,
+                                    ThreadPool &pool = ThreadPool::shared()) {
+    size_t chunks = std::min(pool.concurrency() * 4, count / (parallelSummaryThreshold / 4));
+    if (pool.concurrency() == 1 || chunks < 2) {
+        return std::nullopt;
+    }
+    size_t chunkSize = (count / chunks + granularity - 1) / granularity * granularity;
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for (size_t begin = 0; begin < count; begin += chunkSize) {
+        ranges.emplace_back(begin, std::min(count, begin + chunkSize));
+    }
+
+    std::vector<Partial> partials(ranges.size());
+    std::vector<std::future<bool>> futures(ranges.size());
+    for (size_t i = 1; i < ranges.size(); ++i) {
+        futures[i] = pool.submit([&reduceRange, &range = ranges[i], &partial = partials[i]] {
+            return reduceRange(range.first, range.second, partial);
+        });
+    }
+    // Reducing does not throw, so every submitted chunk is awaited
+    bool complete = reduceRange(ranges[0].first, ranges[0].second, partials[0]);
+    for (size_t i = 1; i < ranges.size(); ++i) {
+        complete = pool.wait(futures[i]) && complete;
+    }
+    if (!complete) {
+        return std::nullopt;
+    }
+    for (size_t i = 1; i < partials.size(); ++i) {
+        partials[0].merge(std::move(partials[i]));
+    }
+    return std::move(partials[0]);
+}
+
+// reduceChunks over NumericSummary partials
+template<typename Fn>
+std::optional<NumericSummary> summarizeChunks(size_t count, size_t granularity, Fn &&summarizeRange,
+                                              ThreadPool &pool = ThreadPool::shared()) {
+    return reduceChunks<NumericSummary>(count, granularity, std::forward<Fn>(summarizeRange), pool);
+}
+
+#endif // JSON_NUMERIC_H
@@ -0,0 +1,276 @@
+#include "json_parallel_parser.h"
+#include "json_scalar.h"
+#include "expr_projection.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cctype>
+#include <exception>
+#include <future>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+// Runs fn on every piece and returns the results in order. Pieces of at least minAsyncBytes go to the shared
+// ThreadPool, the rest (and the first piece) run on the calling thread
+template<typename Piece, typename Fn>
+auto runPieces(const std::vector<Piece> &pieces, size_t minAsyncBytes, Fn &&fn) {
+    using Result = decltype(fn(pieces.front()));
+    ThreadPool &pool = ThreadPool::shared();
+    std::vector<std::future<Result>> futures(pieces.size());
+    for (size_t i = 1; i < pieces.size(); ++i) {
+        if (pieces[i].range.end - pieces[i].range.begin >= minAsyncBytes) {
+            futures[i] = pool.submit([&fn, &piece = pieces[i]] { return fn(piece); });
+        }
+    }
+    std::vector<Result> results;
+    results.reserve(pieces.size());
+    std::exception_ptr error;
+    // Submitted pieces reference fn, so all of them are awaited even after a failure
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        try {
+            if (futures[i].valid()) {
+                results.push_back(pool.wait(futures[i]));
+            } else if (!error) {
+                results.push_back(fn(pieces[i]));
+            }
+        } catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return results;
+}
+
+}
+
+ParallelJSONParser::ParallelJSONParser(std::string_view input, const ProjectionNode *projection, size_t threads,
+                                       StringStorage storage)
+        : input(input), projection(projection),
+          threads(threads != 0 ? threads : ThreadPool::defaultConcurrency()), storage(storage) {}
+
+JSONValue ParallelJSONParser::parse() {
+    try {
+        return parseRange({0, input.size()}, projection);
+    } catch (const std::exception &) {
+        // Pieces fail with messages about their own ranges. Parsing the document again on one thread
+        // reports the error exactly as JSONParser does
+        return JSONParser(input, projection, storage).parse();
+    }
+}
+
+JSONValue ParallelJSONParser::parseRange(Range range, const ProjectionNode *node) {
+    if (threads <= 1 || range.end - range.begin < minParallelBytes) {
+        return parseSequential(range, node);
+    }
+    size_t open = range.begin;
+    while (open < range.end && std::isspace(static_cast<unsigned char>(input[open])) != 0) {
+        ++open;
+    }
+    if (open == range.end || (input[open] != '[' && input[open] != '{')) {
+        return parseSequential(range, node);
+    }
+
+    std::vector<Range> elements = scanElements(range, open);
+    bool isObject = input[open] == '{';
+    if (node != nullptr && !node->whole) {
+        return isObject ? parseProjectedObject(elements, *node) : parseProjectedArray(elements, *node);
+    }
+    return isObject ? parseObject(elements) : parseArray(elements);
+}
+
+JSONValue ParallelJSONParser::parseSequential(Range range, const ProjectionNode *node) {
+    return JSONParser(input.substr(range.begin, range.end - range.begin), node, storage).parse();
+}
+
+// Walks the structural index of the range with a depth counter; every comma at depth one ends an element.
+// Anything malformed (empty elements, mismatched brackets, trailing characters) throws, and parse()
+// falls back to the sequential parser for the error message
+std::vector<ParallelJSONParser::Range> ParallelJSONParser::scanElements(Range range, size_t open) {
+    std::string_view container = input.substr(open, range.end - open);
+    StructuralIndex index(container);
+    index.next();
+
+    char close = container[0] == '[' ? ']' : '}';
+    std::vector<Range> elements;
+    size_t elementBegin = open + 1;
+    bool hasContent = false;
+    size_t depth = 1;
+    while (true) {
+        size_t position = index.next();
+        if (position >= container.size()) {
+            throw std::runtime_error("Unterminated container");
+        }
+        char chr = container[position];
+        if (depth == 1 && (chr == ',' || chr == close)) {
+            if (hasContent) {
+                elements.push_back({elementBegin, open + position});
+            } else if (chr == ',' || !elements.empty()) {
+                throw std::runtime_error("Empty element");
+            }
+            if (chr == close) {
+                break;
+            }
+            elementBegin = open + position + 1;
+            hasContent = false;
+            continue;
+        }
+        hasContent = true;
+        if (chr == '{' || chr == '[') {
+            ++depth;
+        } else if ((chr == '}' || chr == ']') && --depth == 0) {
+            throw std::runtime_error("Mismatched bracket");
+        }
+    }
+    if (index.peek() != container.size()) {
+        throw std::runtime_error("Extra characters after parsing JSON value");
+    }
+    return elements;
+}
+
+// Aims for one piece per thread. Elements big enough to be worth splitting themselves become single pieces
+std::vector<ParallelJSONParser::Piece> ParallelJSONParser::groupElements(const std::vector<Range> &elements) const {
+    std::vector<Piece> pieces;
+    if (elements.empty()) {
+        return pieces;
+    }
+    size_t pieceBytes = std::max<size_t>((elements.back().end - elements.front().begin) / threads, 1);
+    size_t pieceBegin = elements.front().begin;
+    for (size_t i = 0; i < elements.size(); ++i) {
+        const Range &element = elements[i];
+        size_t elementBytes = element.end - element.begin;
+        if (elementBytes >= minParallelBytes && elementBytes >= pieceBytes / 2) {
+            if (i > 0 && pieceBegin < element.begin) {
+                pieces.push_back({{pieceBegin, elements[i - 1].end}, false});
+            }
+            pieces.push_back({element, true});
+            pieceBegin = i + 1 < elements.size() ? elements[i + 1].begin : element.end;
+        } else if (element.end - pieceBegin >= pieceBytes || i + 1 == elements.size()) {
+            pieces.push_back({{pieceBegin, element.end}, false});
+            pieceBegin = i + 1 < elements.size() ? elements[i + 1].begin : element.end;
+        }
+    }
+    return pieces;
+}
+
+ParallelJSONParser::Range ParallelJSONParser::splitMember(Range member, JSONString &key) const {
+    size_t quote = member.begin;
+    while (quote < member.end && std::isspace(static_cast<unsigned char>(input[quote])) != 0) {
+        ++quote;
+    }
+    if (quote == member.end || input[quote] != '"') {
+        throw std::runtime_error("Expected string key in object");
+    }
+    bool escaped = false;
+    size_t colon = scanJSONString(input.substr(0, member.end), quote, escaped);
+    if (escaped) {
+        key = JSONString::borrowEscaped(input.substr(quote, colon - quote)).str();
+    } else if (storage == StringStorage::Borrow) {
+        key = JSONString::borrow(input.substr(quote + 1, colon - quote - 2));
+    } else {
+        key = std::string(input.substr(quote + 1, colon - quote - 2));
+    }
+    while (colon < member.end && std::isspace(static_cast<unsigned char>(input[colon])) != 0) {
+        ++colon;
+    }
+    if (colon == member.end || input[colon] != ':') {
+        throw std::runtime_error("Expected ':' after key in object");
+    }
+    return {colon + 1, member.end};
+}
+
+JSONValue ParallelJSONParser::parseArray(const std::vector<Range> &elements) {
+    auto parts = runPieces(groupElements(elements), 0, [this](const Piece &piece) {
+        if (piece.single) {
+            JSONArray single;
+            single.push_back(parseRange(piece.range, nullptr));
+            return single;
+        }
+        return JSONParser(input.substr(piece.range.begin, piece.range.end - piece.range.begin), nullptr, storage)
+                .parseElements();
+    });
+
+    JSONArray arr;
+    arr.reserve(elements.size());
+    for (auto &part: parts) {
+        std::move(part.begin(), part.end(), std::back_inserter(arr));
+    }
+    return arr;
+}
+
+JSONValue ParallelJSONParser::parseObject(const std::vector<Range> &members) {
+    auto parts = runPieces(groupElements(members), 0, [this](const Piece &piece) {
+        if (piece.single) {
+            JSONString key;
+            Range value = splitMember(piece.range, key);
+            JSONObject single;
+            single.emplace(std::move(key), parseRange(value, nullptr));
+            return single;
+        }
+        return JSONParser(input.substr(piece.range.begin, piece.range.end - piece.range.begin), nullptr, storage)
+                .parseMembers();
+    });
+
+    if (parts.empty()) {
+        return JSONObject{};
+    }
+    // Later pieces overwrite earlier ones, so the last of a repeated key wins as in JSONParser
+    JSONObject obj = std::move(parts.front());
+    obj.reserve(members.size());
+    for (size_t i = 1; i < parts.size(); ++i) {
+        for (auto &member: parts[i]) {
+            obj.insert_or_assign(member.first, std::move(member.second));
+        }
+    }
+    return obj;
+}
+
+// Same shape as JSONParser's projection: null placeholders up to each projected index, nothing past the last
+JSONValue ParallelJSONParser::parseProjectedArray(const std::vector<Range> &elements, const ProjectionNode &node) {
+    std::vector<Piece> pieces;
+    std::vector<size_t> positions;
+    for (const auto &[position, child]: node.elements) {
+        if (position >= elements.size()) {
+            break;
+        }
+        pieces.push_back({elements[position], true, child.get()});
+        positions.push_back(position);
+    }
+    auto values = runPieces(pieces, minParallelBytes, [this](const Piece &piece) {
+        return parseRange(piece.range, piece.node);
+    });
+
+    JSONArray arr;
+    for (size_t i = 0; i < values.size(); ++i) {
+        arr.resize(positions[i]);
+        arr.push_back(std::move(values[i]));
+    }
+    return arr;
+}
+
+JSONValue ParallelJSONParser::parseProjectedObject(const std::vector<Range> &members, const ProjectionNode &node) {
+    std::vector<Piece> pieces;
+    std::vector<JSONString> keys;
+    for (const Range &member: members) {
+        JSONString key;
+        Range value = splitMember(member, key);
+        auto child = node.members.find(key);
+        if (child != node.members.end()) {
+            pieces.push_back({value, true, child->second.get()});
+            keys.push_back(std::move(key));
+        }
+    }
+    auto values = runPieces(pieces, minParallelBytes, [this](const Piece &piece) {
+        return parseRange(piece.range, piece.node);
+    });
+
+    JSONObject obj;
+    for (size_t i = 0; i < values.size(); ++i) {
+        obj.insert_or_assign(std::move(keys[i]), std::move(values[i]));
+    }
+    return obj;
+}
@@ -0,0 +1,70 @@
+#ifndef JSON_PARALLEL_PARSER_H
+#define JSON_PARALLEL_PARSER_H
+
+#include "json_parser.h"
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+// Parses large containers on several threads. A container of at least minParallelBytes is pre-scanned on
+// the structural index (which is quote- and escape-aware) for the commas between its elements, the
+// elements are grouped into byte ranges of similar size, and each range is parsed by its own JSONParser.
+// The pieces are stitched back together in document order. Elements that are large on their own are
+// split the same way, so a large array nested in a small object still spreads across threads.
+// The result, including projection and repeated-key handling, is exactly what JSONParser produces.
+class ParallelJSONParser {
+public:
+    static constexpr size_t defaultMinParallelBytes = 1 << 20;
+
+    // threads == 0 uses ThreadPool::defaultConcurrency()
+    explicit ParallelJSONParser(std::string_view input, const ProjectionNode *projection = nullptr,
+                                size_t threads = 0, StringStorage storage = StringStorage::Copy);
+
+    // Containers smaller than this are parsed on the calling thread
+    void setMinParallelBytes(size_t bytes) { minParallelBytes = bytes; }
+
+    JSONValue parse();
+
+private:
+    struct Range {
+        size_t begin;
+        size_t end;
+    };
+
+    // One unit of work: a run of elements parsed by a single JSONParser, or one element (single) that
+    // goes through parseRange again with its projection node
+    struct Piece {
+        Range range;
+        bool single;
+        const ProjectionNode *node = nullptr;
+    };
+
+    std::string_view input;
+    const ProjectionNode *projection;
+    size_t threads;
+    StringStorage storage;
+    size_t minParallelBytes = defaultMinParallelBytes;
+
+    JSONValue parseRange(Range range, const ProjectionNode *node);
+
+    JSONValue parseSequential(Range range, const ProjectionNode *node);
+
+    // Element (or member) ranges of the container opening at open, without the separating commas
+    std::vector<Range> scanElements(Range range, size_t open);
+
+    // Groups consecutive elements into pieces of about the same size; large elements stay on their own
+    std::vector<Piece> groupElements(const std::vector<Range> &elements) const;
+
+    // Splits a member range into its key and the range of its value
+    Range splitMember(Range member, JSONString &key) const;
+
+    JSONValue parseArray(const std::vector<Range> &elements);
+
+    JSONValue parseObject(const std::vector<Range> &members);
+
+    JSONValue parseProjectedArray(const std::vector<Range> &elements, const ProjectionNode &node);
+
+    JSONValue parseProjectedObject(const std::vector<Range> &members, const ProjectionNode &node);
+};
+
+#endif // JSON_PARALLEL_PARSER_H
@@ -1,48 +1,37 @@
 #include "json_parser.h"
+#include "json_scalar.h"
+#include "expr_projection.h"
 #include <cctype>
 #include <stdexcept>
 #include <string>
 
-constexpr size_t falseTokenLength = 5;
-constexpr size_t trueTokenLength = 4;
-constexpr size_t nullTokenLength = 4;
+JSONParser::JSONParser(std::string_view input) : input(input), index(input) {}
 
-JSONParser::JSONParser(const std::string &input) : input(input), pos(0) {}
+JSONParser::JSONParser(std::string_view input, const ProjectionNode *projection, StringStorage storage)
+        : input(input), index(input), projection(projection), storage(storage) {}
 
-void JSONParser::skipWhitespace() {
-    while (pos < input.size() && std::isspace(static_cast<unsigned char>(input[pos])) != 0) {
-        ++pos;
-    }
-}
-
-char JSONParser::peek() const {
-    return pos < input.size() ? input[pos] : '\0';
-}
-
-char JSONParser::get() {
-    return pos < input.size() ? input[pos++] : '\0';
+char JSONParser::peek() {
+    size_t next = index.peek();
+    return next < input.size() ? input[next] : '\0';
 }
 
 bool JSONParser::match(char expected) {
     if (peek() == expected) {
-        ++pos;
+        index.next();
         return true;
     }
     return false;
 }
 
 JSONValue JSONParser::parse() {
-    skipWhitespace();
-    JSONValue value = parseValue();
-    skipWhitespace();
-    if (pos != input.size()) {
+    JSONValue value = projection != nullptr ? parseValue(projection) : parseValue();
+    if (index.peek() != input.size()) {
         throw std::runtime_error("Extra characters after parsing JSON value");
     }
     return value;
 }
 
 JSONValue JSONParser::parseValue() {
-    skipWhitespace();
     char chr = peek();
     if (chr == '"') {
         return parseString();
@@ -71,24 +60,18 @@ JSONValue JSONParser::parseValue() {
 JSONValue JSONParser::parseObject() {
     JSONObject obj;
     match('{');
-    skipWhitespace();
     if (match('}')) {
         return obj;
     }
     while (true) {
-        skipWhitespace();
         if (peek() != '"') {
             throw std::runtime_error("Expected string key in object");
         }
-        std::string key = parseRawString();
-        skipWhitespace();
+        JSONString key = parseKey();
         if (!match(':')) {
             throw std::runtime_error("Expected ':' after key in object");
         }
-        skipWhitespace();
-        JSONValue value = parseValue();
-        obj[key] = value;
-        skipWhitespace();
+        obj.insert_or_assign(std::move(key), parseValue());
         if (match('}')) {
             break;
         }
@@ -102,14 +85,11 @@ JSONValue JSONParser::parseObject() {
 JSONValue JSONParser::parseArray() {
     JSONArray arr;
     match('[');
-    skipWhitespace();
     if (match(']')) {
         return arr;
     }
     while (true) {
-        skipWhitespace();
         arr.push_back(parseValue());
-        skipWhitespace();
         if (match(']')) {
             break;
         }
@@ -120,101 +100,181 @@ JSONValue JSONParser::parseArray() {
     return arr;
 }
 
-std::string JSONParser::parseRawString() {
-    std::string result;
-    match('"');
+JSONArray JSONParser::parseElements() {
+    JSONArray arr;
     while (true) {
-        char chr = get();
-        if (chr == '"') {
+        arr.push_back(parseValue());
+        if (index.peek() == input.size()) {
             break;
         }
-        if (chr == '\\') {
-            chr = get();
-            switch (chr) {
-                case '"':
-                    result += '"';
-                    break;
-                case '\\':
-                    result += '\\';
-                    break;
-                case '/':
-                    result += '/';
-                    break;
-                case 'b':
-                    result += '\b';
-                    break;
-                case 'f':
-                    result += '\f';
-                    break;
-                case 'n':
-                    result += '\n';
-                    break;
-                case 'r':
-                    result += '\r';
-                    break;
-                case 't':
-                    result += '\t';
-                    break;
-                default:
-                    throw std::runtime_error(std::string("Invalid escape character: \\") + chr);
-            }
-        } else if (chr == '\0') {
-            throw std::runtime_error("Unterminated string");
-        } else {
-            result += chr;
+        if (!match(',')) {
+            throw std::runtime_error("Expected ',' or ']' in array");
         }
     }
-    return result;
+    return arr;
 }
 
-JSONValue JSONParser::parseString() {
-    return parseRawString();
+JSONObject JSONParser::parseMembers() {
+    JSONObject obj;
+    while (true) {
+        if (peek() != '"') {
+            throw std::runtime_error("Expected string key in object");
+        }
+        JSONString key = parseKey();
+        if (!match(':')) {
+            throw std::runtime_error("Expected ':' after key in object");
+        }
+        obj.insert_or_assign(std::move(key), parseValue());
+        if (index.peek() == input.size()) {
+            break;
+        }
+        if (!match(',')) {
+            throw std::runtime_error("Expected ',' or '}' in object");
+        }
+    }
+    return obj;
 }
 
-JSONValue JSONParser::parseNumber() {
-    size_t start = pos;
-    if (match('-')) {}
-    while (std::isdigit(static_cast<unsigned char>(peek())) != 0) {
-        get();
+JSONValue JSONParser::parseValue(const ProjectionNode *node) {
+    if (node == nullptr || node->whole) {
+        return parseValue();
+    }
+    char chr = peek();
+    if (chr == '{') {
+        return parseProjectedObject(*node);
+    }
+    if (chr == '[') {
+        return parseProjectedArray(*node);
+    }
+    return parseValue();
+}
+
+JSONValue JSONParser::parseProjectedObject(const ProjectionNode &node) {
+    JSONObject obj;
+    match('{');
+    if (match('}')) {
+        return obj;
+    }
+    while (true) {
+        if (peek() != '"') {
+            throw std::runtime_error("Expected string key in object");
+        }
+        JSONString key = parseKey();
+        if (!match(':')) {
+            throw std::runtime_error("Expected ':' after key in object");
+        }
+        auto member = node.members.find(key);
+        if (member != node.members.end()) {
+            obj.insert_or_assign(std::move(key), parseValue(member->second.get()));
+        } else {
+            skipValue();
+        }
+        if (match('}')) {
+            break;
+        }
+        if (!match(',')) {
+            throw std::runtime_error("Expected ',' or '}' in object");
+        }
+    }
+    return obj;
+}
+
+// Elements before a projected index are kept as null placeholders so indices still line up. Nothing
+// is added past the highest projected index
+JSONValue JSONParser::parseProjectedArray(const ProjectionNode &node) {
+    JSONArray arr;
+    match('[');
+    if (match(']')) {
+        return arr;
     }
-    if (match('.')) {
-        while (std::isdigit(static_cast<unsigned char>(peek())) != 0) {
-            get();
+    for (size_t position = 0;; ++position) {
+        auto element = node.elements.find(position);
+        if (element != node.elements.end()) {
+            arr.resize(position);
+            arr.push_back(parseValue(element->second.get()));
+        } else {
+            skipValue();
+        }
+        if (match(']')) {
+            break;
+        }
+        if (!match(',')) {
+            throw std::runtime_error("Expected ',' or ']' in array");
         }
     }
-    if (peek() == 'e' || peek() == 'E') {
-        get();
-        if (peek() == '+' || peek() == '-') {
-            get();
+    return arr;
+}
+
+// Skips one value by counting brackets on the structural index. Scalars inside skipped values are
+// not looked at, so only the nesting of a skipped value is validated
+void JSONParser::skipValue() {
+    size_t start = index.next();
+    char chr = start < input.size() ? input[start] : '\0';
+    if (chr == '\0' || chr == ',' || chr == ':' || chr == ']' || chr == '}') {
+        throw std::runtime_error(std::string("Unexpected character: ") + chr);
+    }
+    if (chr != '{' && chr != '[') {
+        return;
+    }
+    size_t depth = 1;
+    while (depth > 0) {
+        size_t next = index.next();
+        if (next >= input.size()) {
+            throw std::runtime_error(chr == '{' ? "Expected ',' or '}' in object" : "Expected ',' or ']' in array");
         }
-        while (std::isdigit(static_cast<unsigned char>(peek())) != 0) {
-            get();
+        char current = input[next];
+        if (current == '{' || current == '[') {
+            ++depth;
+        } else if (current == '}' || current == ']') {
+            --depth;
         }
     }
-    double number = std::stod(input.substr(start, pos - start));
-    return number;
 }
 
-JSONValue JSONParser::parseTrue() {
-    if (input.substr(pos, trueTokenLength) == "true") {
-        pos += trueTokenLength;
-        return true;
+JSONString JSONParser::parseKey() {
+    JSONString key = parseRawString();
+    return key.hasEscapes() ? JSONString(key.str()) : key;
+}
+
+JSONString JSONParser::parseRawString() {
+    size_t start = index.next();
+    if (storage == StringStorage::Copy) {
+        std::string result;
+        parseJSONString(input, start, result);
+        return result;
     }
-    throw std::runtime_error("Invalid value, expected 'true'");
+    bool escaped = false;
+    size_t end = scanJSONString(input, start, escaped);
+    if (escaped) {
+        return JSONString::borrowEscaped(input.substr(start, end - start));
+    }
+    return JSONString::borrow(input.substr(start + 1, end - start - 2));
 }
 
-JSONValue JSONParser::parseFalse() {
-    if (input.substr(pos, falseTokenLength) == "false") {
-        pos += falseTokenLength;
-        return false;
+JSONValue JSONParser::parseString() {
+    return parseRawString();
+}
+
+JSONValue JSONParser::parseNumber() {
+    JSONNumber number;
+    parseJSONNumber(input, index.next(), number);
+    if (number.isInteger) {
+        return number.integer;
     }
-    throw std::runtime_error("Invalid value, expected 'false'");
+    return number.real;
+}
+
+JSONValue JSONParser::parseTrue() {
+    parseJSONLiteral(input, index.next(), "true");
+    return true;
+}
+
+JSONValue JSONParser::parseFalse() {
+    parseJSONLiteral(input, index.next(), "false");
+    return false;
 }
 
 JSONValue JSONParser::parseNull() {
-    if (input.substr(pos, nullTokenLength) == "null") {
-        pos += nullTokenLength;
-        return nullptr;
-    }
-    throw std::runtime_error("Invalid value, expected 'null'");
+    parseJSONLiteral(input, index.next(), "null");
+    return nullptr;
 }
@@ -1,23 +1,30 @@
 #ifndef JSON_PARSER_H
 #define JSON_PARSER_H
 
+#include "json_string.h"
+#include "json_structural_index.h"
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 #include <variant>
 
 class JSONValue;
 
+struct ProjectionNode;
+
 using JSONArray = std::vector<JSONValue>;
-using JSONObject = std::unordered_map<std::string, JSONValue>;
+using JSONObject = std::unordered_map<JSONString, JSONValue>;
 
 class JSONValue {
 public:
     using ValueType = std::variant<
             std::nullptr_t,
             bool,
+            int64_t,
             double,
-            std::string,
+            JSONString,
             JSONArray,
             JSONObject>;
 
@@ -27,11 +34,17 @@ public:
 
     JSONValue(bool b) : value(b) {}
 
+    JSONValue(int i) : value(int64_t{i}) {}
+
+    JSONValue(int64_t i) : value(i) {}
+
     JSONValue(double d) : value(d) {}
 
-    JSONValue(const std::string &s) : value(s) {}
+    JSONValue(std::string s) : value(JSONString(std::move(s))) {}
+
+    JSONValue(const char *s) : value(JSONString(s)) {}
 
-    JSONValue(const char *s) : value(std::string(s)) {}
+    JSONValue(JSONString s) : value(std::move(s)) {}
 
     JSONValue(const JSONArray &arr) : value(arr) {}
 
@@ -44,9 +57,13 @@ public:
 
     bool isBool() const { return std::holds_alternative<bool>(value); }
 
-    bool isNumber() const { return std::holds_alternative<double>(value); }
+    // Integers and doubles are both numbers; asNumber() converts integers
+    bool isNumber() const { return isInteger() || std::holds_alternative<double>(value); }
 
-    bool isString() const { return std::holds_alternative<std::string>(value); }
+    // Integral JSON numbers that fit into int64_t are stored exactly
+    bool isInteger() const { return std::holds_alternative<int64_t>(value); }
+
+    bool isString() const { return std::holds_alternative<JSONString>(value); }
 
     bool isArray() const { return std::holds_alternative<JSONArray>(value); }
 
@@ -55,35 +72,67 @@ public:
     // Value access methods
     bool asBool() const { return std::get<bool>(value); }
 
-    double asNumber() const { return std::get<double>(value); }
+    double asNumber() const {
+        return isInteger() ? static_cast<double>(std::get<int64_t>(value)) : std::get<double>(value);
+    }
+
+    int64_t asInteger() const { return std::get<int64_t>(value); }
 
-    const std::string &asString() const { return std::get<std::string>(value); }
+    const JSONString &asString() const { return std::get<JSONString>(value); }
 
     const JSONArray &asArray() const { return std::get<JSONArray>(value); }
 
     const JSONObject &asObject() const { return std::get<JSONObject>(value); }
 };
 
+// How the parser stores strings and keys
+enum class StringStorage {
+    // Unescaped copies; the value does not depend on the input
+    Copy,
+    // Views into the input wherever possible (see JSONString). The input has to outlive the value
+    Borrow
+};
+
+// Two-stage parser. Stage one (StructuralIndex) finds the structural characters with SIMD, stage two walks
+// that index to build the JSONValue tree and only looks at the bytes of the scalars themselves
 class JSONParser {
 public:
-    JSONParser(const std::string &input);
+    JSONParser(std::string_view input);
+
+    // Builds only the parts of the document reachable through projection (see ProjectionCollector).
+    // Everything else is skipped by bracket matching on the structural index, without being parsed
+    JSONParser(std::string_view input, const ProjectionNode *projection,
+               StringStorage storage = StringStorage::Copy);
 
     JSONValue parse();
 
-private:
-    const std::string &input;
-    size_t pos;
+    // Parse a comma-separated run of array elements or object members that spans the whole input, as found
+    // between the brackets of a container. Used for the pieces ParallelJSONParser splits containers into
+    JSONArray parseElements();
 
-    void skipWhitespace();
+    JSONObject parseMembers();
 
-    char peek() const;
+private:
+    std::string_view input;
+    StructuralIndex index;
+    const ProjectionNode *projection = nullptr;
+    StringStorage storage = StringStorage::Copy;
 
-    char get();
+    // First character of the next structural, '\0' at the end of the input
+    char peek();
 
     bool match(char expected);
 
     JSONValue parseValue();
 
+    JSONValue parseValue(const ProjectionNode *node);
+
+    JSONValue parseProjectedObject(const ProjectionNode &node);
+
+    JSONValue parseProjectedArray(const ProjectionNode &node);
+
+    void skipValue();
+
     JSONValue parseObject();
 
     JSONValue parseArray();
@@ -98,7 +147,10 @@ private:
 
     JSONValue parseNull();
 
-    std::string parseRawString();
+    // Keys are always unescaped up front, so hashing them never has to decode
+    JSONString parseKey();
+
+    JSONString parseRawString();
 };
 
 #endif // JSON_PARSER_H
@@ -0,0 +1,221 @@
+#include "json_scalar.h"
+#include "json_utf8.h"
+#include <cctype>
+#include <charconv>
+#include <stdexcept>
+
+namespace {
+
+// Value of the four hex digits of a \u escape starting at pos
+uint32_t parseHex4(std::string_view input, size_t pos) {
+    if (pos + 4 > input.size()) {
+        throw std::runtime_error("Invalid unicode escape: expected four hex digits");
+    }
+    uint32_t value = 0;
+    auto [end, error] = std::from_chars(input.data() + pos, input.data() + pos + 4, value, 16);
+    if (error != std::errc() || end != input.data() + pos + 4) {
+        throw std::runtime_error("Invalid unicode escape: \\u" + std::string(input.substr(pos, 4)));
+    }
+    return value;
+}
+
+void appendUTF8(uint32_t codePoint, std::string &out) {
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+} // namespace
+
+size_t parseJSONString(std::string_view input, size_t pos, std::string &out) {
+    ++pos; // Skip the opening quote
+    while (true) {
+        // Copy everything up to the next quote or backslash in one go. Multi-byte sequences never contain
+        // either byte, so every run can be validated on its own
+        bool nonASCII = false;
+        size_t runEnd = findQuoteOrBackslash(input, pos, nonASCII);
+        if (nonASCII) {
+            expectValidUTF8(input.substr(pos, runEnd - pos));
+        }
+        out.append(input.data() + pos, runEnd - pos);
+        pos = runEnd;
+        if (pos >= input.size()) {
+            throw std::runtime_error("Unterminated string");
+        }
+        if (input[pos++] == '"') {
+            return pos;
+        }
+        pos = unescapeJSON(input, pos, &out);
+    }
+}
+
+size_t scanJSONString(std::string_view input, size_t pos, bool &escaped) {
+    ++pos; // Skip the opening quote
+    escaped = false;
+    while (true) {
+        bool nonASCII = false;
+        size_t runStart = pos;
+        pos = findQuoteOrBackslash(input, pos, nonASCII);
+        if (nonASCII) {
+            expectValidUTF8(input.substr(runStart, pos - runStart));
+        }
+        if (pos >= input.size()) {
+            throw std::runtime_error("Unterminated string");
+        }
+        if (input[pos++] == '"') {
+            return pos;
+        }
+        escaped = true;
+        pos = unescapeJSON(input, pos, nullptr);
+    }
+}
+
+size_t unescapeJSON(std::string_view input, size_t pos, std::string *out) {
+    char chr = pos < input.size() ? input[pos] : '\0';
+    if (chr != 'u') {
+        chr = unescapeJSONChar(chr);
+        if (out != nullptr) {
+            *out += chr;
+        }
+        return pos + 1;
+    }
+    uint32_t codePoint = parseHex4(input, pos + 1);
+    pos += 5;
+    if (codePoint >= 0xDC00 && codePoint <= 0xDFFF) {
+        throw std::runtime_error("Invalid unicode escape: unpaired low surrogate");
+    }
+    if (codePoint >= 0xD800 && codePoint <= 0xDBFF) {
+        if (input.substr(pos, 2) != "\\u") {
+            throw std::runtime_error("Invalid unicode escape: unpaired high surrogate");
+        }
+        uint32_t low = parseHex4(input, pos + 2);
+        if (low < 0xDC00 || low > 0xDFFF) {
+            throw std::runtime_error("Invalid unicode escape: unpaired high surrogate");
+        }
+        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+        pos += 6;
+    }
+    if (out != nullptr) {
+        appendUTF8(codePoint, *out);
+    }
+    return pos;
+}
+
+void expectValidUTF8(std::string_view text) {
+    if (!isValidUTF8(text)) {
+        throw std::runtime_error("Invalid UTF-8 in string");
+    }
+}
+
+char unescapeJSONChar(char escaped) {
+    switch (escaped) {
+        case '"':
+            return '"';
+        case '\\':
+            return '\\';
+        case '/':
+            return '/';
+        case 'b':
+            return '\b';
+        case 'f':
+            return '\f';
+        case 'n':
+            return '\n';
+        case 'r':
+            return '\r';
+        case 't':
+            return '\t';
+        default:
+            throw std::runtime_error(std::string("Invalid escape character: \\") + escaped);
+    }
+}
+
+size_t parseJSONNumber(std::string_view input, size_t pos, JSONNumber &out) {
+    size_t start = pos;
+    bool integral = true;
+    // Integer part, fraction and exponent each need at least one digit
+    bool wellFormed = true;
+    auto skipDigits = [input, &pos, &wellFormed]() {
+        size_t first = pos;
+        while (pos < input.size() && std::isdigit(static_cast<unsigned char>(input[pos])) != 0) {
+            ++pos;
+        }
+        wellFormed = wellFormed && pos > first;
+    };
+    if (input[pos] == '-') {
+        ++pos;
+    }
+    skipDigits();
+    if (pos < input.size() && input[pos] == '.') {
+        integral = false;
+        ++pos;
+        skipDigits();
+    }
+    if (pos < input.size() && (input[pos] == 'e' || input[pos] == 'E')) {
+        integral = false;
+        ++pos;
+        if (pos < input.size() && (input[pos] == '+' || input[pos] == '-')) {
+            ++pos;
+        }
+        skipDigits();
+    }
+    const char *first = input.data() + start;
+    const char *last = input.data() + pos;
+    if (!wellFormed) {
+        throw std::runtime_error("Invalid number: " + std::string(first, last));
+    }
+
+    // "-0" is kept as a double so the sign survives
+    bool negativeZero = integral && *first == '-' && first[1] == '0' && last - first == 2;
+    if (integral && !negativeZero) {
+        auto [end, error] = std::from_chars(first, last, out.integer);
+        if (error == std::errc() && end == last) {
+            out.isInteger = true;
+            expectJSONScalarEnd(input, pos);
+            return pos;
+        }
+        // Too large for int64_t; fall through to a double
+    }
+    out.isInteger = false;
+    auto [end, error] = std::from_chars(first, last, out.real);
+    if (error == std::errc::result_out_of_range) {
+        throw std::runtime_error("Number out of range: " + std::string(first, last));
+    }
+    if (error != std::errc() || end != last) {
+        throw std::runtime_error("Invalid number: " + std::string(first, last));
+    }
+    expectJSONScalarEnd(input, pos);
+    return pos;
+}
+
+size_t parseJSONLiteral(std::string_view input, size_t pos, std::string_view literal) {
+    if (input.substr(pos, literal.size()) != literal) {
+        throw std::runtime_error("Invalid value, expected '" + std::string(literal) + "'");
+    }
+    pos += literal.size();
+    expectJSONScalarEnd(input, pos);
+    return pos;
+}
+
+void expectJSONScalarEnd(std::string_view input, size_t pos) {
+    if (pos < input.size()) {
+        char chr = input[pos];
+        bool isDelimiter = std::isspace(static_cast<unsigned char>(chr)) != 0 ||
+                           chr == ',' || chr == ':' || chr == '[' || chr == ']' || chr == '{' || chr == '}';
+        if (!isDelimiter) {
+            throw std::runtime_error(std::string("Unexpected character: ") + chr);
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef JSON_SCALAR_H
+#define JSON_SCALAR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Byte-level parsing of JSON scalars, shared by every stage two (JSONParser, JSONTapeParser).
+// Each function takes the position of the scalar's first byte and returns the position just past it
+
+// pos is the opening quote. The unescaped contents are appended to out. Strings have to be valid UTF-8;
+// \uXXXX escapes (surrogate pairs included) are decoded to UTF-8
+size_t parseJSONString(std::string_view input, size_t pos, std::string &out);
+
+// Finds the end of the string at pos (the opening quote) without decoding it, validating its escapes and
+// its UTF-8. escaped is set when it contains any escapes
+size_t scanJSONString(std::string_view input, size_t pos, bool &escaped);
+
+// Character a single-character backslash escape stands for, e.g. 'n' -> '\n'
+char unescapeJSONChar(char escaped);
+
+// Decodes the escape whose backslash is at pos - 1, appending its UTF-8 to out (or only validating it when
+// out is nullptr). A high surrogate has to be followed by an escaped low surrogate; the pair is one code
+// point. Returns the position after the escape
+size_t unescapeJSON(std::string_view input, size_t pos, std::string *out);
+
+// Throws unless text (part of a string) is valid UTF-8
+void expectValidUTF8(std::string_view text);
+
+// Integral tokens that fit into int64_t stay exact; everything else (fractions, exponents, larger
+// integers) is a double
+struct JSONNumber {
+    bool isInteger = false;
+    int64_t integer = 0;
+    double real = 0;
+};
+
+// Allocation-free and locale-independent (std::from_chars). Throws on malformed numbers such as "1." or "1e"
+size_t parseJSONNumber(std::string_view input, size_t pos, JSONNumber &out);
+
+// Matches one of the "true", "false" or "null" literals
+size_t parseJSONLiteral(std::string_view input, size_t pos, std::string_view literal);
+
+// A scalar has to run up to whitespace, an operator or the end of the input. Anything glued to it
+// (as in "12ab" or "truex") is never indexed separately by stage one, so it has to be rejected here
+void expectJSONScalarEnd(std::string_view input, size_t pos);
+
+#endif // JSON_SCALAR_H
@@ -0,0 +1,222 @@
+#include "json_snapshot.h"
+#include "json_input.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char snapshotMagic[8] = {'J', 'S', 'N', 'S', 'N', 'A', 'P', '\0'};
+// Bump whenever the tape layout or the header changes
+constexpr uint32_t snapshotVersion = 1;
+// Reads back differently on a machine of the other byte order
+constexpr uint32_t byteOrderMark = 0x01020304;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t sourceSize;
+    int64_t sourceMtimeNanoseconds;
+    uint64_t wordCount;
+    uint64_t arenaSize;
+};
+
+// Keeps the words that follow the header 8-byte aligned in the (page aligned) mapping
+static_assert(sizeof(SnapshotHeader) % alignof(uint64_t) == 0);
+
+// Whether the words and the arena of tape form exactly one value: every tag is known, containers end where
+// their start says with the element count they claim, object keys are strings and strings lie inside the
+// arena. Navigating a tape that passes stays in bounds, however the file was damaged
+bool isWellFormed(const JSONTape &tape) {
+    struct Container {
+        size_t end;
+        bool isObject;
+        bool awaitingValue;
+        uint64_t elements;
+    };
+    size_t count = tape.wordCount();
+    std::string_view arena = tape.arenaBytes();
+    std::vector<Container> open;
+    for (size_t i = 0; i < count;) {
+        TapeTag tag = tape.tag(i);
+        uint64_t payload = tape.payload(i);
+        if (!open.empty() && i == open.back().end) {
+            const Container &container = open.back();
+            if (tag != (container.isObject ? TapeTag::ObjectEnd : TapeTag::ArrayEnd) ||
+                payload != container.elements || container.awaitingValue) {
+                return false;
+            }
+            open.pop_back();
+            ++i;
+            if (open.empty()) {
+                return i == count;
+            }
+            continue;
+        }
+
+        if (!open.empty()) {
+            Container &container = open.back();
+            if (container.isObject && !container.awaitingValue) {
+                if (tag != TapeTag::String) {
+                    return false;
+                }
+                container.awaitingValue = true;
+            } else {
+                container.awaitingValue = false;
+                ++container.elements;
+            }
+        }
+        switch (tag) {
+            case TapeTag::Null:
+            case TapeTag::True:
+            case TapeTag::False:
+                ++i;
+                break;
+            case TapeTag::Double:
+            case TapeTag::Integer:
+                if (i + 1 >= count || (!open.empty() && i + 1 >= open.back().end)) {
+                    return false;
+                }
+                i += 2;
+                break;
+            case TapeTag::String: {
+                uint32_t length = 0;
+                if (payload > arena.size() || arena.size() - payload < sizeof(length)) {
+                    return false;
+                }
+                std::memcpy(&length, arena.data() + payload, sizeof(length));
+                if (arena.size() - payload - sizeof(length) < length) {
+                    return false;
+                }
+                ++i;
+                break;
+            }
+            case TapeTag::ArrayStart:
+            case TapeTag::ObjectStart:
+                if (payload <= i || payload >= count || (!open.empty() && payload >= open.back().end)) {
+                    return false;
+                }
+                open.push_back({payload, tag == TapeTag::ObjectStart, false, 0});
+                ++i;
+                break;
+            default:
+                return false;
+        }
+        if (open.empty()) {
+            return i == count;
+        }
+    }
+    return false;
+}
+
+bool writeAll(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+}
+
+SourceStamp SourceStamp::of(const std::string &path) {
+    struct stat info{};
+    if (::stat(path.c_str(), &info) != 0) {
+        throw std::runtime_error("Failed to stat JSON file: " + path + " (" + std::strerror(errno) + ")");
+    }
+    if (!S_ISREG(info.st_mode)) {
+        throw std::runtime_error("Snapshots need a regular JSON file: " + path);
+    }
+    SourceStamp stamp;
+    stamp.size = static_cast<uint64_t>(info.st_size);
+    stamp.mtimeNanoseconds = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+    return stamp;
+}
+
+void JSONSnapshot::write(const std::string &path, const JSONTape &tape, const SourceStamp &source) {
+    std::string_view arena = tape.arenaBytes();
+    SnapshotHeader header{};
+    std::memcpy(header.magic, snapshotMagic, sizeof(header.magic));
+    header.version = snapshotVersion;
+    header.byteOrder = byteOrderMark;
+    header.sourceSize = source.size;
+    header.sourceMtimeNanoseconds = source.mtimeNanoseconds;
+    header.wordCount = tape.wordCount();
+    header.arenaSize = arena.size();
+
+    // A name of its own, so that concurrent writers of the same snapshot never share a temporary file
+    std::string temporaryPath = path + ".XXXXXX";
+    int fd = ::mkstemp(temporaryPath.data());
+    if (fd < 0) {
+        throw std::runtime_error("Failed to write snapshot: " + path + " (" + std::strerror(errno) + ")");
+    }
+    const char *words = reinterpret_cast<const char *>(tape.mapping ? tape.mappedWords : tape.words.data()); // NOLINT
+    bool written = ::fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) == 0 &&
+                   writeAll(fd, reinterpret_cast<const char *>(&header), sizeof(header)) && // NOLINT
+                   writeAll(fd, words, tape.wordCount() * sizeof(uint64_t)) &&
+                   writeAll(fd, arena.data(), arena.size());
+    written = ::close(fd) == 0 && written;
+    if (!written) {
+        std::remove(temporaryPath.c_str());
+        throw std::runtime_error("Failed to write snapshot: " + temporaryPath);
+    }
+    if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+        std::string reason = std::strerror(errno);
+        std::remove(temporaryPath.c_str());
+        throw std::runtime_error("Failed to write snapshot: " + path + " (" + reason + ")");
+    }
+}
+
+std::optional<JSONTape> JSONSnapshot::load(const std::string &path, const SourceStamp &source) {
+    struct stat info{};
+    if (::stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+        return std::nullopt;
+    }
+    std::shared_ptr<JSONInput> file;
+    try {
+        file = std::make_shared<JSONInput>(path);
+    } catch (const std::exception &) {
+        return std::nullopt;
+    }
+
+    std::string_view bytes = file->view();
+    SnapshotHeader header{};
+    if (bytes.size() < sizeof(header)) {
+        return std::nullopt;
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    if (std::memcmp(header.magic, snapshotMagic, sizeof(header.magic)) != 0 ||
+        header.version != snapshotVersion || header.byteOrder != byteOrderMark ||
+        header.sourceSize != source.size || header.sourceMtimeNanoseconds != source.mtimeNanoseconds) {
+        return std::nullopt;
+    }
+    uint64_t available = bytes.size() - sizeof(header);
+    if (header.wordCount == 0 || header.wordCount > available / sizeof(uint64_t) ||
+        header.arenaSize != available - header.wordCount * sizeof(uint64_t)) {
+        return std::nullopt;
+    }
+
+    JSONTape tape;
+    const char *words = bytes.data() + sizeof(header);
+    tape.mappedWords = reinterpret_cast<const uint64_t *>(words); // NOLINT
+    tape.mappedWordCount = header.wordCount;
+    tape.mappedArena = std::string_view(words + header.wordCount * sizeof(uint64_t), header.arenaSize);
+    tape.mapping = std::move(file);
+    // One pass over the words, still far cheaper than parsing
+    if (!isWellFormed(tape)) {
+        return std::nullopt;
+    }
+    return tape;
+}
@@ -0,0 +1,33 @@
+#ifndef JSON_SNAPSHOT_H
+#define JSON_SNAPSHOT_H
+
+#include "json_tape.h"
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// Size and modification time of a source file. A snapshot is only used while they still match
+struct SourceStamp {
+    uint64_t size = 0;
+    int64_t mtimeNanoseconds = 0;
+
+    // Throws std::runtime_error if path cannot be stat'ed or is not a regular file
+    static SourceStamp of(const std::string &path);
+};
+
+// Binary snapshot of a parsed document, so repeated queries against the same file skip parsing. The file
+// is a fixed header (magic, format version, byte order check, source stamp, section sizes) followed by the
+// words and the string arena of a JSONTape, exactly as they are in memory. Loading maps the file and
+// points a tape at it, so nothing is copied or parsed
+class JSONSnapshot {
+public:
+    // Writes tape to path, through a uniquely named temporary file that is renamed into place so that
+    // concurrent readers never see a partial snapshot and concurrent writers do not mix theirs. Throws std::runtime_error on I/O errors
+    static void write(const std::string &path, const JSONTape &tape, const SourceStamp &source);
+
+    // Maps the snapshot at path and checks that its tape is well-formed. Returns nullopt if it is missing,
+    // malformed, from another format version or byte order, or stamped with a different source
+    static std::optional<JSONTape> load(const std::string &path, const SourceStamp &source);
+};
+
+#endif // JSON_SNAPSHOT_H
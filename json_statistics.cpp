@@ -0,0 +1,146 @@
+#include "json_statistics.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace {
+
+constexpr double pi = 3.14159265358979323846;
+
+}
+
+void NumericMoments::merge(const NumericMoments &other) {
+    if (other.count == 0) {
+        return;
+    }
+    if (count == 0) {
+        *this = other;
+        return;
+    }
+    double left = static_cast<double>(count);
+    double right = static_cast<double>(other.count);
+    double delta = other.mean - mean;
+    count += other.count;
+    mean += delta * right / (left + right);
+    squaredDeviations += other.squaredDeviations + delta * delta * left * right / (left + right);
+}
+
+void NumberSample::merge(NumberSample &&other) {
+    if (numbers.empty()) {
+        numbers = std::move(other.numbers);
+        return;
+    }
+    numbers.insert(numbers.end(), other.numbers.begin(), other.numbers.end());
+}
+
+double exactQuantile(std::vector<double> &numbers, double q) {
+    double position = q * static_cast<double>(numbers.size() - 1);
+    auto below = static_cast<size_t>(position);
+    double fraction = position - static_cast<double>(below);
+    auto nth = numbers.begin() + static_cast<std::ptrdiff_t>(below);
+    std::nth_element(numbers.begin(), nth, numbers.end());
+    double lower = *nth;
+    if (fraction == 0 || below + 1 == numbers.size()) {
+        return lower;
+    }
+    // Everything after the nth element is at least as large, so the next rank is the smallest of those
+    double upper = *std::min_element(std::next(nth), numbers.end());
+    return lower + fraction * (upper - lower);
+}
+
+QuantileSketch::QuantileSketch(double compression) : compression(compression) {}
+
+void QuantileSketch::addDouble(double number) {
+    pending.push_back({number, 1});
+    ++total;
+    minimum = std::min(minimum, number);
+    maximum = std::max(maximum, number);
+    if (static_cast<double>(pending.size()) >= pendingFactor * compression) {
+        compress();
+    }
+}
+
+void QuantileSketch::merge(const QuantileSketch &other) {
+    pending.insert(pending.end(), other.centroids.begin(), other.centroids.end());
+    pending.insert(pending.end(), other.pending.begin(), other.pending.end());
+    total += other.total;
+    minimum = std::min(minimum, other.minimum);
+    maximum = std::max(maximum, other.maximum);
+    if (static_cast<double>(pending.size()) >= pendingFactor * compression) {
+        compress();
+    }
+}
+
+double QuantileSketch::shareLimit(double q) const {
+    // Scale function k(q) = compression / (2 pi) * asin(2q - 1): a centroid spans at most one unit of k
+    double angle = std::asin(2 * q - 1) + 2 * pi / compression;
+    return angle >= pi / 2 ? 1 : (std::sin(angle) + 1) / 2;
+}
+
+void QuantileSketch::compress() {
+    if (pending.empty()) {
+        return;
+    }
+    pending.insert(pending.end(), centroids.begin(), centroids.end());
+    std::sort(pending.begin(), pending.end(), [](const Centroid &left, const Centroid &right) {
+        return left.mean < right.mean;
+    });
+    centroids.clear();
+
+    auto weight = static_cast<double>(total);
+    double before = 0;
+    double limit = weight * shareLimit(0);
+    Centroid current = pending.front();
+    for (auto next = std::next(pending.begin()); next != pending.end(); ++next) {
+        if (before + current.weight + next->weight <= limit) {
+            current.weight += next->weight;
+            current.mean += (next->mean - current.mean) * next->weight / current.weight;
+            continue;
+        }
+        before += current.weight;
+        centroids.push_back(current);
+        limit = weight * shareLimit(before / weight);
+        current = *next;
+    }
+    centroids.push_back(current);
+    pending.clear();
+}
+
+double QuantileSketch::quantile(double q) const {
+    // Pending numbers are taken as centroids of their own, so nothing is merged before it has to be
+    std::vector<Centroid> sorted = pending;
+    sorted.insert(sorted.end(), centroids.begin(), centroids.end());
+    std::sort(sorted.begin(), sorted.end(), [](const Centroid &left, const Centroid &right) {
+        return left.mean < right.mean;
+    });
+    // A centroid of weight w starting at rank r stands for the ranks r .. r + w - 1 and sits at their
+    // middle; the ends of the distribution are pinned by the smallest and the largest number
+    double position = q * static_cast<double>(total - 1);
+    double previousRank = 0;
+    double previousValue = minimum;
+    double before = 0;
+    for (const Centroid &centroid: sorted) {
+        double rank = before + (centroid.weight - 1) / 2;
+        if (position <= rank) {
+            if (rank == previousRank) {
+                return centroid.mean;
+            }
+            double share = (position - previousRank) / (rank - previousRank);
+            return previousValue + share * (centroid.mean - previousValue);
+        }
+        previousRank = rank;
+        previousValue = centroid.mean;
+        before += centroid.weight;
+    }
+    double last = static_cast<double>(total - 1);
+    if (last == previousRank) {
+        return maximum;
+    }
+    return previousValue + (position - previousRank) / (last - previousRank) * (maximum - previousValue);
+}
+
+size_t QuantileSketch::centroidCount() const {
+    QuantileSketch compressed = *this;
+    compressed.compress();
+    return compressed.centroids.size();
+}
@@ -0,0 +1,99 @@
+#ifndef JSON_STATISTICS_H
+#define JSON_STATISTICS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// Accumulators of the statistics builtins. Like NumericSummary, each takes numbers one at a time with
+// addInteger/addDouble and merges with the partial of another chunk, so they fold into a single pass over
+// an array, a projection or a stream
+
+// Running count, mean and sum of squared deviations from the mean (Welford). Partials merge exactly by
+// Chan's formula, so chunked and sequential passes agree up to rounding
+struct NumericMoments {
+    size_t count = 0;
+    double mean = 0;
+    double squaredDeviations = 0;
+
+    void addInteger(int64_t integer) { addDouble(static_cast<double>(integer)); }
+
+    void addDouble(double number) {
+        ++count;
+        double delta = number - mean;
+        mean += delta / static_cast<double>(count);
+        squaredDeviations += delta * (number - mean);
+    }
+
+    void merge(const NumericMoments &other);
+
+    // Population variance; there have to be numbers
+    [[nodiscard]] double variance() const { return squaredDeviations / static_cast<double>(count); }
+};
+
+// Every number, for exact quantiles
+struct NumberSample {
+    std::vector<double> numbers;
+
+    void addInteger(int64_t integer) { numbers.push_back(static_cast<double>(integer)); }
+
+    void addDouble(double number) { numbers.push_back(number); }
+
+    void merge(NumberSample &&other);
+};
+
+// q-quantile (0 <= q <= 1) of numbers, interpolated linearly between the two closest ranks (NumPy's
+// default). Found by selection in linear time, which reorders numbers. numbers must not be empty
+double exactQuantile(std::vector<double> &numbers, double q);
+
+// Merging t-digest (Dunning and Ertl): numbers are clustered into centroids (mean, weight) that are small
+// near the ends of the distribution and large in the middle, so extreme quantiles such as p99 stay accurate.
+// Memory is bounded by the compression whatever the count; sketches of chunks merge into one
+class QuantileSketch {
+public:
+    static constexpr double defaultCompression = 200;
+
+    // Numbers are buffered, and merged into the centroids once this many times the compression are pending
+    static constexpr double pendingFactor = 5;
+
+    explicit QuantileSketch(double compression = defaultCompression);
+
+    void addInteger(int64_t integer) { addDouble(static_cast<double>(integer)); }
+
+    void addDouble(double number);
+
+    void merge(const QuantileSketch &other);
+
+    [[nodiscard]] size_t count() const { return total; }
+
+    // Estimated q-quantile, interpolated like exactQuantile. It is exact until the first compression, which
+    // happens after pendingFactor * compression numbers. There have to be numbers
+    [[nodiscard]] double quantile(double q) const;
+
+    // Centroids after compressing what has been added, at most about compression of them
+    [[nodiscard]] size_t centroidCount() const;
+
+private:
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    double compression;
+    // Sorted by mean
+    std::vector<Centroid> centroids;
+    // Added since the last compression, unsorted
+    std::vector<Centroid> pending;
+    size_t total = 0;
+    double minimum = std::numeric_limits<double>::infinity();
+    double maximum = -std::numeric_limits<double>::infinity();
+
+    // Merges pending into centroids
+    void compress();
+
+    // Largest share of the numbers that can be at or below the end of a centroid starting at share q
+    [[nodiscard]] double shareLimit(double q) const;
+};
+
+#endif // JSON_STATISTICS_H
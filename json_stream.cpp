@@ -0,0 +1,257 @@
+#include "json_stream.h"
+#include "json_scalar.h"
+#include "json_utf8.h"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+namespace {
+
+bool isDelimiter(char chr) {
+    return std::isspace(static_cast<unsigned char>(chr)) != 0 ||
+           chr == ',' || chr == ':' || chr == '[' || chr == ']' || chr == '{' || chr == '}';
+}
+
+std::string describe(int chr) {
+    return std::string("Unexpected character: ") + (chr < 0 ? '\0' : static_cast<char>(chr));
+}
+
+} // namespace
+
+JSONStreamReader::JSONStreamReader(ByteSource &source, size_t bufferSize)
+        : source(source), buffer(std::max<size_t>(bufferSize, 1)) {}
+
+bool JSONStreamReader::refill() {
+    begin = 0;
+    end = source.read(buffer.data(), buffer.size());
+    totalRead += end;
+    return end > 0;
+}
+
+void JSONStreamReader::skipWhitespace() {
+    while (true) {
+        while (begin < end && std::isspace(static_cast<unsigned char>(buffer[begin])) != 0) {
+            ++begin;
+        }
+        if (begin < end || !refill()) {
+            return;
+        }
+    }
+}
+
+bool JSONStreamReader::match(char expected) {
+    if (peek() == static_cast<unsigned char>(expected)) {
+        ++begin;
+        return true;
+    }
+    return false;
+}
+
+bool JSONStreamReader::parse(JSONHandler &handler) {
+    if (!parseValue(handler)) {
+        return false;
+    }
+    skipWhitespace();
+    if (peek() != -1) {
+        throw std::runtime_error("Extra characters after parsing JSON value");
+    }
+    return true;
+}
+
+bool JSONStreamReader::parseValue(JSONHandler &handler) {
+    skipWhitespace();
+    int chr = peek();
+    if (chr == '"') {
+        readString();
+        return handler.string(token) != HandlerAction::Stop;
+    }
+    if (chr == '{') {
+        return parseObject(handler);
+    }
+    if (chr == '[') {
+        return parseArray(handler);
+    }
+
+    HandlerAction action = HandlerAction::Continue;
+    if (chr == 't' || chr == 'f') {
+        readAtom();
+        bool value = chr == 't';
+        parseJSONLiteral(token, 0, value ? "true" : "false");
+        action = handler.boolean(value);
+    } else if (chr == 'n') {
+        readAtom();
+        parseJSONLiteral(token, 0, "null");
+        action = handler.null();
+    } else if (chr == '-' || (chr >= 0 && std::isdigit(chr) != 0)) {
+        readAtom();
+        JSONNumber number;
+        parseJSONNumber(token, 0, number);
+        action = number.isInteger ? handler.integer(number.integer) : handler.number(number.real);
+    } else {
+        throw std::runtime_error(describe(chr));
+    }
+    return action != HandlerAction::Stop;
+}
+
+bool JSONStreamReader::parseObject(JSONHandler &handler) {
+    ++begin; // '{'
+    HandlerAction action = handler.startObject();
+    if (action == HandlerAction::Stop) {
+        return false;
+    }
+    if (action == HandlerAction::Skip) {
+        skipContainer();
+        return true;
+    }
+    skipWhitespace();
+    if (!match('}')) {
+        while (true) {
+            skipWhitespace();
+            if (peek() != '"') {
+                throw std::runtime_error("Expected string key in object");
+            }
+            readString();
+            if (handler.key(token) == HandlerAction::Stop) {
+                return false;
+            }
+            skipWhitespace();
+            if (!match(':')) {
+                throw std::runtime_error("Expected ':' after key in object");
+            }
+            if (!parseValue(handler)) {
+                return false;
+            }
+            skipWhitespace();
+            if (match('}')) {
+                break;
+            }
+            if (!match(',')) {
+                throw std::runtime_error("Expected ',' or '}' in object");
+            }
+        }
+    }
+    return handler.endObject() != HandlerAction::Stop;
+}
+
+bool JSONStreamReader::parseArray(JSONHandler &handler) {
+    ++begin; // '['
+    HandlerAction action = handler.startArray();
+    if (action == HandlerAction::Stop) {
+        return false;
+    }
+    if (action == HandlerAction::Skip) {
+        skipContainer();
+        return true;
+    }
+    skipWhitespace();
+    if (!match(']')) {
+        while (true) {
+            if (!parseValue(handler)) {
+                return false;
+            }
+            skipWhitespace();
+            if (match(']')) {
+                break;
+            }
+            if (!match(',')) {
+                throw std::runtime_error("Expected ',' or ']' in array");
+            }
+        }
+    }
+    return handler.endArray() != HandlerAction::Stop;
+}
+
+void JSONStreamReader::skipContainer() {
+    size_t depth = 1;
+    bool inString = false;
+    bool escaped = false;
+    while (true) {
+        if (begin == end && !refill()) {
+            throw std::runtime_error("Unexpected end of input in skipped container");
+        }
+        for (; begin < end; ++begin) {
+            char chr = buffer[begin];
+            if (inString) {
+                if (escaped) {
+                    escaped = false;
+                } else if (chr == '\\') {
+                    escaped = true;
+                } else if (chr == '"') {
+                    inString = false;
+                }
+            } else if (chr == '"') {
+                inString = true;
+            } else if (chr == '{' || chr == '[') {
+                ++depth;
+            } else if ((chr == '}' || chr == ']') && --depth == 0) {
+                ++begin;
+                return;
+            }
+        }
+    }
+}
+
+void JSONStreamReader::readString() {
+    token.clear();
+    ++begin; // Opening quote
+    // A multi-byte sequence can straddle a refill, so UTF-8 is validated once the whole string is in token
+    bool nonASCII = false;
+    while (true) {
+        if (begin == end && !refill()) {
+            throw std::runtime_error("Unterminated string");
+        }
+        // Copy everything up to the next quote or backslash in one go
+        std::string_view available(buffer.data() + begin, end - begin);
+        size_t runEnd = begin + findQuoteOrBackslash(available, 0, nonASCII);
+        token.append(buffer.data() + begin, runEnd - begin);
+        begin = runEnd;
+        if (begin == end) {
+            continue;
+        }
+        if (buffer[begin++] == '"') {
+            if (nonASCII) {
+                expectValidUTF8(token);
+            }
+            return;
+        }
+        readEscape();
+    }
+}
+
+void JSONStreamReader::readEscape() {
+    // Gather the escape, which may straddle a refill, and decode it with the shared rules
+    std::string escape = "\\";
+    auto take = [this, &escape](size_t count) {
+        for (size_t i = 0; i < count && peek() >= 0; ++i) {
+            escape += buffer[begin++];
+        }
+    };
+    take(1);
+    if (escape.back() == 'u') {
+        take(4);
+        // A high surrogate is followed by the escaped low one
+        if (escape.size() == 6 && (escape[2] == 'd' || escape[2] == 'D') &&
+            std::string_view("89abAB").find(escape[3]) != std::string_view::npos && peek() == '\\') {
+            take(2);
+            if (escape.back() == 'u') {
+                take(4);
+            }
+        }
+    }
+    unescapeJSON(escape, 1, &token);
+}
+
+void JSONStreamReader::readAtom() {
+    token.clear();
+    while (true) {
+        size_t atomEnd = begin;
+        while (atomEnd < end && !isDelimiter(buffer[atomEnd])) {
+            ++atomEnd;
+        }
+        token.append(buffer.data() + begin, atomEnd - begin);
+        begin = atomEnd;
+        if (begin < end || !refill()) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include "byte_source.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// What the reader should do after an event
+enum class HandlerAction {
+    Continue,
+    // Only meaningful from startObject/startArray: skip the container without reporting its contents
+    Skip,
+    // Stop reading; the rest of the input is neither read nor validated
+    Stop
+};
+
+// Receives the events of a streamed document in order. Keys and strings are only valid during the call
+class JSONHandler {
+public:
+    virtual ~JSONHandler() = default;
+
+    virtual HandlerAction startObject() = 0;
+
+    virtual HandlerAction key(std::string_view key) = 0;
+
+    virtual HandlerAction endObject() = 0;
+
+    virtual HandlerAction startArray() = 0;
+
+    virtual HandlerAction endArray() = 0;
+
+    virtual HandlerAction null() = 0;
+
+    virtual HandlerAction boolean(bool value) = 0;
+
+    // Integral numbers that fit into int64_t
+    virtual HandlerAction integer(int64_t value) = 0;
+
+    virtual HandlerAction number(double value) = 0;
+
+    virtual HandlerAction string(std::string_view value) = 0;
+};
+
+// Event-driven parser over a ByteSource. Input is pulled through one fixed-size buffer, so memory use does
+// not depend on the document size (only a single string or number is ever accumulated on its own)
+class JSONStreamReader {
+public:
+    static constexpr size_t defaultBufferSize = 1 << 16;
+
+    explicit JSONStreamReader(ByteSource &source, size_t bufferSize = defaultBufferSize);
+
+    // Returns false when the handler stopped the parse early
+    bool parse(JSONHandler &handler);
+
+    [[nodiscard]] uint64_t bytesRead() const { return totalRead; }
+
+private:
+    ByteSource &source;
+    std::vector<char> buffer;
+    size_t begin = 0;
+    size_t end = 0;
+    uint64_t totalRead = 0;
+    std::string token;
+
+    bool refill();
+
+    // Next byte without consuming it, -1 at the end of the input
+    int peek() {
+        if (begin == end && !refill()) {
+            return -1;
+        }
+        return static_cast<unsigned char>(buffer[begin]);
+    }
+
+    void skipWhitespace();
+
+    bool match(char expected);
+
+    bool parseValue(JSONHandler &handler);
+
+    bool parseObject(JSONHandler &handler);
+
+    bool parseArray(JSONHandler &handler);
+
+    // Skips a container whose opening bracket has been consumed, tracking strings and escapes
+    void skipContainer();
+
+    void readString();
+
+    // Decodes the escape after a backslash into token
+    void readEscape();
+
+    // Reads a number or literal up to the next delimiter into token
+    void readAtom();
+};
+
+#endif // JSON_STREAM_H
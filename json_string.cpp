@@ -0,0 +1,29 @@
+#include "json_string.h"
+#include "json_scalar.h"
+
+std::string JSONString::str() const {
+    if (!escaped) {
+        return std::string(plain());
+    }
+    std::string decoded;
+    decoded.reserve(borrowed.size());
+    parseJSONString(borrowed, 0, decoded);
+    return decoded;
+}
+
+size_t JSONString::size() const {
+    return escaped ? str().size() : plain().size();
+}
+
+bool operator==(const JSONString &left, const JSONString &right) {
+    if (!left.escaped && !right.escaped) {
+        return left.plain() == right.plain();
+    }
+    return left.withText([&right](std::string_view leftText) {
+        return right.withText([leftText](std::string_view rightText) { return leftText == rightText; });
+    });
+}
+
+std::ostream &operator<<(std::ostream &out, const JSONString &string) {
+    return string.withText([&out](std::string_view text) -> std::ostream & { return out << text; });
+}
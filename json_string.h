@@ -0,0 +1,98 @@
+#ifndef JSON_STRING_H
+#define JSON_STRING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// String value (and object key) of a JSONValue. Either owns its text or borrows it from the parsed input,
+// which then has to outlive it (see StringStorage::Borrow). A borrowed string that contains escapes is
+// kept as the raw literal, quotes included, and only unescaped when its text is needed: when it is
+// printed, compared, hashed or measured. Borrowed strings are never modified, so concurrent readers are safe
+class JSONString {
+public:
+    JSONString() = default;
+
+    JSONString(std::string text) : owned(std::move(text)) {} // NOLINT(google-explicit-constructor)
+
+    JSONString(const char *text) : owned(text) {} // NOLINT(google-explicit-constructor)
+
+    // Borrows text that needs no unescaping. Also handy for lookups, which then do not allocate
+    static JSONString borrow(std::string_view text) {
+        JSONString string;
+        string.borrowed = text;
+        string.isBorrowed = true;
+        return string;
+    }
+
+    // Borrows a string literal (quotes included) whose escapes are still to be decoded
+    static JSONString borrowEscaped(std::string_view literal) {
+        JSONString string = borrow(literal);
+        string.escaped = true;
+        return string;
+    }
+
+    // Owns text and hashes it once up front, for keys that are looked up many times
+    static JSONString prehashed(std::string text) {
+        JSONString string(std::move(text));
+        string.cachedHash = hashText(string.owned);
+        string.hashed = true;
+        return string;
+    }
+
+    [[nodiscard]] bool hasEscapes() const { return escaped; }
+
+    // Unescaped text. Copies, so prefer withText when the text is only read
+    [[nodiscard]] std::string str() const;
+
+    // Calls fn(std::string_view) with the unescaped text. Only escaped strings are decoded, into a temporary
+    template<typename Fn>
+    decltype(auto) withText(Fn &&fn) const {
+        if (escaped) {
+            std::string decoded = str();
+            return fn(std::string_view(decoded));
+        }
+        return fn(plain());
+    }
+
+    // Length of the unescaped text
+    [[nodiscard]] size_t size() const;
+
+    [[nodiscard]] size_t hash() const { return hashed ? cachedHash : withText(hashText); }
+
+    friend bool operator==(const JSONString &left, const JSONString &right);
+
+    friend bool operator!=(const JSONString &left, const JSONString &right) { return !(left == right); }
+
+    friend std::ostream &operator<<(std::ostream &out, const JSONString &string);
+
+private:
+    std::string owned;
+    std::string_view borrowed;
+    bool isBorrowed = false;
+    bool escaped = false;
+    bool hashed = false;
+    // 32 bits, so the hash fits next to the flags without growing every string
+    uint32_t cachedHash = 0;
+
+    static uint32_t hashText(std::string_view text) {
+        size_t hash = std::hash<std::string_view>()(text);
+        return static_cast<uint32_t>(hash ^ (hash >> 32));
+    }
+
+    // Text of a string without escapes
+    [[nodiscard]] std::string_view plain() const { return isBorrowed ? borrowed : std::string_view(owned); }
+};
+
+namespace std {
+template<>
+struct hash<JSONString> {
+    size_t operator()(const JSONString &string) const { return string.hash(); }
+};
+}
+
+#endif // JSON_STRING_H
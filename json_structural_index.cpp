@@ -0,0 +1,254 @@
+#include "json_structural_index.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define JSON_EVAL_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+constexpr uint64_t evenBits = 0x5555555555555555ULL;
+constexpr size_t windowBlocks = 256;
+
+enum CharClass : uint8_t {
+    QuoteClass = 1, BackslashClass = 2, OpClass = 4, WhitespaceClass = 8
+};
+
+constexpr std::array<uint8_t, 256> makeCharClasses() {
+    std::array<uint8_t, 256> classes{};
+    classes['"'] = QuoteClass;
+    classes['\\'] = BackslashClass;
+    for (unsigned char chr: {'{', '}', '[', ']', ':', ','}) {
+        classes[chr] = OpClass;
+    }
+    // Same set as std::isspace in the "C" locale, which is what the parser has always accepted
+    for (unsigned char chr: {' ', '\t', '\n', '\v', '\f', '\r'}) {
+        classes[chr] = WhitespaceClass;
+    }
+    return classes;
+}
+
+constexpr std::array<uint8_t, 256> charClasses = makeCharClasses();
+
+void classifyScalar(const char *data, StructuralMasks &masks) {
+    masks = {};
+    for (size_t i = 0; i < StructuralScanner::blockSize; ++i) {
+        uint8_t cls = charClasses[static_cast<unsigned char>(data[i])];
+        uint64_t bit = uint64_t{1} << i;
+        masks.quote |= (cls & QuoteClass) != 0 ? bit : 0;
+        masks.backslash |= (cls & BackslashClass) != 0 ? bit : 0;
+        masks.op |= (cls & OpClass) != 0 ? bit : 0;
+        masks.whitespace |= (cls & WhitespaceClass) != 0 ? bit : 0;
+    }
+}
+
+#ifdef JSON_EVAL_X86_KERNELS
+
+__attribute__((target("sse4.2")))
+inline uint64_t bitsSSE42(__m128i mask) {
+    return static_cast<uint16_t>(_mm_movemask_epi8(mask));
+}
+
+__attribute__((target("avx2")))
+inline uint64_t bitsAVX2(__m256i mask) {
+    return static_cast<uint32_t>(_mm256_movemask_epi8(mask));
+}
+
+// '[' | 0x20 == '{' and ']' | 0x20 == '}', so two compares on the lowered byte cover all four brackets.
+// Whitespace is ' ' or the 0x09-0x0D range, tested as an unsigned (chr - 9) <= 4
+__attribute__((target("sse4.2")))
+void classifySSE42(const char *data, StructuralMasks &masks) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i lowerBit = _mm_set1_epi8(0x20);
+    const __m128i openBrace = _mm_set1_epi8('{');
+    const __m128i closeBrace = _mm_set1_epi8('}');
+    const __m128i colon = _mm_set1_epi8(':');
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i controlSpan = _mm_set1_epi8('\r' - '\t');
+
+    masks = {};
+    for (size_t i = 0; i < StructuralScanner::blockSize / 16; ++i) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i * 16)); // NOLINT
+        __m128i lowered = _mm_or_si128(chunk, lowerBit);
+        __m128i op = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(lowered, openBrace), _mm_cmpeq_epi8(lowered, closeBrace)),
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, colon), _mm_cmpeq_epi8(chunk, comma)));
+        __m128i shifted = _mm_sub_epi8(chunk, tab);
+        __m128i whitespace = _mm_or_si128(
+                _mm_cmpeq_epi8(chunk, space),
+                _mm_cmpeq_epi8(_mm_min_epu8(shifted, controlSpan), shifted));
+
+        unsigned shift = i * 16;
+        masks.quote |= bitsSSE42(_mm_cmpeq_epi8(chunk, quote)) << shift;
+        masks.backslash |= bitsSSE42(_mm_cmpeq_epi8(chunk, backslash)) << shift;
+        masks.op |= bitsSSE42(op) << shift;
+        masks.whitespace |= bitsSSE42(whitespace) << shift;
+    }
+}
+
+__attribute__((target("avx2")))
+void classifyAVX2(const char *data, StructuralMasks &masks) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i lowerBit = _mm256_set1_epi8(0x20);
+    const __m256i openBrace = _mm256_set1_epi8('{');
+    const __m256i closeBrace = _mm256_set1_epi8('}');
+    const __m256i colon = _mm256_set1_epi8(':');
+    const __m256i comma = _mm256_set1_epi8(',');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i controlSpan = _mm256_set1_epi8('\r' - '\t');
+
+    masks = {};
+    for (size_t i = 0; i < StructuralScanner::blockSize / 32; ++i) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i * 32)); // NOLINT
+        __m256i lowered = _mm256_or_si256(chunk, lowerBit);
+        __m256i op = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(lowered, openBrace), _mm256_cmpeq_epi8(lowered, closeBrace)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, colon), _mm256_cmpeq_epi8(chunk, comma)));
+        __m256i shifted = _mm256_sub_epi8(chunk, tab);
+        __m256i whitespace = _mm256_or_si256(
+                _mm256_cmpeq_epi8(chunk, space),
+                _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, controlSpan), shifted));
+
+        unsigned shift = i * 32;
+        masks.quote |= bitsAVX2(_mm256_cmpeq_epi8(chunk, quote)) << shift;
+        masks.backslash |= bitsAVX2(_mm256_cmpeq_epi8(chunk, backslash)) << shift;
+        masks.op |= bitsAVX2(op) << shift;
+        masks.whitespace |= bitsAVX2(whitespace) << shift;
+    }
+}
+
+#endif // JSON_EVAL_X86_KERNELS
+
+// Turns every bit after an odd number of set bits on, i.e. marks the bytes between opening and closing quotes
+uint64_t prefixXor(uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+} // namespace
+
+bool isStructuralKernelSupported(StructuralKernel kernel) {
+    switch (kernel) {
+        case StructuralKernel::Scalar:
+            return true;
+#ifdef JSON_EVAL_X86_KERNELS
+        case StructuralKernel::SSE42:
+            return __builtin_cpu_supports("sse4.2") != 0;
+        case StructuralKernel::AVX2:
+            return __builtin_cpu_supports("avx2") != 0;
+#endif
+        default:
+            return false;
+    }
+}
+
+StructuralKernel bestStructuralKernel() {
+    static const StructuralKernel best = [] {
+        if (isStructuralKernelSupported(StructuralKernel::AVX2)) {
+            return StructuralKernel::AVX2;
+        }
+        if (isStructuralKernelSupported(StructuralKernel::SSE42)) {
+            return StructuralKernel::SSE42;
+        }
+        return StructuralKernel::Scalar;
+    }();
+    return best;
+}
+
+const char *structuralKernelName(StructuralKernel kernel) {
+    switch (kernel) {
+        case StructuralKernel::Scalar:
+            return "scalar";
+        case StructuralKernel::SSE42:
+            return "sse4.2";
+        case StructuralKernel::AVX2:
+            return "avx2";
+    }
+    return "unknown";
+}
+
+StructuralScanner::StructuralScanner(StructuralKernel kernel) : classify(classifyScalar) {
+#ifdef JSON_EVAL_X86_KERNELS
+    if (kernel == StructuralKernel::AVX2 && isStructuralKernelSupported(kernel)) {
+        classify = classifyAVX2;
+    } else if (kernel == StructuralKernel::SSE42 && isStructuralKernelSupported(kernel)) {
+        classify = classifySSE42;
+    }
+#else
+    (void) kernel;
+#endif
+}
+
+uint64_t StructuralScanner::scan(const char *data) {
+    StructuralMasks masks; // NOLINT
+    classify(data, masks);
+
+    // A byte is escaped when it follows an odd-length run of backslashes. Runs are told apart by
+    // whether they start on an even or an odd bit; adding the odd starts to the run carries through it
+    uint64_t backslash = masks.backslash & ~prevEscaped;
+    uint64_t followsEscape = (backslash << 1) | prevEscaped;
+    uint64_t oddSequenceStarts = backslash & ~evenBits & ~followsEscape;
+    uint64_t sequencesStartingOnEvenBits = 0;
+    prevEscaped = __builtin_add_overflow(oddSequenceStarts, backslash, &sequencesStartingOnEvenBits) ? 1 : 0;
+    uint64_t invertMask = sequencesStartingOnEvenBits << 1;
+    uint64_t escaped = (evenBits ^ invertMask) & followsEscape;
+
+    // Unescaped quotes toggle the in-string state. inString covers the opening quote up to, but not
+    // including, the closing one
+    uint64_t quote = masks.quote & ~escaped;
+    uint64_t inString = prefixXor(quote) ^ prevInString;
+    prevInString = static_cast<uint64_t>(static_cast<int64_t>(inString) >> 63);
+    lastStringMask = inString;
+
+    // Every run of non-whitespace, non-operator bytes is a scalar. Only its first byte is indexed
+    uint64_t scalar = ~(masks.op | masks.whitespace);
+    uint64_t nonQuoteScalar = scalar & ~quote;
+    uint64_t followsNonQuoteScalar = (nonQuoteScalar << 1) | prevScalar;
+    prevScalar = nonQuoteScalar >> 63;
+    uint64_t scalarStarts = scalar & ~followsNonQuoteScalar;
+
+    // Drop everything inside strings and the closing quotes; opening quotes stay as the string's position
+    uint64_t stringTail = inString ^ quote;
+    return (masks.op | scalarStarts) & ~stringTail;
+}
+
+StructuralIndex::StructuralIndex(std::string_view input, StructuralKernel kernel)
+        : input(input), scanner(kernel) {}
+
+void StructuralIndex::refill() {
+    positions.clear();
+    cursor = 0;
+    size_t blocks = 0;
+    while (scanned < input.size() && (blocks < windowBlocks || positions.empty())) {
+        size_t remaining = input.size() - scanned;
+        uint64_t bits = 0;
+        if (remaining >= StructuralScanner::blockSize) {
+            bits = scanner.scan(input.data() + scanned);
+        } else {
+            // Pad the tail with whitespace, which is never structural
+            std::array<char, StructuralScanner::blockSize> padded; // NOLINT
+            padded.fill(' ');
+            std::memcpy(padded.data(), input.data() + scanned, remaining);
+            bits = scanner.scan(padded.data());
+        }
+        while (bits != 0) {
+            positions.push_back(scanned + static_cast<size_t>(__builtin_ctzll(bits)));
+            bits &= bits - 1;
+        }
+        scanned += std::min(remaining, StructuralScanner::blockSize);
+        ++blocks;
+    }
+}
@@ -0,0 +1,91 @@
+#ifndef JSON_STRUCTURAL_INDEX_H
+#define JSON_STRUCTURAL_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Stage one of JSONParser. The input is classified 64 bytes at a time with SIMD compares, string
+// interiors are masked out with bit arithmetic, and what is left is an index of every position the
+// second stage has to look at: the structural characters {}[]:, outside strings, the opening quote of
+// every string, and the first byte of every other scalar (numbers, literals and garbage).
+// Whitespace never reaches stage two.
+
+// Per-block classification bitmasks. Bit i describes byte i of the 64 byte block
+struct StructuralMasks {
+    uint64_t quote;
+    uint64_t backslash;
+    uint64_t op;
+    uint64_t whitespace;
+};
+
+enum class StructuralKernel {
+    Scalar, SSE42, AVX2
+};
+
+// Best kernel the running CPU supports
+StructuralKernel bestStructuralKernel();
+
+bool isStructuralKernelSupported(StructuralKernel kernel);
+
+const char *structuralKernelName(StructuralKernel kernel);
+
+// Carries the string/escape/scalar state from one 64 byte block to the next
+class StructuralScanner {
+public:
+    static constexpr size_t blockSize = 64;
+
+    explicit StructuralScanner(StructuralKernel kernel = bestStructuralKernel());
+
+    // Classifies the block at data (exactly blockSize bytes) and returns the structural positions as bits
+    uint64_t scan(const char *data);
+
+    // Bits of the last scanned block that lie inside a string, including the opening quote
+    [[nodiscard]] uint64_t lastInString() const { return lastStringMask; }
+
+    [[nodiscard]] bool endsInsideString() const { return prevInString != 0; }
+
+private:
+    using ClassifyFunction = void (*)(const char *, StructuralMasks &);
+
+    ClassifyFunction classify;
+    uint64_t prevEscaped = 0;
+    uint64_t prevInString = 0;
+    uint64_t prevScalar = 0;
+    uint64_t lastStringMask = 0;
+};
+
+// Lazily filled index over a whole input. Positions are produced a window at a time, so memory stays
+// bounded no matter how large the document is
+class StructuralIndex {
+public:
+    explicit StructuralIndex(std::string_view input, StructuralKernel kernel = bestStructuralKernel());
+
+    // Position of the next structural without consuming it, input.size() once the input is exhausted
+    size_t peek() {
+        if (cursor == positions.size()) {
+            refill();
+        }
+        return cursor < positions.size() ? positions[cursor] : input.size();
+    }
+
+    size_t next() {
+        size_t position = peek();
+        if (cursor < positions.size()) {
+            ++cursor;
+        }
+        return position;
+    }
+
+private:
+    std::string_view input;
+    StructuralScanner scanner;
+    std::vector<size_t> positions;
+    size_t cursor = 0;
+    size_t scanned = 0;
+
+    void refill();
+};
+
+#endif // JSON_STRUCTURAL_INDEX_H
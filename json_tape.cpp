@@ -0,0 +1,295 @@
+#include "json_tape.h"
+#include "json_scalar.h"
+#include <cctype>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+JSONTapeView JSONTape::root() const {
+    if (wordCount() == 0) {
+        throw std::runtime_error("Empty tape");
+    }
+    return {this, 0};
+}
+
+std::string_view JSONTape::stringAt(uint64_t offset) const {
+    const char *data = arenaBytes().data();
+    uint32_t length = 0;
+    std::memcpy(&length, data + offset, sizeof(length));
+    return {data + offset + sizeof(length), length};
+}
+
+size_t JSONTape::skip(size_t index) const {
+    switch (tag(index)) {
+        case TapeTag::Double:
+        case TapeTag::Integer:
+            return index + 2;
+        case TapeTag::ArrayStart:
+        case TapeTag::ObjectStart:
+            return payload(index) + 1;
+        default:
+            return index + 1;
+    }
+}
+
+size_t JSONTape::memoryUsage() const {
+    // A mapped tape is backed by the page cache
+    return mapping ? 0 : words.capacity() * sizeof(uint64_t) + arena.capacity();
+}
+
+bool JSONTapeView::asBool() const {
+    if (!isBool()) {
+        throw std::runtime_error("Tape value is not a boolean");
+    }
+    return tag() == TapeTag::True;
+}
+
+double JSONTapeView::asNumber() const {
+    if (!isNumber()) {
+        throw std::runtime_error("Tape value is not a number");
+    }
+    if (isInteger()) {
+        return static_cast<double>(asInteger());
+    }
+    uint64_t bits = tape->word(index + 1);
+    double number = 0;
+    std::memcpy(&number, &bits, sizeof(number));
+    return number;
+}
+
+int64_t JSONTapeView::asInteger() const {
+    if (!isInteger()) {
+        throw std::runtime_error("Tape value is not an integer");
+    }
+    return static_cast<int64_t>(tape->word(index + 1));
+}
+
+void JSONTapeView::summarizeNumbers(NumericSummary &summary) const {
+    const uint64_t *words = tape->wordData();
+    size_t end = tape->payload(index);
+    size_t first = index + 1;
+    // Elements take two words each when all of them are numbers (and rarely otherwise). The chunks are then
+    // cut at even offsets, and each one has to turn out to be a single run of numbers
+    if (end - first >= 2 * parallelSummaryThreshold && end - first == 2 * size()) {
+        auto chunked = summarizeChunks(end - first, 2, [words, first](size_t begin, size_t last,
+                                                                     NumericSummary &partial) {
+            return summarizeNumberRun(words + first + begin, last - begin, partial) == last - begin;
+        });
+        if (chunked) {
+            summary.merge(*chunked);
+            return;
+        }
+    }
+    for (size_t i = index + 1; i < end;) {
+        i += summarizeNumberRun(words + i, end - i, summary);
+        if (i < end) {
+            i = tape->skip(i);
+        }
+    }
+}
+
+std::string_view JSONTapeView::asString() const {
+    if (!isString()) {
+        throw std::runtime_error("Tape value is not a string");
+    }
+    return tape->stringAt(tape->payload(index));
+}
+
+size_t JSONTapeView::size() const {
+    if (!isArray() && !isObject()) {
+        throw std::runtime_error("Tape value is not a container");
+    }
+    return tape->payload(tape->payload(index));
+}
+
+JSONTapeView JSONTapeView::at(size_t position) const {
+    if (!isArray()) {
+        throw std::runtime_error("Attempted to index non-array");
+    }
+    size_t end = tape->payload(index);
+    size_t i = index + 1;
+    for (; i < end && position > 0; --position) {
+        i = tape->skip(i);
+    }
+    if (i >= end) {
+        throw std::runtime_error("Array index out of bounds");
+    }
+    return {tape, i};
+}
+
+std::optional<JSONTapeView> JSONTapeView::find(std::string_view key) const {
+    if (!isObject()) {
+        throw std::runtime_error("Attempted to access member of non-object");
+    }
+    std::optional<JSONTapeView> found;
+    forEachMember([&](std::string_view name, JSONTapeView value) {
+        if (name == key) {
+            found = value;
+        }
+    });
+    return found;
+}
+
+JSONValue JSONTapeView::toJSONValue() const {
+    switch (tag()) {
+        case TapeTag::Null:
+            return nullptr;
+        case TapeTag::True:
+            return true;
+        case TapeTag::False:
+            return false;
+        case TapeTag::Double:
+            return asNumber();
+        case TapeTag::Integer:
+            return asInteger();
+        case TapeTag::String:
+            return std::string(asString());
+        case TapeTag::ArrayStart: {
+            JSONArray arr;
+            arr.reserve(size());
+            forEachElement([&arr](JSONTapeView element) {
+                arr.push_back(element.toJSONValue());
+            });
+            return arr;
+        }
+        case TapeTag::ObjectStart: {
+            JSONObject obj;
+            forEachMember([&obj](std::string_view key, JSONTapeView value) {
+                obj.insert_or_assign(std::string(key), value.toJSONValue());
+            });
+            return obj;
+        }
+        default:
+            throw std::runtime_error("Corrupt tape");
+    }
+}
+
+JSONTapeParser::JSONTapeParser(std::string_view input) : input(input), index(input) {}
+
+char JSONTapeParser::peek() {
+    size_t next = index.peek();
+    return next < input.size() ? input[next] : '\0';
+}
+
+bool JSONTapeParser::match(char expected) {
+    if (peek() == expected) {
+        index.next();
+        return true;
+    }
+    return false;
+}
+
+void JSONTapeParser::append(TapeTag tag, uint64_t payload) {
+    tape.words.push_back((static_cast<uint64_t>(tag) << JSONTape::tagShift) | payload);
+}
+
+JSONTape JSONTapeParser::parse() {
+    // Dense documents need roughly one word per eight bytes; start there rather than at zero
+    tape.words.reserve(input.size() / 8);
+    parseValue();
+    if (index.peek() != input.size()) {
+        throw std::runtime_error("Extra characters after parsing JSON value");
+    }
+    return std::move(tape);
+}
+
+void JSONTapeParser::parseValue() {
+    char chr = peek();
+    if (chr == '"') {
+        parseString();
+    } else if (chr == '{') {
+        parseObject();
+    } else if (chr == '[') {
+        parseArray();
+    } else if (chr == 't') {
+        parseJSONLiteral(input, index.next(), "true");
+        append(TapeTag::True, 0);
+    } else if (chr == 'f') {
+        parseJSONLiteral(input, index.next(), "false");
+        append(TapeTag::False, 0);
+    } else if (chr == 'n') {
+        parseJSONLiteral(input, index.next(), "null");
+        append(TapeTag::Null, 0);
+    } else if (chr == '-' || std::isdigit(static_cast<unsigned char>(chr)) != 0) {
+        parseNumber();
+    } else {
+        throw std::runtime_error(std::string("Unexpected character: ") + chr);
+    }
+}
+
+void JSONTapeParser::parseObject() {
+    size_t start = tape.words.size();
+    append(TapeTag::ObjectStart, 0);
+    uint64_t count = 0;
+    match('{');
+    if (!match('}')) {
+        while (true) {
+            if (peek() != '"') {
+                throw std::runtime_error("Expected string key in object");
+            }
+            parseString();
+            if (!match(':')) {
+                throw std::runtime_error("Expected ':' after key in object");
+            }
+            parseValue();
+            ++count;
+            if (match('}')) {
+                break;
+            }
+            if (!match(',')) {
+                throw std::runtime_error("Expected ',' or '}' in object");
+            }
+        }
+    }
+    tape.words[start] |= tape.words.size();
+    append(TapeTag::ObjectEnd, count);
+}
+
+void JSONTapeParser::parseArray() {
+    size_t start = tape.words.size();
+    append(TapeTag::ArrayStart, 0);
+    uint64_t count = 0;
+    match('[');
+    if (!match(']')) {
+        while (true) {
+            parseValue();
+            ++count;
+            if (match(']')) {
+                break;
+            }
+            if (!match(',')) {
+                throw std::runtime_error("Expected ',' or ']' in array");
+            }
+        }
+    }
+    tape.words[start] |= tape.words.size();
+    append(TapeTag::ArrayEnd, count);
+}
+
+void JSONTapeParser::parseString() {
+    // Unescape straight into the arena behind a length placeholder, then patch the length in
+    size_t offset = tape.arena.size();
+    append(TapeTag::String, offset);
+    tape.arena.append(sizeof(uint32_t), '\0');
+    parseJSONString(input, index.next(), tape.arena);
+    size_t length = tape.arena.size() - offset - sizeof(uint32_t);
+    if (length > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("String too long for tape");
+    }
+    auto storedLength = static_cast<uint32_t>(length);
+    std::memcpy(&tape.arena[offset], &storedLength, sizeof(storedLength));
+}
+
+void JSONTapeParser::parseNumber() {
+    JSONNumber number;
+    parseJSONNumber(input, index.next(), number);
+    uint64_t bits = 0;
+    if (number.isInteger) {
+        bits = static_cast<uint64_t>(number.integer);
+        append(TapeTag::Integer, 0);
+    } else {
+        std::memcpy(&bits, &number.real, sizeof(bits));
+        append(TapeTag::Double, 0);
+    }
+    tape.words.push_back(bits);
+}
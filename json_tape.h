@@ -0,0 +1,194 @@
+#ifndef JSON_TAPE_H
+#define JSON_TAPE_H
+
+#include "json_numeric.h"
+#include "json_parser.h"
+#include "json_structural_index.h"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Read-only document stored as one contiguous tape of tagged 64-bit words plus a string arena. The top
+// byte of a word is its tag, the low 56 bits its payload:
+//   'n', 't', 'f'   null, true, false
+//   'd'             double; the next word holds the raw IEEE bits
+//   'i'             int64; the next word holds the two's complement bits
+//   's'             string; payload is the offset of a uint32 length followed by the bytes in the arena
+//   '[' / '{'       container start; payload is the index of the matching end word
+//   ']' / '}'       container end; payload is the number of elements (members for objects)
+// Object members are a key string followed by the value. Skipping any value is O(1), and a document
+// needs a handful of allocations instead of one per node.
+enum class TapeTag : uint8_t {
+    Null = 'n',
+    True = 't',
+    False = 'f',
+    Double = 'd',
+    Integer = 'i',
+    String = 's',
+    ArrayStart = '[',
+    ArrayEnd = ']',
+    ObjectStart = '{',
+    ObjectEnd = '}'
+};
+
+class JSONTapeView;
+
+class JSONTape {
+public:
+    static constexpr unsigned tagShift = 56;
+    static constexpr uint64_t payloadMask = (uint64_t{1} << tagShift) - 1;
+
+    [[nodiscard]] JSONTapeView root() const;
+
+    [[nodiscard]] TapeTag tag(size_t index) const { return static_cast<TapeTag>(word(index) >> tagShift); }
+
+    [[nodiscard]] uint64_t payload(size_t index) const { return word(index) & payloadMask; }
+
+    [[nodiscard]] uint64_t word(size_t index) const { return mapping ? mappedWords[index] : words[index]; }
+
+    [[nodiscard]] size_t wordCount() const { return mapping ? mappedWordCount : words.size(); }
+
+    [[nodiscard]] const uint64_t *wordData() const { return mapping ? mappedWords : words.data(); }
+
+    [[nodiscard]] std::string_view arenaBytes() const { return mapping ? mappedArena : std::string_view(arena); }
+
+    [[nodiscard]] std::string_view stringAt(uint64_t offset) const;
+
+    // Index of the word after the value starting at index
+    [[nodiscard]] size_t skip(size_t index) const;
+
+    [[nodiscard]] size_t memoryUsage() const;
+
+private:
+    friend class JSONTapeParser;
+
+    friend class JSONSnapshot;
+
+    std::vector<uint64_t> words;
+    std::string arena;
+
+    // Set when the tape was loaded from a snapshot: words and arena then live in the mapped file instead
+    std::shared_ptr<const void> mapping;
+    const uint64_t *mappedWords = nullptr;
+    size_t mappedWordCount = 0;
+    std::string_view mappedArena;
+};
+
+// Position of one value on a tape. Cheap to copy; valid as long as the tape is
+class JSONTapeView {
+public:
+    JSONTapeView(const JSONTape *tape, size_t index) : tape(tape), index(index) {}
+
+    [[nodiscard]] bool isNull() const { return tag() == TapeTag::Null; }
+
+    [[nodiscard]] bool isBool() const { return tag() == TapeTag::True || tag() == TapeTag::False; }
+
+    [[nodiscard]] bool isNumber() const { return tag() == TapeTag::Double || isInteger(); }
+
+    [[nodiscard]] bool isInteger() const { return tag() == TapeTag::Integer; }
+
+    [[nodiscard]] bool isString() const { return tag() == TapeTag::String; }
+
+    [[nodiscard]] bool isArray() const { return tag() == TapeTag::ArrayStart; }
+
+    [[nodiscard]] bool isObject() const { return tag() == TapeTag::ObjectStart; }
+
+    [[nodiscard]] bool asBool() const;
+
+    // Converts integers
+    [[nodiscard]] double asNumber() const;
+
+    [[nodiscard]] int64_t asInteger() const;
+
+    [[nodiscard]] std::string_view asString() const;
+
+    // Number of array elements or object members
+    [[nodiscard]] size_t size() const;
+
+    // Array element. Elements have different widths on the tape, so this walks from the first one
+    [[nodiscard]] JSONTapeView at(size_t position) const;
+
+    // Object member. Like JSONParser, the last one wins when a key is repeated
+    [[nodiscard]] std::optional<JSONTapeView> find(std::string_view key) const;
+
+    // Calls fn(view) for each array element
+    template<typename Fn>
+    void forEachElement(Fn &&fn) const {
+        size_t end = tape->payload(index);
+        for (size_t i = index + 1; i < end; i = tape->skip(i)) {
+            fn(JSONTapeView(tape, i));
+        }
+    }
+
+    // Same for the elements [begin, end). The elements before begin are stepped over, not read
+    template<typename Fn>
+    void forEachElementIn(size_t begin, size_t end, Fn &&fn) const {
+        size_t last = tape->payload(index);
+        size_t position = 0;
+        for (size_t i = index + 1; i < last && position < end; i = tape->skip(i), ++position) {
+            if (position >= begin) {
+                fn(JSONTapeView(tape, i));
+            }
+        }
+    }
+
+    // Calls fn(key, view) for each object member
+    template<typename Fn>
+    void forEachMember(Fn &&fn) const {
+        size_t end = tape->payload(index);
+        for (size_t i = index + 1; i < end; i = tape->skip(i + 1)) {
+            fn(tape->stringAt(tape->payload(i)), JSONTapeView(tape, i + 1));
+        }
+    }
+
+    // Adds the numbers among the array elements to summary; other elements are skipped. Runs of numbers
+    // are reduced by the vector kernels of summarizeNumberRun, large arrays of numbers in parallel chunks
+    void summarizeNumbers(NumericSummary &summary) const;
+
+    // Copies the value (and everything below it) into a JSONValue tree
+    [[nodiscard]] JSONValue toJSONValue() const;
+
+    [[nodiscard]] size_t tapeIndex() const { return index; }
+
+    [[nodiscard]] const JSONTape *owner() const { return tape; }
+
+private:
+    const JSONTape *tape;
+    size_t index;
+
+    [[nodiscard]] TapeTag tag() const { return tape->tag(index); }
+};
+
+// Stage two that writes a JSONTape instead of a JSONValue tree. Accepts exactly what JSONParser accepts
+class JSONTapeParser {
+public:
+    explicit JSONTapeParser(std::string_view input);
+
+    JSONTape parse();
+
+private:
+    std::string_view input;
+    StructuralIndex index;
+    JSONTape tape;
+
+    char peek();
+
+    bool match(char expected);
+
+    void append(TapeTag tag, uint64_t payload);
+
+    void parseValue();
+
+    void parseObject();
+
+    void parseArray();
+
+    void parseString();
+
+    void parseNumber();
+};
+
+#endif // JSON_TAPE_H
@@ -0,0 +1,275 @@
+#include "json_utf8.h"
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define JSON_EVAL_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+bool isValidUTF8Scalar(const unsigned char *data, size_t size) {
+    size_t i = 0;
+    while (i < size) {
+        // Skip ASCII eight bytes at a time
+        if (i + 8 <= size) {
+            uint64_t word;
+            std::memcpy(&word, data + i, sizeof(word));
+            if ((word & 0x8080808080808080ULL) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+        unsigned char lead = data[i];
+        if (lead < 0x80) {
+            ++i;
+            continue;
+        }
+        // Length of the sequence and the allowed range of its second byte
+        size_t length;
+        unsigned char low = 0x80;
+        unsigned char high = 0xBF;
+        if (lead >= 0xC2 && lead <= 0xDF) {
+            length = 2;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+            length = 3;
+            low = lead == 0xE0 ? 0xA0 : 0x80;  // Overlong
+            high = lead == 0xED ? 0x9F : 0xBF; // Surrogates
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+            length = 4;
+            low = lead == 0xF0 ? 0x90 : 0x80;  // Overlong
+            high = lead == 0xF4 ? 0x8F : 0xBF; // Above U+10FFFF
+        } else {
+            return false;
+        }
+        if (i + length > size || data[i + 1] < low || data[i + 1] > high) {
+            return false;
+        }
+        for (size_t k = 2; k < length; ++k) {
+            if ((data[i + k] & 0xC0) != 0x80) {
+                return false;
+            }
+        }
+        i += length;
+    }
+    return true;
+}
+
+#ifdef JSON_EVAL_X86_KERNELS
+
+// Error bits of the lookup tables. Each names a way a pair of adjacent bytes can be malformed
+constexpr uint8_t tooShort = 1 << 0;     // Lead byte not followed by a continuation
+constexpr uint8_t tooLong = 1 << 1;      // Continuation after ASCII
+constexpr uint8_t overlong3 = 1 << 2;    // E0 80..9F
+constexpr uint8_t tooLarge = 1 << 3;     // F4 90..BF, F5..FF
+constexpr uint8_t surrogate = 1 << 4;    // ED A0..BF
+constexpr uint8_t overlong2 = 1 << 5;    // C0, C1
+constexpr uint8_t tooLarge1000 = 1 << 6; // F5..FF 80..8F
+constexpr uint8_t overlong4 = 1 << 6;    // F0 80..8F
+constexpr uint8_t twoConts = 1 << 7;     // Continuation after continuation (checked against the lengths)
+constexpr uint8_t carry = tooShort | tooLong | twoConts;
+
+// Indexed by the high nibble of the first byte of a pair
+alignas(16) constexpr uint8_t byte1High[16] = {
+        tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, tooLong, tooLong,
+        twoConts, twoConts, twoConts, twoConts,
+        tooShort | overlong2,
+        tooShort,
+        tooShort | overlong3 | surrogate,
+        tooShort | tooLarge | tooLarge1000 | overlong4};
+
+// Indexed by the low nibble of the first byte of a pair
+alignas(16) constexpr uint8_t byte1Low[16] = {
+        carry | overlong3 | overlong2 | overlong4,
+        carry | overlong2,
+        carry,
+        carry,
+        carry | tooLarge,
+        carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000,
+        carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000,
+        carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000,
+        carry | tooLarge | tooLarge1000 | surrogate,
+        carry | tooLarge | tooLarge1000, carry | tooLarge | tooLarge1000};
+
+// Indexed by the high nibble of the second byte of a pair
+alignas(16) constexpr uint8_t byte2High[16] = {
+        tooShort, tooShort, tooShort, tooShort, tooShort, tooShort, tooShort, tooShort,
+        tooLong | overlong2 | twoConts | overlong3 | tooLarge1000 | overlong4,
+        tooLong | overlong2 | twoConts | overlong3 | tooLarge,
+        tooLong | overlong2 | twoConts | surrogate | tooLarge,
+        tooLong | overlong2 | twoConts | surrogate | tooLarge,
+        tooShort, tooShort, tooShort, tooShort};
+
+// Subtracted from the last bytes of a chunk: a result above zero is a lead byte whose sequence runs on
+// into the next chunk
+alignas(32) constexpr uint8_t incompleteLimits[32] = {
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 0xF0 - 1, 0xE0 - 1, 0xC0 - 1};
+
+// Validation state carried from one chunk to the next
+struct UTF8StateSSE42 {
+    __m128i error;
+    __m128i previous;
+    __m128i previousIncomplete;
+};
+
+struct UTF8StateAVX2 {
+    __m256i error;
+    __m256i previous;
+    __m256i previousIncomplete;
+};
+
+__attribute__((target("sse4.2")))
+inline __m128i lookupSSE42(const uint8_t *table, __m128i nibbles) {
+    return _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i *>(table)), nibbles); // NOLINT
+}
+
+__attribute__((target("sse4.2")))
+inline void checkUTF8SSE42(__m128i input, UTF8StateSSE42 &state) {
+    if (_mm_movemask_epi8(input) == 0) {
+        state.error = _mm_or_si128(state.error, state.previousIncomplete);
+        state.previousIncomplete = _mm_setzero_si128();
+        state.previous = input;
+        return;
+    }
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    __m128i prev1 = _mm_alignr_epi8(input, state.previous, 15);
+    __m128i special = _mm_and_si128(
+            _mm_and_si128(lookupSSE42(byte1High, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                          lookupSSE42(byte1Low, _mm_and_si128(prev1, nibble))),
+            lookupSSE42(byte2High, _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+    __m128i prev2 = _mm_alignr_epi8(input, state.previous, 14);
+    __m128i prev3 = _mm_alignr_epi8(input, state.previous, 13);
+    __m128i mustContinue = _mm_and_si128(
+            _mm_or_si128(_mm_subs_epu8(prev2, _mm_set1_epi8(static_cast<char>(0xE0 - 0x80))),
+                         _mm_subs_epu8(prev3, _mm_set1_epi8(static_cast<char>(0xF0 - 0x80)))),
+            _mm_set1_epi8(static_cast<char>(0x80)));
+    state.error = _mm_or_si128(state.error, _mm_xor_si128(mustContinue, special));
+    state.previousIncomplete = _mm_subs_epu8(
+            input, _mm_loadu_si128(reinterpret_cast<const __m128i *>(incompleteLimits + 16))); // NOLINT
+    state.previous = input;
+}
+
+__attribute__((target("sse4.2")))
+bool isValidUTF8SSE42(const char *data, size_t size) {
+    UTF8StateSSE42 state{_mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128()};
+    size_t i = 0;
+    for (; i + 16 <= size; i += 16) {
+        checkUTF8SSE42(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)), state); // NOLINT
+    }
+    if (i < size) {
+        // Zero padding is ASCII, so it completes nothing and breaks nothing
+        alignas(16) char tail[16] = {};
+        std::memcpy(tail, data + i, size - i);
+        checkUTF8SSE42(_mm_load_si128(reinterpret_cast<const __m128i *>(tail)), state); // NOLINT
+    }
+    __m128i error = _mm_or_si128(state.error, state.previousIncomplete);
+    return _mm_testz_si128(error, error) != 0;
+}
+
+__attribute__((target("avx2")))
+inline __m256i lookupAVX2(const uint8_t *table, __m256i nibbles) {
+    __m256i broadcast = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(table))); // NOLINT
+    return _mm256_shuffle_epi8(broadcast, nibbles);
+}
+
+__attribute__((target("avx2")))
+inline void checkUTF8AVX2(__m256i input, UTF8StateAVX2 &state) {
+    if (_mm256_movemask_epi8(input) == 0) {
+        state.error = _mm256_or_si256(state.error, state.previousIncomplete);
+        state.previousIncomplete = _mm256_setzero_si256();
+        state.previous = input;
+        return;
+    }
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    // Lanes are 16 bytes wide, so the bytes shifted in from the left come from the other lane or chunk
+    __m256i straddle = _mm256_permute2x128_si256(state.previous, input, 0x21);
+    __m256i prev1 = _mm256_alignr_epi8(input, straddle, 15);
+    __m256i special = _mm256_and_si256(
+            _mm256_and_si256(lookupAVX2(byte1High, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                             lookupAVX2(byte1Low, _mm256_and_si256(prev1, nibble))),
+            lookupAVX2(byte2High, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+    __m256i prev2 = _mm256_alignr_epi8(input, straddle, 14);
+    __m256i prev3 = _mm256_alignr_epi8(input, straddle, 13);
+    __m256i mustContinue = _mm256_and_si256(
+            _mm256_or_si256(_mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xE0 - 0x80))),
+                            _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xF0 - 0x80)))),
+            _mm256_set1_epi8(static_cast<char>(0x80)));
+    state.error = _mm256_or_si256(state.error, _mm256_xor_si256(mustContinue, special));
+    state.previousIncomplete = _mm256_subs_epu8(
+            input, _mm256_load_si256(reinterpret_cast<const __m256i *>(incompleteLimits))); // NOLINT
+    state.previous = input;
+}
+
+__attribute__((target("avx2")))
+bool isValidUTF8AVX2(const char *data, size_t size) {
+    UTF8StateAVX2 state{_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        checkUTF8AVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i)), state); // NOLINT
+    }
+    if (i < size) {
+        alignas(32) char tail[32] = {};
+        std::memcpy(tail, data + i, size - i);
+        checkUTF8AVX2(_mm256_load_si256(reinterpret_cast<const __m256i *>(tail)), state); // NOLINT
+    }
+    __m256i error = _mm256_or_si256(state.error, state.previousIncomplete);
+    return _mm256_testz_si256(error, error) != 0;
+}
+
+#endif // JSON_EVAL_X86_KERNELS
+
+} // namespace
+
+bool isValidUTF8(std::string_view text, StructuralKernel kernel) {
+#ifdef JSON_EVAL_X86_KERNELS
+    // Short runs (most keys and values) are not worth the tail copy
+    if (text.size() >= 16) {
+        if (kernel == StructuralKernel::AVX2 && isStructuralKernelSupported(kernel)) {
+            return isValidUTF8AVX2(text.data(), text.size());
+        }
+        if (kernel == StructuralKernel::SSE42 && isStructuralKernelSupported(kernel)) {
+            return isValidUTF8SSE42(text.data(), text.size());
+        }
+    }
+#else
+    (void) kernel;
+#endif
+    return isValidUTF8Scalar(reinterpret_cast<const unsigned char *>(text.data()), text.size()); // NOLINT
+}
+
+size_t findQuoteOrBackslash(std::string_view input, size_t pos, bool &nonASCII) {
+    const char *data = input.data();
+    size_t size = input.size();
+#if defined(JSON_EVAL_X86_KERNELS) && defined(__SSE2__)
+    // SSE2 is part of x86-64, so no dispatch is needed. Only whole 16 byte chunks are loaded, never
+    // past the end of the input (which may be the last page of a mapping)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    __m128i highBits = _mm_setzero_si128();
+    for (; pos + 16 <= size; pos += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos)); // NOLINT
+        auto special = static_cast<unsigned>(_mm_movemask_epi8(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash))));
+        if (special != 0) {
+            unsigned offset = __builtin_ctz(special);
+            // Only the bytes before the quote or backslash belong to the run
+            unsigned before = (1u << offset) - 1;
+            nonASCII = nonASCII || _mm_movemask_epi8(highBits) != 0 ||
+                       (static_cast<unsigned>(_mm_movemask_epi8(chunk)) & before) != 0;
+            return pos + offset;
+        }
+        highBits = _mm_or_si128(highBits, chunk);
+    }
+    nonASCII = nonASCII || _mm_movemask_epi8(highBits) != 0;
+#endif
+    for (; pos < size; ++pos) {
+        char chr = data[pos];
+        if (chr == '"' || chr == '\\') {
+            break;
+        }
+        nonASCII = nonASCII || static_cast<unsigned char>(chr) >= 0x80;
+    }
+    return pos;
+}
@@ -0,0 +1,21 @@
+#ifndef JSON_UTF8_H
+#define JSON_UTF8_H
+
+#include "json_structural_index.h"
+#include <cstddef>
+#include <string_view>
+
+// Kernels behind the string scanners in json_scalar. UTF-8 is validated with the lookup-table algorithm
+// of Keiser and Lemire ("Validating UTF-8 In Less Than One Instruction Per Byte"): three nibble lookups
+// classify every pair of adjacent bytes, and a saturating subtraction checks that continuation bytes
+// appear exactly where the lead bytes before them require. All-ASCII chunks skip the lookups
+
+// True when text is well-formed UTF-8: no overlong encodings, surrogates, code points above U+10FFFF or
+// truncated sequences
+bool isValidUTF8(std::string_view text, StructuralKernel kernel = bestStructuralKernel());
+
+// Position of the first '"' or '\\' at or after pos (input.size() if there is none). nonASCII is set
+// when a byte in between has its high bit set, i.e. when that run needs UTF-8 validation
+size_t findQuoteOrBackslash(std::string_view input, size_t pos, bool &nonASCII);
+
+#endif // JSON_UTF8_H
@@ -0,0 +1,126 @@
+#include "json_value_ref.h"
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+void summarizeElements(const JSONValue *begin, const JSONValue *end, NumericSummary &summary) {
+    for (const JSONValue *element = begin; element != end; ++element) {
+        if (const auto *integer = std::get_if<int64_t>(&element->value)) {
+            summary.addInteger(*integer);
+        } else if (const auto *number = std::get_if<double>(&element->value)) {
+            summary.addDouble(*number);
+        }
+    }
+}
+
+}
+
+JSONValueRef JSONValueRef::to(const JSONValue &node) {
+    JSONValueRef ref;
+    ref.node = &node;
+    return ref;
+}
+
+JSONValueRef JSONValueRef::to(JSONTapeView view) {
+    JSONValueRef ref;
+    ref.view = view;
+    return ref;
+}
+
+JSONValueRef JSONValueRef::holding(JSONValue value) {
+    JSONValueRef ref;
+    ref.value = std::move(value);
+    return ref;
+}
+
+size_t JSONValueRef::size() const {
+    if (view) {
+        return view->isString() ? view->asString().size() : view->size();
+    }
+    const JSONValue &value = tree();
+    if (value.isArray()) {
+        return value.asArray().size();
+    }
+    if (value.isObject()) {
+        return value.asObject().size();
+    }
+    return value.asString().size();
+}
+
+JSONValueRef JSONValueRef::at(size_t position) const {
+    if (view) {
+        return to(view->at(position));
+    }
+    const JSONValue &value = tree();
+    if (!value.isArray()) {
+        throw std::runtime_error("Attempted to index non-array");
+    }
+    const auto &array = value.asArray();
+    if (position >= array.size()) {
+        throw std::runtime_error("Array index out of bounds");
+    }
+    if (node == nullptr) {
+        // Held arrays are not referenced: the element has to outlive this reference
+        return holding(array[position]);
+    }
+    return to(array[position]);
+}
+
+std::optional<JSONValueRef> JSONValueRef::find(std::string_view key) const {
+    if (view) {
+        auto member = view->find(key);
+        return member ? std::optional(to(*member)) : std::nullopt;
+    }
+    return findKey(JSONString::borrow(key));
+}
+
+std::optional<JSONValueRef> JSONValueRef::findKey(const JSONString &key) const {
+    if (view) {
+        auto member = key.withText([this](std::string_view text) { return view->find(text); });
+        return member ? std::optional(to(*member)) : std::nullopt;
+    }
+    const JSONValue &value = tree();
+    if (!value.isObject()) {
+        throw std::runtime_error("Attempted to access member of non-object");
+    }
+    const auto &object = value.asObject();
+    auto found = object.find(key);
+    if (found == object.end()) {
+        return std::nullopt;
+    }
+    return node != nullptr ? to(found->second) : holding(found->second);
+}
+
+void JSONValueRef::summarizeNumbers(NumericSummary &summary) const {
+    if (view) {
+        view->summarizeNumbers(summary);
+        return;
+    }
+    const JSONArray &array = tree().asArray();
+    if (array.size() >= parallelSummaryThreshold) {
+        auto chunked = summarizeChunks(array.size(), 1, [&array](size_t begin, size_t end, NumericSummary &partial) {
+            summarizeElements(array.data() + begin, array.data() + end, partial);
+            return true;
+        });
+        if (chunked) {
+            summary.merge(*chunked);
+            return;
+        }
+    }
+    summarizeElements(array.data(), array.data() + array.size(), summary);
+}
+
+JSONValue JSONValueRef::toJSONValue() const {
+    return view ? view->toJSONValue() : tree();
+}
+
+std::optional<std::pair<const void *, size_t>> JSONValueRef::identity() const {
+    if (view) {
+        return std::pair<const void *, size_t>(view->owner(), view->tapeIndex());
+    }
+    if (node != nullptr) {
+        return std::pair<const void *, size_t>(node, 0);
+    }
+    return std::nullopt;
+}
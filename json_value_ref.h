@@ -0,0 +1,113 @@
+#ifndef JSON_VALUE_REF_H
+#define JSON_VALUE_REF_H
+
+#include "json_numeric.h"
+#include "json_parser.h"
+#include "json_tape.h"
+#include <cstddef>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+// Value handed between evaluation steps without copying the document: a reference to a node of a JSONValue
+// tree, a position on a JSONTape, or a value held by the reference itself (a literal or a computed scalar).
+// References into a document are valid as long as the document is. Only toJSONValue copies
+class JSONValueRef {
+public:
+    // Holds null
+    JSONValueRef() = default;
+
+    static JSONValueRef to(const JSONValue &node);
+
+    static JSONValueRef to(JSONTapeView view);
+
+    static JSONValueRef holding(JSONValue value);
+
+    [[nodiscard]] bool isNull() const { return view ? view->isNull() : tree().isNull(); }
+
+    [[nodiscard]] bool isBool() const { return view ? view->isBool() : tree().isBool(); }
+
+    [[nodiscard]] bool isNumber() const { return view ? view->isNumber() : tree().isNumber(); }
+
+    [[nodiscard]] bool isInteger() const { return view ? view->isInteger() : tree().isInteger(); }
+
+    [[nodiscard]] bool isString() const { return view ? view->isString() : tree().isString(); }
+
+    [[nodiscard]] bool isArray() const { return view ? view->isArray() : tree().isArray(); }
+
+    [[nodiscard]] bool isObject() const { return view ? view->isObject() : tree().isObject(); }
+
+    [[nodiscard]] bool asBool() const { return view ? view->asBool() : tree().asBool(); }
+
+    // Converts integers
+    [[nodiscard]] double asNumber() const { return view ? view->asNumber() : tree().asNumber(); }
+
+    [[nodiscard]] int64_t asInteger() const { return view ? view->asInteger() : tree().asInteger(); }
+
+    // Calls fn(std::string_view) with the unescaped text of a string
+    template<typename Fn>
+    decltype(auto) withString(Fn &&fn) const {
+        if (view) {
+            return fn(view->asString());
+        }
+        return tree().asString().withText(std::forward<Fn>(fn));
+    }
+
+    // Number of array elements, object members or (unescaped) string bytes
+    [[nodiscard]] size_t size() const;
+
+    // Array element; throws on a non-array or an index out of bounds
+    [[nodiscard]] JSONValueRef at(size_t position) const;
+
+    // Object member, the last one when a key is repeated; throws on a non-object
+    [[nodiscard]] std::optional<JSONValueRef> find(std::string_view key) const;
+
+    // Same, but a tree object is searched with key's own hash, which JSONString::prehashed computes only once
+    [[nodiscard]] std::optional<JSONValueRef> findKey(const JSONString &key) const;
+
+    // Calls fn(element) for each array element, where element is a const JSONValue & or a JSONTapeView.
+    // Both have the same is/as accessors, so a generic lambda reads either without a copy or a branch per element
+    template<typename Fn>
+    void forEachElement(Fn &&fn) const {
+        if (view) {
+            view->forEachElement(fn);
+            return;
+        }
+        for (const auto &element: tree().asArray()) {
+            fn(element);
+        }
+    }
+
+    // Same for the elements [begin, end), so that chunks of an array can be walked on different threads
+    template<typename Fn>
+    void forEachElementIn(size_t begin, size_t end, Fn &&fn) const {
+        if (view) {
+            view->forEachElementIn(begin, end, fn);
+            return;
+        }
+        const JSONArray &array = tree().asArray();
+        for (size_t i = begin; i < end && i < array.size(); ++i) {
+            fn(array[i]);
+        }
+    }
+
+    // Adds the numbers among the elements of an array to summary; other elements are skipped. Arrays of
+    // parallelSummaryThreshold elements or more are summarized in parallel chunks
+    void summarizeNumbers(NumericSummary &summary) const;
+
+    // Copies the value (and everything below it)
+    [[nodiscard]] JSONValue toJSONValue() const;
+
+    // Where the value is in its document, the same for every reference to that node or tape position. Nothing
+    // for a held value
+    [[nodiscard]] std::optional<std::pair<const void *, size_t>> identity() const;
+
+private:
+    const JSONValue *node = nullptr;
+    std::optional<JSONTapeView> view;
+    JSONValue value;
+
+    [[nodiscard]] const JSONValue &tree() const { return node != nullptr ? *node : value; }
+};
+
+#endif // JSON_VALUE_REF_H
@@ -0,0 +1,197 @@
+#include "lookup_index.h"
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <future>
+#include <type_traits>
+
+namespace {
+
+std::string integerKey(int64_t integer) {
+    std::string key(1 + sizeof(integer), 'i');
+    std::memcpy(&key[1], &integer, sizeof(integer));
+    return key;
+}
+
+// Fibonacci hashing onto [0, count), so the shard does not take the low bits the buckets of a shard use
+size_t shardOf(size_t hash, size_t count) {
+    uint64_t mixed = static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ULL;
+    return static_cast<size_t>((static_cast<unsigned __int128>(mixed) * count) >> 64);
+}
+
+}
+
+std::optional<std::string> lookupKey(const JSONValueRef &value) {
+    if (value.isInteger()) {
+        return integerKey(value.asInteger());
+    }
+    if (value.isNumber()) {
+        double number = value.asNumber();
+        if (std::trunc(number) == number && number >= -9223372036854775808.0 && number < 9223372036854775808.0) {
+            return integerKey(static_cast<int64_t>(number));
+        }
+        std::string key(1 + sizeof(number), 'd');
+        std::memcpy(&key[1], &number, sizeof(number));
+        return key;
+    }
+    if (value.isString()) {
+        return value.withString([](std::string_view text) { return 's' + std::string(text); });
+    }
+    if (value.isBool()) {
+        return std::string(value.asBool() ? "t" : "f");
+    }
+    if (value.isNull()) {
+        return std::string("n");
+    }
+    return std::nullopt;
+}
+
+std::optional<JSONValueRef> scanLookup(const JSONValueRef &array, std::string_view key, const std::string &value) {
+    JSONString member = JSONString::prehashed(std::string(key));
+    std::optional<JSONValueRef> found;
+    array.forEachElement([&](const auto &element) {
+        if (found) {
+            return;
+        }
+        JSONValueRef candidate = JSONValueRef::to(element);
+        if (!candidate.isObject()) {
+            return;
+        }
+        auto field = candidate.findKey(member);
+        if (field && lookupKey(*field) == value) {
+            found = std::move(candidate);
+        }
+    });
+    return found;
+}
+
+LookupIndex::LookupIndex(const JSONValueRef &array, std::string_view key, ThreadPool &pool) {
+    JSONString member = JSONString::prehashed(std::string(key));
+    auto entryOf = [&member](const auto &element) -> std::optional<std::pair<Key, Element>> {
+        JSONValueRef candidate = JSONValueRef::to(element);
+        if (!candidate.isObject()) {
+            return std::nullopt;
+        }
+        auto field = candidate.findKey(member);
+        std::optional<std::string> bytes = field ? lookupKey(*field) : std::nullopt;
+        if (!bytes) {
+            return std::nullopt;
+        }
+        size_t hash = std::hash<std::string>()(*bytes);
+        if constexpr (std::is_same_v<std::decay_t<decltype(element)>, JSONTapeView>) {
+            return std::pair<Key, Element>(Key{std::move(*bytes), hash}, element);
+        } else {
+            return std::pair<Key, Element>(Key{std::move(*bytes), hash}, &element);
+        }
+    };
+
+    size_t count = array.size();
+    if (count < parallelIndexThreshold || pool.concurrency() == 1) {
+        shards.resize(1);
+        array.forEachElement([&](const auto &element) {
+            if (auto entry = entryOf(element)) {
+                shards[0].emplace(std::move(entry->first), entry->second);
+            }
+        });
+        return;
+    }
+
+    // First every chunk of elements sorts its entries by shard, then every shard takes its entries chunk by
+    // chunk, so the first element with a key wins as it does in a scan
+    size_t chunks = pool.concurrency() * 4;
+    shards.resize(chunks);
+    size_t chunkSize = (count + chunks - 1) / chunks;
+    std::vector<std::vector<std::vector<std::pair<Key, Element>>>> buckets(
+            chunks, std::vector<std::vector<std::pair<Key, Element>>>(shards.size()));
+    auto runAll = [&pool](size_t tasks, auto &&task) {
+        std::vector<std::future<void>> futures(tasks);
+        for (size_t i = 1; i < tasks; ++i) {
+            futures[i] = pool.submit([&task, i] { task(i); });
+        }
+        std::exception_ptr error;
+        try {
+            task(0);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        // The tasks reference this frame, so they are awaited even when one failed
+        for (size_t i = 1; i < tasks; ++i) {
+            try {
+                pool.wait(futures[i]);
+            } catch (...) {
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    };
+    runAll(chunks, [&](size_t chunk) {
+        auto &chunkBuckets = buckets[chunk];
+        array.forEachElementIn(chunk * chunkSize, (chunk + 1) * chunkSize, [&](const auto &element) {
+            if (auto entry = entryOf(element)) {
+                chunkBuckets[shardOf(entry->first.hash, chunkBuckets.size())].push_back(std::move(*entry));
+            }
+        });
+    });
+    runAll(shards.size(), [&](size_t shard) {
+        for (auto &chunkBuckets: buckets) {
+            for (auto &[entryKey, element]: chunkBuckets[shard]) {
+                shards[shard].emplace(std::move(entryKey), element);
+            }
+            std::vector<std::pair<Key, Element>>().swap(chunkBuckets[shard]);
+        }
+    });
+}
+
+std::optional<JSONValueRef> LookupIndex::find(const std::string &value) const {
+    size_t hash = std::hash<std::string>()(value);
+    const auto &shard = shards[shardOf(hash, shards.size())];
+    auto found = shard.find(Key{value, hash});
+    if (found == shard.end()) {
+        return std::nullopt;
+    }
+    return std::visit([](const auto &element) {
+        if constexpr (std::is_same_v<std::decay_t<decltype(element)>, JSONTapeView>) {
+            return JSONValueRef::to(element);
+        } else {
+            return JSONValueRef::to(*element);
+        }
+    }, found->second);
+}
+
+size_t LookupIndex::size() const {
+    size_t entries = 0;
+    for (const auto &shard: shards) {
+        entries += shard.size();
+    }
+    return entries;
+}
+
+std::optional<JSONValueRef> LookupIndexes::find(const JSONValueRef &array, std::string_view key,
+                                                const std::string &value) {
+    auto identity = array.identity();
+    if (!identity) {
+        // The element would refer into the array, which the caller may drop, so it is copied
+        auto found = scanLookup(array, key, value);
+        return found ? std::optional(JSONValueRef::holding(found->toJSONValue())) : std::nullopt;
+    }
+    std::shared_ptr<Slot> slot;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto &entry = slots[{*identity, std::string(key)}];
+        if (!entry) {
+            entry = std::make_shared<Slot>();
+        }
+        slot = entry;
+    }
+    std::call_once(slot->built, [&] { slot->index = std::make_unique<LookupIndex>(array, key); });
+    return slot->index->find(value);
+}
+
+size_t LookupIndexes::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return slots.size();
+}
@@ -0,0 +1,77 @@
+#ifndef LOOKUP_INDEX_H
+#define LOOKUP_INDEX_H
+
+#include "json_value_ref.h"
+#include "thread_pool.h"
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+// Arrays of at least this many elements get their index built in parallel on the shared ThreadPool
+constexpr size_t parallelIndexThreshold = size_t{1} << 16;
+
+// Hashable form of a scalar that find() compares by: numbers by value (1 and 1.0 are equal), strings by text,
+// booleans and null by kind. Nothing for objects and arrays
+std::optional<std::string> lookupKey(const JSONValueRef &value);
+
+// The first element of array that is an object whose member key has the lookup key value, by a linear scan
+std::optional<JSONValueRef> scanLookup(const JSONValueRef &array, std::string_view key, const std::string &value);
+
+// Hash index of an array of objects by one member: lookup key -> first element with it. Elements that are
+// not objects, lack the member or hold an object or array there are not indexed. Built in shards, so large
+// arrays are indexed in parallel
+class LookupIndex {
+public:
+    LookupIndex(const JSONValueRef &array, std::string_view key, ThreadPool &pool = ThreadPool::shared());
+
+    [[nodiscard]] std::optional<JSONValueRef> find(const std::string &value) const;
+
+    [[nodiscard]] size_t size() const;
+
+private:
+    using Element = std::variant<const JSONValue *, JSONTapeView>;
+
+    struct Key {
+        std::string bytes;
+        size_t hash;
+
+        bool operator==(const Key &other) const { return bytes == other.bytes; }
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key &key) const { return key.hash; }
+    };
+
+    std::vector<std::unordered_map<Key, Element, KeyHash>> shards;
+};
+
+// The LookupIndex of every (array, key) pair queried so far, for a document that stays unchanged while this
+// lives (--serve, batches). An index is built the first time its pair is queried. Safe to use from several
+// threads; concurrent first queries of one pair build its index once
+class LookupIndexes {
+public:
+    // find(array, key, value) with the index of (array, key). A computed array has no place in the document
+    // to remember an index by and is scanned
+    std::optional<JSONValueRef> find(const JSONValueRef &array, std::string_view key, const std::string &value);
+
+    // Number of (array, key) pairs queried through an index
+    [[nodiscard]] size_t size() const;
+
+private:
+    struct Slot {
+        std::once_flag built;
+        std::unique_ptr<LookupIndex> index;
+    };
+
+    mutable std::mutex mutex;
+    std::map<std::pair<std::pair<const void *, size_t>, std::string>, std::shared_ptr<Slot>> slots;
+};
+
+#endif // LOOKUP_INDEX_H
@@ -1,47 +1,135 @@
 #include <iostream>
-#include <fstream>
-#include <sstream>
+#include <memory>
+#include <optional>
+#include "cli_options.h"
+#include "json_input.h"
 #include "json_parser.h"
+#include "json_tape.h"
+#include "json_snapshot.h"
+#include "json_parallel_parser.h"
 #include "expr_parser.h"
+#include "expr_projection.h"
 #include "expr_evaluator.h"
+#include "expr_optimizer.h"
+#include "stream_evaluator.h"
+#include "decompression.h"
+#include "ndjson_evaluator.h"
+#include "thread_pool.h"
+#include "query_server.h"
+#include "batch_evaluator.h"
 
-int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        std::cerr << "Usage: ./json_eval <json_file> <expression>" << '\n';
-        return 1;
-    }
-
-    const char *json_filename = argv[1]; // NOLINT
-    std::string expression_str = argv[2]; // NOLINT
+// The document the expressions run against: the tape with --tape, otherwise the tree
+struct Document {
+    JSONValue root;
+    JSONTape tape;
+};
 
-    // Remove leading and trailing quotation marks if present
-    if (!expression_str.empty() && expression_str.front() == '"' && expression_str.back() == '"') {
-        expression_str = expression_str.substr(1, expression_str.size() - 2);
+// Parses the input the same way in every mode, building only the projected parts of a tree. A snapshot loaded for
+// the current file stands in for the tape, and a missing or stale one is rewritten once the tape is parsed. The input
+// must outlive the document, since strings point into it. Throws std::runtime_error on parse errors
+static Document loadDocument(const Options &options, const JSONInput *input, const ProjectionNode *projection,
+                             std::optional<JSONTape> snapshot, const SourceStamp &source_stamp) {
+    Document document;
+    if (snapshot) {
+        document.tape = std::move(*snapshot);
+    } else if (options.tape) {
+        document.tape = JSONTapeParser(input->view()).parse();
+        if (!options.snapshot.empty()) {
+            // The query does not depend on the snapshot, so failing to write one is only reported
+            try {
+                JSONSnapshot::write(options.snapshot, document.tape, source_stamp);
+            } catch (const std::exception &ex) {
+                std::cerr << "Snapshot error: " << ex.what() << '\n';
+            }
+        }
+    } else if (options.parallel) {
+        document.root = ParallelJSONParser(input->view(), projection, 0, StringStorage::Borrow).parse();
+    } else {
+        document.root = JSONParser(input->view(), projection, StringStorage::Borrow).parse();
     }
+    return document;
+}
 
-    // Read JSON file
-    std::ifstream json_file(json_filename);
-    if (!json_file) {
-        std::cerr << "Failed to open JSON file: " << json_filename << '\n';
+int main(int argc, char *argv[]) {
+    Options options;
+    try {
+        options = parseOptions(argc, argv);
+    } catch (const std::exception &ex) {
+        std::cerr << ex.what() << '\n' << usage() << '\n';
         return 1;
     }
-    std::stringstream buffer;
-    buffer << json_file.rdbuf();
-    std::string json_content = buffer.str();
+    ThreadPool::setSharedConcurrency(options.threads);
 
-    // Parse JSON
-    JSONParser json_parser(json_content);
-    JSONValue root;
+    // Map (or, for pipes and stdin, read) the JSON file. The parser works on the mapped bytes directly.
+    // Streaming reads it through a fixed buffer instead
+    std::unique_ptr<JSONInput> json_input;
+    std::unique_ptr<ByteSource> byte_source;
+    std::optional<JSONTape> snapshot;
+    SourceStamp source_stamp;
     try {
-        root = json_parser.parse();
+        if (!options.snapshot.empty()) {
+            // A snapshot of the current file replaces reading and parsing it
+            source_stamp = SourceStamp::of(options.jsonFile);
+            snapshot = JSONSnapshot::load(options.snapshot, source_stamp);
+        }
+        if (options.stream) {
+            byte_source = openByteSource(options.jsonFile);
+        } else if (!snapshot) {
+            json_input = std::make_unique<JSONInput>(options.jsonFile);
+        }
     } catch (const std::exception &ex) {
-        std::cerr << "JSON parsing error: " << ex.what() << '\n';
+        std::cerr << ex.what() << '\n';
         return 1;
     }
 
+    if (!options.serve.empty()) {
+        // Expressions are not known in advance, so the whole document is parsed and kept resident
+        Document document;
+        try {
+            document = loadDocument(options, json_input.get(), nullptr, std::move(snapshot), source_stamp);
+        } catch (const std::exception &ex) {
+            std::cerr << "JSON parsing error: " << ex.what() << '\n';
+            return 1;
+        }
+        QueryServer server = options.tape ? QueryServer(document.tape) : QueryServer(document.root);
+        if (options.serve == "-") {
+            server.serveConnection(0, 1);
+            return 0;
+        }
+        try {
+            server.listen(options.serve);
+        } catch (const std::exception &ex) {
+            std::cerr << ex.what() << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!options.expressionFile.empty() || options.expressions.size() > 1) {
+        std::vector<std::string> expressions = options.expressions;
+        try {
+            if (!options.expressionFile.empty()) {
+                expressions = BatchEvaluator::readExpressions(options.expressionFile);
+            }
+        } catch (const std::exception &ex) {
+            std::cerr << ex.what() << '\n';
+            return 1;
+        }
+        BatchEvaluator batch(expressions);
+        Document document;
+        try {
+            document = loadDocument(options, json_input.get(), &batch.projection(), std::move(snapshot), source_stamp);
+        } catch (const std::exception &ex) {
+            std::cerr << "JSON parsing error: " << ex.what() << '\n';
+            return 1;
+        }
+        size_t failures = options.tape ? batch.run(document.tape, std::cout, std::cerr)
+                                       : batch.run(document.root, std::cout, std::cerr);
+        return failures == 0 ? 0 : 1;
+    }
+
     // Parse expression
-    // std::cout << "Expression to parse: \"" << expression_str << "\"" << '\n';
-    ExprParser expr_parser(expression_str);
+    ExprParser expr_parser(options.expressions.front());
     ExprPtr expr;
     try {
         expr = expr_parser.parse();
@@ -49,9 +137,54 @@ int main(int argc, char *argv[]) {
         std::cerr << "Expression parsing error: " << ex.what() << '\n';
         return 1;
     }
+    // Fold constants and merge repeated subexpressions, so each is evaluated once
+    expr = ExprOptimizer::optimize(*expr);
+    if (options.explain) {
+        std::cout << ExprOptimizer::explain(*expr);
+        return 0;
+    }
+
+    if (options.stream) {
+        StreamEvaluator stream_evaluator(*expr);
+        try {
+            stream_evaluator.read(*byte_source);
+        } catch (const std::exception &ex) {
+            std::cerr << "JSON parsing error: " << ex.what() << '\n';
+            return 1;
+        }
+        try {
+            std::cout << ExprEvaluator::jsonValueToString(stream_evaluator.evaluate()) << '\n';
+        } catch (const std::exception &ex) {
+            std::cerr << "Evaluation error: " << ex.what() << '\n';
+            return 1;
+        }
+        return 0;
+    }
+
+    if (options.ndjson) {
+        try {
+            NDJSONEvaluator ndjson_evaluator(*expr);
+            ndjson_evaluator.setOrdered(!options.unordered);
+            size_t failures = ndjson_evaluator.run(json_input->view(), std::cout, std::cerr);
+            return failures == 0 ? 0 : 1;
+        } catch (const std::exception &ex) {
+            std::cerr << ex.what() << '\n';
+            return 1;
+        }
+    }
+
+    // Parse JSON, building only the parts of the document the expression can reach
+    ProjectionNode projection = ProjectionCollector::collect(*expr);
+    Document document;
+    try {
+        document = loadDocument(options, json_input.get(), &projection, std::move(snapshot), source_stamp);
+    } catch (const std::exception &ex) {
+        std::cerr << "JSON parsing error: " << ex.what() << '\n';
+        return 1;
+    }
 
     // Evaluate expression
-    ExprEvaluator evaluator(root);
+    ExprEvaluator evaluator = options.tape ? ExprEvaluator(document.tape) : ExprEvaluator(document.root);
     try {
         expr->accept(evaluator);
         std::cout << evaluator.jsonValueToString(evaluator.result) << '\n';
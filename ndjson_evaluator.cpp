@@ -0,0 +1,143 @@
+#include "ndjson_evaluator.h"
+#include "expr_evaluator.h"
+#include "json_parser.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+
+NDJSONEvaluator::NDJSONEvaluator(const Expr &expr, size_t threads)
+        : program(ExprProgram::compile(expr)), projection(ProjectionCollector::collect(expr)),
+          threads(threads != 0 ? threads : ThreadPool::defaultConcurrency()) {}
+
+size_t NDJSONEvaluator::run(std::string_view input, std::ostream &out, std::ostream &err) {
+    std::vector<Batch> batches = split(input);
+    std::atomic<size_t> nextBatch{0};
+    std::mutex mutex;
+    std::condition_variable batchDone;
+    // Finished batches not written yet (ordered output only)
+    std::vector<std::optional<BatchResult>> finished(ordered ? batches.size() : 0);
+    std::exception_ptr error;
+    size_t failures = 0;
+
+    auto work = [&]() {
+        for (size_t index = nextBatch++; index < batches.size(); index = nextBatch++) {
+            std::optional<BatchResult> batchResult;
+            try {
+                batchResult = evaluateBatch(input, batches[index]);
+            } catch (...) {
+                // Not a record error (those are caught per record), e.g. out of memory
+                batchResult.emplace();
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            if (ordered) {
+                finished[index] = std::move(batchResult);
+                batchDone.notify_one();
+            } else {
+                out << batchResult->output;
+                err << batchResult->errors;
+                failures += batchResult->failures;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    size_t workerCount = std::min(threads, batches.size());
+    for (size_t i = 0; i < workerCount; ++i) {
+        workers.emplace_back(work);
+    }
+
+    if (ordered) {
+        // Write each batch as soon as it and all batches before it are done
+        for (size_t index = 0; index < batches.size(); ++index) {
+            BatchResult batchResult;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                batchDone.wait(lock, [&]() { return finished[index].has_value(); });
+                batchResult = std::move(*finished[index]);
+                finished[index].reset();
+            }
+            out << batchResult.output;
+            err << batchResult.errors;
+            failures += batchResult.failures;
+        }
+    }
+
+    for (auto &worker: workers) {
+        worker.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    return failures;
+}
+
+std::vector<NDJSONEvaluator::Batch> NDJSONEvaluator::split(std::string_view input) {
+    std::vector<Batch> batches;
+    size_t begin = 0;
+    size_t line = 1;
+    while (begin < input.size()) {
+        size_t end = input.size();
+        if (input.size() - begin > batchBytes) {
+            // End the batch after the first newline past batchBytes
+            const void *newline = std::memchr(input.data() + begin + batchBytes, '\n',
+                                              input.size() - begin - batchBytes);
+            if (newline != nullptr) {
+                end = static_cast<const char *>(newline) - input.data() + 1;
+            }
+        }
+        batches.push_back({begin, end, line});
+        line += std::count(input.begin() + begin, input.begin() + end, '\n');
+        begin = end;
+    }
+    return batches;
+}
+
+NDJSONEvaluator::BatchResult NDJSONEvaluator::evaluateBatch(std::string_view input, const Batch &batch) const {
+    BatchResult batchResult;
+    ExprVM vm(program);
+    size_t line = batch.firstLine;
+    size_t pos = batch.begin;
+    while (pos < batch.end) {
+        size_t end = input.find('\n', pos);
+        if (end == std::string_view::npos || end > batch.end) {
+            end = batch.end;
+        }
+        std::string_view record = input.substr(pos, end - pos);
+        pos = end + 1;
+
+        if (record.find_first_not_of(" \t\r") != std::string_view::npos) {
+            std::string error;
+            JSONValue root;
+            try {
+                // Strings are borrowed from the record, which outlives the value
+                root = JSONParser(record, &projection, StringStorage::Borrow).parse();
+            } catch (const std::exception &ex) {
+                error = std::string("JSON parsing error: ") + ex.what();
+            }
+            if (error.empty()) {
+                try {
+                    batchResult.output += ExprEvaluator::jsonValueToString(vm.run(root).toJSONValue());
+                    batchResult.output += '\n';
+                } catch (const std::exception &ex) {
+                    error = std::string("Evaluation error: ") + ex.what();
+                }
+            }
+            if (!error.empty()) {
+                batchResult.errors += "Line " + std::to_string(line) + ": " + error + '\n';
+                ++batchResult.failures;
+            }
+        }
+        ++line;
+    }
+    return batchResult;
+}
@@ -0,0 +1,54 @@
+#ifndef NDJSON_EVALUATOR_H
+#define NDJSON_EVALUATOR_H
+
+#include "expr_bytecode.h"
+#include "expr_projection.h"
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Evaluates one expression against every record of a JSON Lines (NDJSON) input. The input is cut at
+// newlines into batches of about batchBytes, and a pool of worker threads takes batches one at a time,
+// parsing each record with its own JSONParser (projected to the paths the expression reaches) and
+// evaluating it with the expression compiled once to an ExprProgram. Blank lines are skipped
+class NDJSONEvaluator {
+public:
+    static constexpr size_t batchBytes = 1 << 16;
+
+    // threads == 0 uses ThreadPool::defaultConcurrency(). Throws std::runtime_error when expr does not compile
+    explicit NDJSONEvaluator(const Expr &expr, size_t threads = 0);
+
+    // Ordered (the default) writes results in input order. Unordered writes each batch as soon as it is done
+    void setOrdered(bool value) { ordered = value; }
+
+    // Writes one line per record to out. A record that fails writes "Line <n>: <error>" to err instead.
+    // Returns the number of failed records. input has to stay valid until run returns
+    size_t run(std::string_view input, std::ostream &out, std::ostream &err);
+
+private:
+    struct Batch {
+        size_t begin;
+        size_t end;
+        // 1-based line number of the batch's first line
+        size_t firstLine;
+    };
+
+    struct BatchResult {
+        std::string output;
+        std::string errors;
+        size_t failures = 0;
+    };
+
+    ExprProgram program;
+    ProjectionNode projection;
+    size_t threads;
+    bool ordered = true;
+
+    [[nodiscard]] static std::vector<Batch> split(std::string_view input);
+
+    [[nodiscard]] BatchResult evaluateBatch(std::string_view input, const Batch &batch) const;
+};
+
+#endif // NDJSON_EVALUATOR_H
@@ -0,0 +1,263 @@
+#include "query_server.h"
+#include "expr_evaluator.h"
+#include "expr_optimizer.h"
+#include "expr_parser.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <system_error>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// Requests longer than this are refused, and the connection is closed since the rest of it cannot be framed
+constexpr size_t maxRequestSize = size_t{1} << 20;
+
+std::string frame(const char *status, const std::string &payload) {
+    return std::string(status) + ' ' + std::to_string(payload.size()) + '\n' + payload;
+}
+
+// Buffered reads from a descriptor
+class FrameReader {
+public:
+    explicit FrameReader(int fd) : fd(fd) {}
+
+    // Line without its newline; nothing at the end of the input
+    std::optional<std::string> readLine() {
+        std::string line;
+        while (true) {
+            if (position == buffered && !fill()) {
+                if (line.empty()) {
+                    return std::nullopt;
+                }
+                return line;
+            }
+            const char *start = buffer + position;
+            const auto *newline = static_cast<const char *>(std::memchr(start, '\n', buffered - position));
+            if (newline != nullptr) {
+                line.append(start, newline);
+                position += newline - start + 1;
+                return line;
+            }
+            line.append(start, buffered - position);
+            position = buffered;
+            if (line.size() > maxRequestSize) {
+                throw std::runtime_error("Request line too long");
+            }
+        }
+    }
+
+    // Exactly count bytes; throws when the input ends before
+    std::string readExactly(size_t count) {
+        std::string bytes;
+        bytes.reserve(count);
+        while (bytes.size() < count) {
+            if (position == buffered && !fill()) {
+                throw std::runtime_error("Connection closed inside a request");
+            }
+            size_t take = std::min(count - bytes.size(), buffered - position);
+            bytes.append(buffer + position, take);
+            position += take;
+        }
+        return bytes;
+    }
+
+private:
+    int fd;
+    char buffer[65536];
+    size_t position = 0;
+    size_t buffered = 0;
+
+    bool fill() {
+        ssize_t count;
+        do {
+            count = ::read(fd, buffer, sizeof(buffer));
+        } while (count < 0 && errno == EINTR);
+        position = 0;
+        buffered = count > 0 ? static_cast<size_t>(count) : 0;
+        return buffered != 0;
+    }
+};
+
+bool writeAll(int fd, const std::string &bytes) {
+    size_t written = 0;
+    while (written < bytes.size()) {
+        ssize_t count = ::write(fd, bytes.data() + written, bytes.size() - written);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            return false;
+        }
+        written += static_cast<size_t>(count);
+    }
+    return true;
+}
+
+// Removes what is left at path by a server that is gone. Anything else there, be it a file or the socket of a
+// server that still listens, is left alone and refused
+void removeStaleSocket(const std::string &path, const sockaddr_un &address) {
+    struct stat info{};
+    if (::lstat(path.c_str(), &info) != 0) {
+        if (errno == ENOENT) {
+            return;
+        }
+        throw std::runtime_error("Could not inspect " + path + ": " + std::strerror(errno));
+    }
+    if (!S_ISSOCK(info.st_mode)) {
+        throw std::runtime_error("Could not listen on " + path + ": it exists and is not a socket");
+    }
+    int probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (probe < 0) {
+        throw std::runtime_error("Could not create socket: " + std::string(std::strerror(errno)));
+    }
+    int connected = ::connect(probe, reinterpret_cast<const sockaddr *>(&address), sizeof(address));
+    int error = errno;
+    ::close(probe);
+    if (connected == 0) {
+        throw std::runtime_error("Could not listen on " + path + ": another server is listening on it");
+    }
+    // Nobody accepts on a socket whose server has exited, and a socket removed in the meantime is not there
+    if (error == ECONNREFUSED) {
+        ::unlink(path.c_str());
+    } else if (error != ENOENT) {
+        throw std::runtime_error("Could not listen on " + path + ": " + std::strerror(error));
+    }
+}
+
+}
+
+QueryServer::QueryServer(const JSONValue &root) : root(&root) {}
+
+QueryServer::QueryServer(const JSONTape &tape) : tape(&tape) {}
+
+std::string QueryServer::answer(std::string_view expression) const {
+    if (expression == ":stats") {
+        ExprCache::Stats stats = cache.stats();
+        return frame("ok", "hits " + std::to_string(stats.hits) + " misses " + std::to_string(stats.misses) +
+                           " entries " + std::to_string(stats.entries) + " bytes " + std::to_string(stats.bytes) +
+                           " evictions " + std::to_string(stats.evictions));
+    }
+    ExprPtr expr;
+    try {
+        expr = ExprOptimizer::optimize(*ExprParser(std::string(expression)).parse());
+    } catch (const std::exception &ex) {
+        return frame("error", std::string("Expression parsing error: ") + ex.what());
+    }
+    try {
+        ExprEvaluator evaluator = tape != nullptr ? ExprEvaluator(*tape) : ExprEvaluator(*root);
+        evaluator.setCache(&cache, generation);
+        evaluator.setLookupIndexes(&indexes);
+        expr->accept(evaluator);
+        return frame("ok", ExprEvaluator::jsonValueToString(evaluator.result));
+    } catch (const std::exception &ex) {
+        return frame("error", std::string("Evaluation error: ") + ex.what());
+    }
+}
+
+void QueryServer::serveConnection(int in, int out) const {
+    FrameReader reader(in);
+    try {
+        while (auto header = reader.readLine()) {
+            if (!header->empty() && header->back() == '\r') {
+                header->pop_back();
+            }
+            if (header->empty()) {
+                continue;
+            }
+            std::string expression;
+            if (header->size() <= 7 &&
+                header->find_first_not_of("0123456789") == std::string::npos) {
+                size_t length = std::stoul(*header);
+                if (length > maxRequestSize) {
+                    writeAll(out, frame("error", "Request too long"));
+                    return;
+                }
+                expression = reader.readExactly(length);
+            } else {
+                expression = std::move(*header);
+            }
+            if (!writeAll(out, answer(expression))) {
+                return;
+            }
+        }
+    } catch (const std::exception &ex) {
+        writeAll(out, frame("error", ex.what()));
+    }
+}
+
+void QueryServer::listen(const std::string &path) const {
+    // A client that goes away must not take the server with it
+    std::signal(SIGPIPE, SIG_IGN);
+
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path too long: " + path);
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    removeStaleSocket(path, address);
+    int server = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) {
+        throw std::runtime_error("Could not create socket: " + std::string(std::strerror(errno)));
+    }
+    if (::bind(server, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0 ||
+        ::listen(server, SOMAXCONN) != 0) {
+        std::string error = std::strerror(errno);
+        ::close(server);
+        throw std::runtime_error("Could not listen on " + path + ": " + error);
+    }
+
+    // Connections block on their clients, so they get threads of their own rather than pool workers. A fixed
+    // number of them take turns accepting, and further clients wait in the backlog. Evaluation inside them
+    // still uses the shared pool
+    std::mutex mutex;
+    std::string failure;
+    auto acceptConnections = [&]() {
+        while (true) {
+            int client = ::accept(server, nullptr, nullptr);
+            if (client < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                std::string error = std::strerror(errno);
+                std::lock_guard<std::mutex> lock(mutex);
+                if (failure.empty()) {
+                    failure = error;
+                    // Wakes the other threads from accept once they are done with their clients
+                    ::shutdown(server, SHUT_RDWR);
+                }
+                return;
+            }
+            serveConnection(client, client);
+            ::close(client);
+        }
+    };
+    std::vector<std::thread> connections;
+    try {
+        for (size_t i = 0; i < connectionThreads; ++i) {
+            connections.emplace_back(acceptConnections);
+        }
+    } catch (const std::system_error &ex) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (failure.empty()) {
+            failure = ex.what();
+            ::shutdown(server, SHUT_RDWR);
+        }
+    }
+    for (auto &connection: connections) {
+        connection.join();
+    }
+    ::close(server);
+    throw std::runtime_error("Could not accept on " + path + ": " + failure);
+}
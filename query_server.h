@@ -0,0 +1,55 @@
+#ifndef QUERY_SERVER_H
+#define QUERY_SERVER_H
+
+#include "expr_cache.h"
+#include "json_parser.h"
+#include "json_tape.h"
+#include "lookup_index.h"
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Answers expressions against one document that is parsed once and stays resident (--serve). Requests share
+// the document read-only, so any number of them can run at the same time.
+//
+// Protocol, the same on a Unix socket and on stdin/stdout. A request is a frame
+//   <length>\n<expression of length bytes>
+// or, for typing at a terminal, a line holding the expression alone (unless it is all digits, which reads as
+// a length). Empty lines are skipped. Every other request gets one response frame
+//   ok <length>\n<result>      or      error <length>\n<message>
+// with the result printed as the command line prints it, and the message as it would go to stderr. The request
+// :stats is answered with the counters of the result cache instead.
+//
+// Call and operator results are cached across requests, so a subexpression that was answered before is not
+// recomputed, and the hash indexes find() builds are kept for later lookups
+class QueryServer {
+public:
+    // Connections served at the same time by listen; more clients wait until one of them closes
+    static constexpr size_t connectionThreads = 64;
+
+    explicit QueryServer(const JSONValue &root);
+
+    explicit QueryServer(const JSONTape &tape);
+
+    // Response frame for one request
+    [[nodiscard]] std::string answer(std::string_view expression) const;
+
+    // Answers the requests read from the in descriptor on the out descriptor until in ends or out is closed
+    void serveConnection(int in, int out) const;
+
+    // Accepts connections on a Unix socket created at path and serves each on a thread of its own, at most
+    // connectionThreads of them at a time. A socket left at path by a server that has exited is replaced;
+    // anything else there is refused. Returns only by throwing std::runtime_error when the socket cannot be
+    // set up
+    void listen(const std::string &path) const;
+
+private:
+    const JSONValue *root = nullptr;
+    const JSONTape *tape = nullptr;
+    mutable ExprCache cache;
+    mutable LookupIndexes indexes;
+    // The resident document never changes, so all requests evaluate against one generation
+    static constexpr uint64_t generation = 1;
+};
+
+#endif // QUERY_SERVER_H
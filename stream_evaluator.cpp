@@ -0,0 +1,455 @@
+#include "stream_evaluator.h"
+#include <algorithm>
+#include <stdexcept>
+
+void StreamAggregate::reset() {
+    numbers.reset();
+    if (function != builtinSize) {
+        numbers.emplace(function);
+    }
+    size = 0;
+    unresolvedArgs = argNodes.size();
+    error.clear();
+    for (const auto *literal: literals) {
+        if (literal->integer) {
+            addInteger(*literal->integer);
+        } else {
+            addNumber(literal->value);
+        }
+    }
+}
+
+void StreamAggregate::addNumber(double number) {
+    numbers->addDouble(number);
+}
+
+void StreamAggregate::addInteger(int64_t integer) {
+    numbers->addInteger(integer);
+}
+
+void StreamAggregate::fail(const std::string &message) {
+    if (error.empty()) {
+        error = message;
+    }
+}
+
+// Projection collection, except that foldable aggregate calls register themselves on their argument paths
+// instead of marking those paths whole
+class StreamEvaluator::Planner : public ProjectionCollector {
+public:
+    explicit Planner(StreamEvaluator &owner) : owner(owner) {}
+
+    ProjectionNode plan(const Expr &expr) {
+        collectWhole(expr);
+        return std::move(root);
+    }
+
+    using ProjectionCollector::visit;
+
+    void visit(const CallExpr &expr) override {
+        BuiltinFunction function = findBuiltinFunction(expr.callee);
+        bool isSize = function == builtinSize;
+        // Arguments whose values are folded; the rest are parameters
+        std::optional<size_t> aggregated;
+        if (isSize) {
+            aggregated = expr.arguments.size() == 1 ? std::optional<size_t>(1) : std::nullopt;
+        } else if (isNumericAggregate(function)) {
+            aggregated = aggregatedArguments(function, expr.arguments.size());
+        }
+        bool foldable = aggregated.has_value();
+        for (size_t i = 0; foldable && i < expr.arguments.size(); ++i) {
+            bool isLiteral = dynamic_cast<const NumberExpr *>(expr.arguments[i].get()) != nullptr;
+            foldable = i < *aggregated ? isStaticPath(*expr.arguments[i]) || (isLiteral && !isSize) : isLiteral;
+        }
+        if (!foldable) {
+            ProjectionCollector::visit(expr);
+            return;
+        }
+
+        auto aggregate = std::make_unique<StreamAggregate>();
+        aggregate->call = &expr;
+        aggregate->function = function;
+        for (size_t i = 0; i < expr.arguments.size(); ++i) {
+            const Expr &arg = *expr.arguments[i];
+            if (const auto *number = dynamic_cast<const NumberExpr *>(&arg); number != nullptr) {
+                (i < *aggregated ? aggregate->literals : aggregate->parameters).push_back(number);
+                continue;
+            }
+            current = nullptr;
+            arg.accept(*this);
+            aggregate->argNodes.push_back(current);
+        }
+        current = nullptr;
+        owner.aggregates.push_back(std::move(aggregate));
+    }
+
+private:
+    StreamEvaluator &owner;
+};
+
+// Turns reader events into the sparse root, aggregate states and the count of values still missing
+class StreamEvaluator::Collector : public JSONHandler {
+public:
+    explicit Collector(StreamEvaluator &owner) : owner(owner), pending(owner.leafCount) {}
+
+    HandlerAction startObject() override {
+        return startContainer(false);
+    }
+
+    HandlerAction key(std::string_view key) override {
+        frames.back().key.assign(key.data(), key.size());
+        return HandlerAction::Continue;
+    }
+
+    HandlerAction endObject() override {
+        return endContainer();
+    }
+
+    HandlerAction startArray() override {
+        return startContainer(true);
+    }
+
+    HandlerAction endArray() override {
+        return endContainer();
+    }
+
+    HandlerAction null() override {
+        return scalar({ScalarEvent::Type::Null, 0, false, {}});
+    }
+
+    HandlerAction boolean(bool value) override {
+        return scalar({ScalarEvent::Type::Bool, 0, value, {}});
+    }
+
+    HandlerAction integer(int64_t value) override {
+        return scalar({ScalarEvent::Type::Integer, static_cast<double>(value), false, {}, value});
+    }
+
+    HandlerAction number(double value) override {
+        return scalar({ScalarEvent::Type::Number, value, false, {}});
+    }
+
+    HandlerAction string(std::string_view value) override {
+        return scalar({ScalarEvent::Type::String, 0, false, value});
+    }
+
+private:
+    struct ScalarEvent {
+        enum class Type {
+            Null, Bool, Integer, Number, String
+        };
+        Type type;
+        double number;
+        bool flag;
+        std::string_view text;
+        int64_t integer = 0;
+
+        [[nodiscard]] bool isNumber() const { return type == Type::Integer || type == Type::Number; }
+
+        void addTo(StreamAggregate &aggregate) const {
+            if (type == Type::Integer) {
+                aggregate.addInteger(integer);
+            } else {
+                aggregate.addNumber(number);
+            }
+        }
+
+        [[nodiscard]] JSONValue toValue() const {
+            switch (type) {
+                case Type::Null:
+                    return nullptr;
+                case Type::Bool:
+                    return flag;
+                case Type::Integer:
+                    return integer;
+                case Type::Number:
+                    return number;
+                case Type::String:
+                    return std::string(text);
+            }
+            return nullptr;
+        }
+    };
+
+    // Where the value that starts next goes
+    struct Slot {
+        const ProjectionNode *node = nullptr;
+        JSONValue *target = nullptr;
+        bool whole = false;
+    };
+
+    struct Frame {
+        bool isArray;
+        const ProjectionNode *node;
+        JSONValue *target;
+        bool whole;
+        // Aggregates over this container's direct children
+        const std::vector<StreamAggregate *> *sinks;
+        size_t nextIndex = 0;
+        std::string key;
+    };
+
+    StreamEvaluator &owner;
+    std::vector<Frame> frames;
+    std::unordered_set<const ProjectionNode *> seen;
+    size_t pending;
+
+    const std::vector<StreamAggregate *> *sinksOf(const ProjectionNode *node) const {
+        if (node == nullptr) {
+            return nullptr;
+        }
+        auto found = owner.sinks.find(node);
+        return found != owner.sinks.end() ? &found->second : nullptr;
+    }
+
+    static JSONValue *insertInto(Frame &parent) {
+        if (parent.isArray) {
+            auto &arr = std::get<JSONArray>(parent.target->value);
+            // Null placeholders keep projected indices in place, like JSONParser's projection
+            arr.resize(parent.nextIndex);
+            return &arr.emplace_back();
+        }
+        auto &slot = std::get<JSONObject>(parent.target->value)[parent.key];
+        slot = JSONValue();
+        return &slot;
+    }
+
+    Slot childSlot() {
+        if (frames.empty()) {
+            return {&owner.projection, &owner.root, owner.projection.whole};
+        }
+        Frame &parent = frames.back();
+        if (parent.whole) {
+            return {nullptr, insertInto(parent), true};
+        }
+        if (parent.node == nullptr) {
+            return {};
+        }
+        const ProjectionNode *child = nullptr;
+        if (parent.isArray) {
+            auto found = parent.node->elements.find(parent.nextIndex);
+            child = found != parent.node->elements.end() ? found->second.get() : nullptr;
+        } else {
+            auto found = parent.node->members.find(JSONString::borrow(parent.key));
+            child = found != parent.node->members.end() ? found->second.get() : nullptr;
+        }
+        // Only the first occurrence of a path counts
+        if (child == nullptr || !seen.insert(child).second) {
+            return {};
+        }
+        return {child, insertInto(parent), child->whole};
+    }
+
+    // event is null for containers
+    void feedParentSinks(const ScalarEvent *event) {
+        if (frames.empty() || frames.back().sinks == nullptr) {
+            return;
+        }
+        for (auto *aggregate: *frames.back().sinks) {
+            if (aggregate->function == builtinSize) {
+                aggregate->size += 1;
+            } else if (event != nullptr && event->isNumber() && frames.back().isArray) {
+                event->addTo(*aggregate);
+            }
+        }
+    }
+
+    static std::string typeError(const StreamAggregate &aggregate) {
+        if (aggregate.function == builtinSize) {
+            return "size() argument must be an object, array, or string";
+        }
+        return aggregate.call->callee + "() arguments must be numbers or arrays of numbers";
+    }
+
+    // Called when the value at node is complete
+    HandlerAction resolve(const ProjectionNode *node) {
+        const auto *nodeSinks = sinksOf(node);
+        if (node == nullptr || (!node->whole && nodeSinks == nullptr)) {
+            return HandlerAction::Continue;
+        }
+        if (nodeSinks != nullptr) {
+            for (auto *aggregate: *nodeSinks) {
+                --aggregate->unresolvedArgs;
+            }
+        }
+        return --pending == 0 ? HandlerAction::Stop : HandlerAction::Continue;
+    }
+
+    void finishValue() {
+        if (!frames.empty() && frames.back().isArray) {
+            ++frames.back().nextIndex;
+        }
+    }
+
+    HandlerAction scalar(const ScalarEvent &event) {
+        Slot slot = childSlot();
+        feedParentSinks(&event);
+        if (slot.target != nullptr) {
+            *slot.target = event.toValue();
+        }
+        if (const auto *nodeSinks = sinksOf(slot.node); nodeSinks != nullptr) {
+            for (auto *aggregate: *nodeSinks) {
+                if (aggregate->function == builtinSize && event.type == ScalarEvent::Type::String) {
+                    aggregate->size = static_cast<int64_t>(event.text.size());
+                } else if (aggregate->function != builtinSize && event.isNumber()) {
+                    event.addTo(*aggregate);
+                } else {
+                    aggregate->fail(typeError(*aggregate));
+                }
+            }
+        }
+        HandlerAction action = resolve(slot.node);
+        finishValue();
+        return action;
+    }
+
+    HandlerAction startContainer(bool isArray) {
+        Slot slot = childSlot();
+        feedParentSinks(nullptr);
+        if (slot.target == nullptr) {
+            // Nothing below this container is needed
+            finishValue();
+            return HandlerAction::Skip;
+        }
+        *slot.target = isArray ? JSONValue(JSONArray{}) : JSONValue(JSONObject{});
+        const auto *nodeSinks = sinksOf(slot.node);
+        if (nodeSinks != nullptr && !isArray) {
+            for (auto *aggregate: *nodeSinks) {
+                if (aggregate->function != builtinSize) {
+                    aggregate->fail(typeError(*aggregate));
+                }
+            }
+        }
+        frames.push_back({isArray, slot.node, slot.target, slot.whole, nodeSinks, 0, {}});
+        return HandlerAction::Continue;
+    }
+
+    HandlerAction endContainer() {
+        const ProjectionNode *node = frames.back().node;
+        frames.pop_back();
+        HandlerAction action = resolve(node);
+        finishValue();
+        return action;
+    }
+};
+
+StreamEvaluator::StreamEvaluator(const Expr &expr) : expr(expr) {
+    Planner planner(*this);
+    projection = planner.plan(expr);
+    resolveFallbacks();
+    leafCount = countLeaves(projection);
+}
+
+// An aggregate argument inside a materialized subtree is read from there instead. Its other arguments
+// then have to be materialized too, which can in turn swallow further aggregates
+void StreamEvaluator::resolveFallbacks() {
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        std::unordered_set<const ProjectionNode *> covered;
+        std::vector<std::pair<const ProjectionNode *, bool>> stack = {{&projection, false}};
+        while (!stack.empty()) {
+            auto [node, underWhole] = stack.back();
+            stack.pop_back();
+            bool isCovered = underWhole || node->whole;
+            if (isCovered) {
+                covered.insert(node);
+            }
+            for (const auto &member: node->members) {
+                stack.emplace_back(member.second.get(), isCovered);
+            }
+            for (const auto &element: node->elements) {
+                stack.emplace_back(element.second.get(), isCovered);
+            }
+        }
+        for (auto &aggregate: aggregates) {
+            if (aggregate->fallback) {
+                continue;
+            }
+            bool clashes = std::any_of(aggregate->argNodes.begin(), aggregate->argNodes.end(),
+                                       [&covered](const ProjectionNode *node) { return covered.count(node) != 0; });
+            if (clashes) {
+                aggregate->fallback = true;
+                for (auto *node: aggregate->argNodes) {
+                    node->whole = true;
+                }
+                changed = true;
+            }
+        }
+    }
+
+    sinks.clear();
+    for (auto &aggregate: aggregates) {
+        if (!aggregate->fallback) {
+            for (auto *node: aggregate->argNodes) {
+                sinks[node].push_back(aggregate.get());
+            }
+        }
+    }
+}
+
+size_t StreamEvaluator::countLeaves(const ProjectionNode &node) const {
+    size_t leaves = node.whole || sinks.count(&node) != 0 ? 1 : 0;
+    if (node.whole) {
+        return leaves;
+    }
+    for (const auto &member: node.members) {
+        leaves += countLeaves(*member.second);
+    }
+    for (const auto &element: node.elements) {
+        leaves += countLeaves(*element.second);
+    }
+    return leaves;
+}
+
+void StreamEvaluator::read(ByteSource &source, size_t bufferSize) {
+    root = JSONValue();
+    precomputed.clear();
+    readBytes = 0;
+    for (auto &aggregate: aggregates) {
+        aggregate->reset();
+    }
+
+    if (leafCount == 0) {
+        // The expression does not read the document at all
+        earlyExit = true;
+    } else {
+        JSONStreamReader reader(source, bufferSize);
+        Collector collector(*this);
+        earlyExit = !reader.parse(collector);
+        readBytes = reader.bytesRead();
+    }
+
+    for (auto &aggregate: aggregates) {
+        // Unresolved arguments name paths that are not in the document. Leaving the call to the evaluator
+        // reports that the same way a full parse would
+        if (aggregate->fallback || aggregate->unresolvedArgs != 0) {
+            continue;
+        }
+        if (aggregate->function == builtinSize) {
+            precomputed[aggregate->call] = JSONValueRef::holding(aggregate->size);
+            continue;
+        }
+        std::vector<JSONValueRef> parameters;
+        for (const auto *parameter: aggregate->parameters) {
+            parameters.push_back(parameter->integer ? JSONValueRef::holding(*parameter->integer)
+                                                    : JSONValueRef::holding(parameter->value));
+        }
+        try {
+            precomputed[aggregate->call] = JSONValueRef::holding(aggregate->numbers->finish(parameters.data()));
+        } catch (const std::runtime_error &error) {
+            aggregate->fail(error.what());
+        }
+    }
+}
+
+JSONValue StreamEvaluator::evaluate() const {
+    for (const auto &aggregate: aggregates) {
+        if (!aggregate->fallback && aggregate->unresolvedArgs == 0 && !aggregate->error.empty()) {
+            throw std::runtime_error(aggregate->error);
+        }
+    }
+    ExprEvaluator evaluator(root, &precomputed);
+    expr.accept(evaluator);
+    return evaluator.result;
+}
@@ -0,0 +1,83 @@
+#ifndef STREAM_EVALUATOR_H
+#define STREAM_EVALUATOR_H
+
+#include "expr_evaluator.h"
+#include "expr_projection.h"
+#include "json_numeric.h"
+#include "json_stream.h"
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// size or numeric aggregate call whose arguments are static paths or number literals (and whose parameters,
+// such as the p of percentile, are number literals). It is computed from the events as they go by, so the
+// arrays it reads are never stored
+struct StreamAggregate {
+    const CallExpr *call;
+    BuiltinFunction function;
+    std::vector<ProjectionNode *> argNodes;
+    std::vector<const NumberExpr *> literals;
+    std::vector<const NumberExpr *> parameters;
+    // Falls back to ordinary evaluation, with its arguments materialized
+    bool fallback = false;
+
+    // Same bookkeeping as the builtins of ExprEvaluator, so the results agree
+    std::optional<NumberAggregate> numbers;
+    int64_t size = 0;
+    size_t unresolvedArgs = 0;
+    std::string error;
+
+    void reset();
+
+    void addNumber(double number);
+
+    void addInteger(int64_t integer);
+
+    // Keeps the first error, which is the one ordinary evaluation would have thrown
+    void fail(const std::string &message);
+};
+
+// Evaluates an expression over a streamed document without building it. Only the values the expression
+// can reach are materialized (as with JSONParser's projection), aggregates are folded into the pass, and
+// reading stops as soon as every needed value has been seen. If a path occurs more than once (repeated
+// keys), the first occurrence is used
+class StreamEvaluator {
+public:
+    explicit StreamEvaluator(const Expr &expr);
+
+    // Reads the document until everything the expression needs is known
+    void read(ByteSource &source, size_t bufferSize = JSONStreamReader::defaultBufferSize);
+
+    [[nodiscard]] JSONValue evaluate() const;
+
+    // True when read() returned before the end of the input
+    [[nodiscard]] bool stoppedEarly() const { return earlyExit; }
+
+    [[nodiscard]] uint64_t bytesRead() const { return readBytes; }
+
+private:
+    class Planner;
+
+    class Collector;
+
+    const Expr &expr;
+    ProjectionNode projection;
+    std::vector<std::unique_ptr<StreamAggregate>> aggregates;
+    // Aggregates fed by the value at a node, once per argument that names it
+    std::unordered_map<const ProjectionNode *, std::vector<StreamAggregate *>> sinks;
+    size_t leafCount = 0;
+
+    JSONValue root;
+    PrecomputedResults precomputed;
+    bool earlyExit = false;
+    uint64_t readBytes = 0;
+
+    void resolveFallbacks();
+
+    size_t countLeaves(const ProjectionNode &node) const;
+};
+
+#endif // STREAM_EVALUATOR_H
@@ -0,0 +1,72 @@
+#include "batch_evaluator.h"
+#include "expr_parser.h"
+#include "json_parser.h"
+#include "json_tape.h"
+#include "gtest/gtest.h"
+#include <sstream>
+
+// clang-format off
+namespace {
+
+const char *document = R"({"a": {"b": [1, 2, {"c": "test"}, [11, 12]], "n": 2.5}, "k": "n", "big": {"x": [5, 6, 7]}})";
+
+std::string single(const std::string &expression) {
+    JSONValue root = JSONParser(document).parse();
+    ExprPtr expr = ExprParser(expression).parse();
+    ExprEvaluator evaluator(root);
+    try {
+        expr->accept(evaluator);
+    } catch (const std::exception &) {
+        return "";
+    }
+    return ExprEvaluator::jsonValueToString(evaluator.result);
+}
+
+}
+
+TEST(BatchEvaluatorTest, MatchSingleEvaluation) {
+    std::vector<std::string> expressions = {"a.b[1]", "a.b[2].c", "max(a.b[3]) + a.b[0]", "a[k]", "a.b[a.b[1]].c",
+                                            "a[\"n\"] * 2", "size(big.x) + min(big.x)", "a.missing", "a.b[9]",
+                                            "a.n.x", "a.b[\"x\"]", "k[0]", "1 + 2", "big"};
+    std::string expected;
+    for (const auto &expression: expressions) {
+        expected += single(expression) + '\n';
+    }
+    BatchEvaluator batch(expressions);
+
+    JSONValue root = JSONParser(document).parse();
+    std::ostringstream out;
+    std::ostringstream errors;
+    EXPECT_EQ(batch.run(root, out, errors), 5u);
+    EXPECT_EQ(out.str(), expected);
+    EXPECT_NE(errors.str().find("Expression 8: Evaluation error: Key not found: missing\n"), std::string::npos);
+
+    JSONTape tape = JSONTapeParser(document).parse();
+    std::ostringstream tapeOut;
+    std::ostringstream tapeErrors;
+    EXPECT_EQ(batch.run(tape, tapeOut, tapeErrors), 5u);
+    EXPECT_EQ(tapeOut.str(), expected);
+}
+
+TEST(BatchEvaluatorTest, ParseWithMergedProjection) {
+    BatchEvaluator batch({"a.b[1]", "big.x[2]", "a.n + 1"});
+    const ProjectionNode &paths = batch.projection();
+    EXPECT_EQ(paths.members.size(), 2u);
+    EXPECT_EQ(paths.members.at("a")->members.size(), 2u);
+
+    JSONValue root = JSONParser(document, &paths).parse();
+    std::ostringstream out;
+    std::ostringstream errors;
+    EXPECT_EQ(batch.run(root, out, errors), 0u);
+    EXPECT_EQ(out.str(), "2\n7\n3.5\n");
+}
+
+TEST(BatchEvaluatorTest, ReportExpressionsThatDoNotParse) {
+    BatchEvaluator batch({"a.b[0]", "a.(", "a.n"});
+    JSONValue root = JSONParser(document).parse();
+    std::ostringstream out;
+    std::ostringstream errors;
+    EXPECT_EQ(batch.run(root, out, errors), 1u);
+    EXPECT_EQ(out.str(), "1\n\n2.5\n");
+    EXPECT_EQ(errors.str().rfind("Expression 2: Expression parsing error: ", 0), 0u);
+}
@@ -0,0 +1,150 @@
+#include "decompression.h"
+#include "json_input.h"
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <fstream>
+#include <zlib.h>
+
+#ifdef JSON_EVAL_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+// clang-format off
+namespace {
+
+// gzip-compresses data as one member
+std::string gzip(const std::string &data) {
+    z_stream stream{};
+    deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+    std::string output(deflateBound(&stream, data.size()) + 32, '\0');
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef *>(&output[0]);
+    stream.avail_out = static_cast<uInt>(output.size());
+    deflate(&stream, Z_FINISH);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+    return output;
+}
+
+std::string readAll(ByteSource &source, size_t chunkSize = 1000) {
+    std::string output;
+    std::string chunk(chunkSize, '\0');
+    while (size_t count = source.read(&chunk[0], chunk.size())) {
+        output.append(chunk, 0, count);
+    }
+    return output;
+}
+
+// {"a": "xx..."} of exactly size bytes
+std::string documentOfSize(size_t size) {
+    return "{\"a\": \"" + std::string(size - 9, 'x') + "\"}";
+}
+
+std::string largeDocument() {
+    std::string json = "[";
+    for (int i = 0; i < 200000; ++i) {
+        json += std::to_string(i) + ",";
+    }
+    return json + "0]";
+}
+
+}
+
+TEST(DecompressionTest, DetectCompression) {
+    EXPECT_EQ(detectCompression("\x1f\x8b\x08"), Compression::Gzip);
+    EXPECT_EQ(detectCompression("\x28\xb5\x2f\xfd\x00"), Compression::Zstd);
+    EXPECT_EQ(detectCompression("{\"a\": 1}"), Compression::None);
+    EXPECT_EQ(detectCompression("\x1f"), Compression::None);
+    EXPECT_EQ(detectCompression(""), Compression::None);
+}
+
+TEST(DecompressionTest, StreamGzipInBlocks) {
+    // Larger than several blocks, so the background thread has to wait for the reader
+    std::string json = largeDocument();
+    std::string compressed = gzip(json);
+    DecompressingByteSource source(std::make_unique<MemoryByteSource>(compressed), Compression::Gzip);
+    EXPECT_EQ(readAll(source), json);
+}
+
+TEST(DecompressionTest, ConcatenatedGzipMembers) {
+    std::string compressed = gzip("{\"a\": ") + gzip("[1, 2]}");
+    EXPECT_EQ(decompress(compressed, Compression::Gzip), "{\"a\": [1, 2]}");
+}
+
+TEST(DecompressionTest, GzipEndingOnBlockBoundary) {
+    for (size_t size: {DecompressingByteSource::blockSize - 1, DecompressingByteSource::blockSize,
+                       DecompressingByteSource::blockSize + 1, 2 * DecompressingByteSource::blockSize}) {
+        std::string json = documentOfSize(size);
+        ASSERT_EQ(json.size(), size);
+        std::string compressed = gzip(json);
+        DecompressingByteSource source(std::make_unique<MemoryByteSource>(compressed), Compression::Gzip);
+        EXPECT_EQ(readAll(source), json) << size;
+        // The next member starts right after a member that filled its block
+        std::string concatenated = compressed + gzip(" ");
+        DecompressingByteSource members(std::make_unique<MemoryByteSource>(concatenated), Compression::Gzip);
+        EXPECT_EQ(readAll(members), json + " ") << size;
+    }
+}
+
+TEST(DecompressionTest, RejectCorruptAndTruncatedGzip) {
+    std::string compressed = gzip(largeDocument());
+    EXPECT_THROW(decompress(compressed.substr(0, compressed.size() / 2), Compression::Gzip), std::runtime_error);
+    compressed[compressed.size() / 2] ^= 0x55;
+    compressed[compressed.size() / 2 + 1] ^= 0x55;
+    EXPECT_THROW(decompress(compressed, Compression::Gzip), std::runtime_error);
+}
+
+#ifdef JSON_EVAL_WITH_ZSTD
+TEST(DecompressionTest, StreamZstdInBlocks) {
+    std::string json = largeDocument();
+    std::string compressed(ZSTD_compressBound(json.size()), '\0');
+    compressed.resize(ZSTD_compress(&compressed[0], compressed.size(), json.data(), json.size(), 3));
+    DecompressingByteSource source(std::make_unique<MemoryByteSource>(compressed), Compression::Zstd);
+    EXPECT_EQ(readAll(source), json);
+    EXPECT_THROW(decompress(compressed.substr(0, compressed.size() - 5), Compression::Zstd), std::runtime_error);
+}
+
+TEST(DecompressionTest, ZstdEndingOnBlockBoundary) {
+    for (size_t size: {DecompressingByteSource::blockSize - 1, DecompressingByteSource::blockSize,
+                       DecompressingByteSource::blockSize + 1, 2 * DecompressingByteSource::blockSize}) {
+        std::string json = documentOfSize(size);
+        std::string compressed(ZSTD_compressBound(json.size()), '\0');
+        compressed.resize(ZSTD_compress(&compressed[0], compressed.size(), json.data(), json.size(), 3));
+        std::string frames = compressed + compressed;
+        DecompressingByteSource source(std::make_unique<MemoryByteSource>(frames), Compression::Zstd);
+        EXPECT_EQ(readAll(source), json + json) << size;
+    }
+}
+#else
+TEST(DecompressionTest, ZstdNeedsLibzstd) {
+    EXPECT_THROW(decompress("\x28\xb5\x2f\xfd", Compression::Zstd), std::runtime_error);
+}
+#endif
+
+TEST(DecompressionTest, StopReadingEarly) {
+    // Destroying the source before the end must not hang the background thread
+    std::string compressed = gzip(largeDocument());
+    DecompressingByteSource source(std::make_unique<MemoryByteSource>(compressed), Compression::Gzip);
+    char buffer[16];
+    EXPECT_EQ(source.read(buffer, sizeof(buffer)), sizeof(buffer));
+}
+
+TEST(DecompressionTest, OpenGzipFiles) {
+    std::string path = ::testing::TempDir() + "decompression_test.json.gz";
+    std::string json = "{\"a\": {\"b\": [1, 2, 3]}}";
+    std::ofstream(path, std::ios::binary) << gzip(json);
+
+    EXPECT_EQ(JSONInput(path).view(), json);
+    std::unique_ptr<ByteSource> source = openByteSource(path);
+    EXPECT_EQ(readAll(*source, 3), json);
+    std::remove(path.c_str());
+}
+
+TEST(DecompressionTest, OpenPlainFilesUnchanged) {
+    std::string path = ::testing::TempDir() + "decompression_test.json";
+    std::ofstream(path) << "[1]";
+    std::unique_ptr<ByteSource> source = openByteSource(path);
+    EXPECT_EQ(readAll(*source), "[1]");
+    std::remove(path.c_str());
+}
@@ -0,0 +1,119 @@
+#include "expr_bytecode.h"
+#include "expr_evaluator.h"
+#include "expr_parser.h"
+#include "gtest/gtest.h"
+
+// clang-format off
+namespace {
+
+const char *document = "{\"a\": {\"b\": [1, 2, {\"c\": \"test\"}, [11, 12]], \"n\": 2.5, \"s\": \"xyz\"}, \"k\": \"n\"}";
+
+std::string runVM(const std::string &expression, bool onTape) {
+    ExprPtr expr = ExprParser(expression).parse();
+    ExprProgram program = ExprProgram::compile(*expr);
+    ExprVM vm(program);
+    if (onTape) {
+        JSONTape tape = JSONTapeParser(document).parse();
+        return ExprEvaluator::jsonValueToString(vm.run(tape).toJSONValue());
+    }
+    JSONValue root = JSONParser(document).parse();
+    return ExprEvaluator::jsonValueToString(vm.run(root).toJSONValue());
+}
+
+std::string runEvaluator(const std::string &expression) {
+    ExprPtr expr = ExprParser(expression).parse();
+    JSONValue root = JSONParser(document).parse();
+    ExprEvaluator evaluator(root);
+    expr->accept(evaluator);
+    return ExprEvaluator::jsonValueToString(evaluator.result);
+}
+
+}
+
+TEST(ExprBytecodeTest, MatchTreeEvaluator) {
+    for (const char *expression: {"a.b[1]", "a.b[2].c", "a.b", "a.b[a.b[1]].c", "a[k]", "a.b[3][1] - a.n",
+                                  "max(a.b[0], a.b[1], min(a.b[3]))", "size(a.s) * 2 + size(a.b) % 3",
+                                  "average(a.b[3], 1, a.n) / 4", "\"lit\"", "true", "null", "1 + 2 * 3",
+                                  "min(a.b[3]) + max(a.b[3]) + size(a) + a.b[0]", "a.b[*]", "a.b[*][a.b[0]]",
+                                  "a.b[*].c", "max(a.b[*][*]) + size(a.b[*][k])",
+                                  "find(a.b, \"c\", \"test\")", "find(a.b, \"c\", 1)",
+                                  "sum(a.b[3], 1) + count(a.b)", "variance(a.b[3]) - stddev(a.b, 3)",
+                                  "median(a.b[3]) * percentile(a.b, 50)",
+                                  "approx_median(a.b[3]) + approx_percentile(a.b[3], 90)",
+                                  "sum(a.b[*][*], 1) + size(a.b[*][*])", "count(a.b[*].c, a.b[*][a.b[0]])",
+                                  "percentile(a.b[*][a.b[0]], a.b[1] * 10)", "average(a.b[*][*]) * max(a.b[*][*])"}) {
+        std::string expected = runEvaluator(expression);
+        EXPECT_EQ(runVM(expression, false), expected) << expression;
+        EXPECT_EQ(runVM(expression, true), expected) << expression;
+    }
+}
+
+TEST(ExprBytecodeTest, ReportErrorsLikeTreeEvaluator) {
+    for (const char *expression: {"a.missing", "a.b[9]", "a.s.x", "a.b[\"x\"]", "a.s + 1", "a.n / 0", "min()",
+                                  "percentile(a.b, 200)", "median(a.s)", "percentile(a.b[*][*], 200)",
+                                  "sum(a.s[*])"}) {
+        EXPECT_THROW(runVM(expression, false), std::runtime_error) << expression;
+        EXPECT_THROW(runVM(expression, true), std::runtime_error) << expression;
+    }
+    EXPECT_THROW(ExprProgram::compile(*ExprParser("nope(1)").parse()), std::runtime_error);
+}
+
+TEST(ExprBytecodeTest, CompileToRegisters) {
+    ExprProgram program = ExprProgram::compile(*ExprParser("max(a.b[0], 2) + 1").parse());
+    EXPECT_EQ(program.toString(),
+              "r1 = root.a.b\n"
+              "r3 = 0\n"
+              "r1 = r1[r3]\n"
+              "r2 = 2\n"
+              "r0 = max(r1, r2)\n"
+              "r1 = 1\n"
+              "r0 = r0 + r1\n");
+    EXPECT_EQ(program.registerCount(), 4u);
+}
+
+TEST(ExprBytecodeTest, CompileWildcards) {
+    EXPECT_EQ(ExprProgram::compile(*ExprParser("a.b[*].c[0][*]").parse()).toString(),
+              "r0 = root.a.b\n"
+              "r1 = 0\n"
+              "r0 = r0[*].c[r1][*]\n");
+    EXPECT_THROW(runVM("a.s[*]", true), std::runtime_error);
+}
+
+TEST(ExprBytecodeTest, FuseAggregatesOverProjections) {
+    EXPECT_EQ(ExprProgram::compile(*ExprParser("percentile(a.b[*][0], 50) + size(a.b[*].c)").parse()).toString(),
+              "r1 = root.a.b\n"
+              "r3 = 0\n"
+              "r2 = 50\n"
+              "r0 = percentile(r1[*][r3], r2)\n"
+              "r2 = root.a.b\n"
+              "r1 = size(r2[*].c)\n"
+              "r0 = r0 + r1\n");
+    // Other functions take the projected array
+    EXPECT_EQ(ExprProgram::compile(*ExprParser("find(a.b[*], \"c\", 1)").parse()).toString(),
+              "r1 = root.a.b\n"
+              "r1 = r1[*]\n"
+              "r2 = \"c\"\n"
+              "r3 = 1\n"
+              "r0 = find(r1, r2, r3)\n");
+}
+
+TEST(ExprBytecodeTest, CollapseMemberChains) {
+    EXPECT_EQ(ExprProgram::compile(*ExprParser("a.b.c.d").parse()).toString(), "r0 = root.a.b.c.d\n");
+    EXPECT_EQ(ExprProgram::compile(*ExprParser("a.b[0].c.d").parse()).toString(),
+              "r0 = root.a.b\n"
+              "r1 = 0\n"
+              "r0 = r0[r1]\n"
+              "r0 = r0.c.d\n");
+    EXPECT_EQ(runVM("a.b[2].c", false), "test");
+    EXPECT_THROW(runVM("a.b.c", false), std::runtime_error);
+    EXPECT_THROW(runVM("null.c", true), std::runtime_error);
+}
+
+TEST(ExprBytecodeTest, ReuseVMAcrossDocuments) {
+    ExprProgram program = ExprProgram::compile(*ExprParser("size(a) + a[0]").parse());
+    ExprVM vm(program);
+    for (int i = 1; i <= 3; ++i) {
+        JSONValue root = JSONParser("{\"a\": [" + std::to_string(i) + ", 0]}").parse();
+        EXPECT_EQ(vm.run(root).asInteger(), i + 2);
+    }
+}
@@ -0,0 +1,140 @@
+#include "expr_cache.h"
+#include "expr_evaluator.h"
+#include "expr_parser.h"
+#include "json_parser.h"
+#include "json_tape.h"
+#include "gtest/gtest.h"
+
+// clang-format off
+namespace {
+
+std::string key(const std::string &expression) {
+    return ExprCache::structuralKey(*ExprParser(expression).parse());
+}
+
+}
+
+TEST(ExprCacheTest, KeyFollowsStructure) {
+    EXPECT_EQ(key("max(a.b, 1) + x[2]"), key("max(a.b,1)+x[2]"));
+    EXPECT_NE(key("a.b"), key("a[\"b\"]"));
+    EXPECT_NE(key("1"), key("1.0"));
+    EXPECT_NE(key("min(a)"), key("max(a)"));
+    EXPECT_NE(key("a - b"), key("b - a"));
+    EXPECT_NE(key("size(ab)"), key("size(a.b)"));
+    EXPECT_NE(key("\"a,b\""), key("\"a\""));
+}
+
+TEST(ExprCacheTest, KeyOnlySubexpressionsWorthCaching) {
+    ExprPtr expr = ExprParser("max(a.b, 1) + x[2] * (1 + 2)").parse();
+    ExprCacheKeys keys;
+    keys.add(*expr);
+    ASSERT_NE(keys.cacheKey(*expr), nullptr);
+    EXPECT_EQ(*keys.cacheKey(*expr), ExprCache::structuralKey(*expr));
+
+    const auto &sum = dynamic_cast<const BinaryExpr &>(*expr);
+    const auto &product = dynamic_cast<const BinaryExpr &>(*sum.right);
+    ASSERT_NE(keys.cacheKey(*sum.left), nullptr);
+    EXPECT_EQ(*keys.cacheKey(*sum.left), key("max(a.b, 1)"));
+    EXPECT_EQ(keys.structuralKey(product), key("x[2] * (1 + 2)"));
+    // Arithmetic on paths, and literals alone
+    EXPECT_EQ(keys.cacheKey(product), nullptr);
+    EXPECT_EQ(keys.cacheKey(*product.right), nullptr);
+    EXPECT_EQ(keys.cacheKey(*dynamic_cast<const CallExpr &>(*sum.left).arguments[0]), nullptr);
+
+    ExprPtr literal = ExprParser("max(1, 2)").parse();
+    keys.add(*literal);
+    EXPECT_EQ(keys.cacheKey(*literal), nullptr);
+}
+
+TEST(ExprCacheTest, CountHitsAndMisses) {
+    ExprCache cache;
+    EXPECT_FALSE(cache.find("k", 1));
+    cache.insert("k", 1, JSONValue(int64_t{5}));
+    auto found = cache.find("k", 1);
+    ASSERT_TRUE(found);
+    EXPECT_EQ(found->asInteger(), 5);
+
+    ExprCache::Stats stats = cache.stats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.entries, 1u);
+    EXPECT_GT(stats.bytes, 0u);
+}
+
+TEST(ExprCacheTest, SeparateGenerations) {
+    ExprCache cache;
+    cache.insert("k", 1, JSONValue(int64_t{5}));
+    EXPECT_FALSE(cache.find("k", 2));
+    cache.insert("k", 2, JSONValue(int64_t{6}));
+    EXPECT_EQ(cache.find("k", 1)->asInteger(), 5);
+    EXPECT_EQ(cache.find("k", 2)->asInteger(), 6);
+}
+
+TEST(ExprCacheTest, EvictLeastRecentlyUsedOverBudget) {
+    ExprCache probe;
+    probe.insert("k0", 0, JSONValue(int64_t{0}));
+    size_t entryBytes = probe.stats().bytes;
+
+    ExprCache cache(3 * entryBytes);
+    for (int64_t i = 0; i < 3; ++i) {
+        cache.insert("k" + std::to_string(i), 0, JSONValue(i));
+    }
+    EXPECT_TRUE(cache.find("k0", 0));
+    cache.insert("k3", 0, JSONValue(int64_t{3}));
+
+    EXPECT_TRUE(cache.find("k0", 0));
+    EXPECT_FALSE(cache.find("k1", 0));
+    EXPECT_TRUE(cache.find("k2", 0));
+    EXPECT_TRUE(cache.find("k3", 0));
+    EXPECT_EQ(cache.stats().evictions, 1u);
+    EXPECT_EQ(cache.stats().entries, 3u);
+    EXPECT_LE(cache.stats().bytes, 3 * entryBytes);
+
+    cache.insert("big", 0, JSONValue(JSONArray(100, JSONValue(int64_t{1}))));
+    EXPECT_FALSE(cache.find("big", 0));
+    EXPECT_EQ(cache.stats().entries, 3u);
+}
+
+TEST(ExprCacheTest, EvaluatorReusesResults) {
+    const char *document = R"({"a": [3, 1, 2], "b": 10})";
+    JSONValue root = JSONParser(document).parse();
+    JSONTape tape = JSONTapeParser(document).parse();
+    ExprCache cache;
+
+    ExprPtr first = ExprParser("max(a) + b").parse();
+    ExprEvaluator evaluator(root);
+    evaluator.setCache(&cache, 1);
+    first->accept(evaluator);
+    EXPECT_EQ(evaluator.result.asInteger(), 13);
+    EXPECT_EQ(cache.stats().hits, 0u);
+    EXPECT_EQ(cache.stats().entries, 2u);
+
+    ExprPtr second = ExprParser("max(a) * 2").parse();
+    ExprEvaluator tapeEvaluator(tape);
+    tapeEvaluator.setCache(&cache, 1);
+    second->accept(tapeEvaluator);
+    EXPECT_EQ(tapeEvaluator.result.asInteger(), 6);
+    EXPECT_EQ(cache.stats().hits, 1u);
+
+    ExprEvaluator again(root);
+    again.setCache(&cache, 1);
+    first->accept(again);
+    EXPECT_EQ(again.result.asInteger(), 13);
+    EXPECT_EQ(cache.stats().hits, 2u);
+
+    ExprPtr failing = ExprParser("max(a) + missing").parse();
+    ExprEvaluator failingEvaluator(root);
+    failingEvaluator.setCache(&cache, 1);
+    EXPECT_THROW(failing->accept(failingEvaluator), std::runtime_error);
+    EXPECT_EQ(cache.stats().entries, 3u);
+
+    // Cheaper to compute than to look up
+    size_t lookups = cache.stats().hits + cache.stats().misses;
+    ExprPtr trivial = ExprParser("a[0] + b * 2").parse();
+    ExprEvaluator trivialEvaluator(root);
+    trivialEvaluator.setCache(&cache, 1);
+    trivial->accept(trivialEvaluator);
+    EXPECT_EQ(trivialEvaluator.result.asInteger(), 23);
+    EXPECT_EQ(cache.stats().hits + cache.stats().misses, lookups);
+    EXPECT_EQ(cache.stats().entries, 3u);
+}
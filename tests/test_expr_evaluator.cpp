@@ -1,7 +1,10 @@
 #include "expr_evaluator.h"
 #include "json_parser.h"
 #include "expr_parser.h"
+#include "json_tape.h"
 #include "gtest/gtest.h"
+#include <atomic>
+#include <cmath>
 
 // clang-format off
 class ExprEvaluatorTest : public ::testing::Test {
@@ -140,6 +143,193 @@ TEST_F(ExprEvaluatorTest, EvaluateNumberLiteral) {
     EXPECT_EQ(evaluator.result.asNumber(), 15);
 }
 
+TEST_F(ExprEvaluatorTest, EvaluateIntegerArithmeticExactly) {
+    JSONValue root = JSONParser("{\"big\": 9007199254740993, \"half\": 2.5, \"list\": [1, 2]}").parse();
+    auto evaluate = [&root](const std::string &expression) {
+        ExprParser parser(expression);
+        ExprPtr expr = parser.parse();
+        ExprEvaluator evaluator(root);
+        expr->accept(evaluator);
+        return evaluator.result;
+    };
+    EXPECT_EQ(evaluate("big + 1").asInteger(), 9007199254740994);
+    EXPECT_EQ(evaluate("big * 2 - big").asInteger(), 9007199254740993);
+    EXPECT_EQ(evaluate("big % 10").asInteger(), 3);
+    EXPECT_EQ(evaluate("-7 % 3").asInteger(), -1);
+    EXPECT_EQ(evaluate("max(big, 1)").asInteger(), 9007199254740993);
+    EXPECT_TRUE(evaluate("size(list)").isInteger());
+    EXPECT_EQ(ExprEvaluator::jsonValueToString(evaluate("big")), "9007199254740993");
+
+    // Inexact division, overflow and mixed operands fall back to doubles
+    EXPECT_EQ(evaluate("7 / 2").asNumber(), 3.5);
+    EXPECT_EQ(evaluate("8 / 2").asInteger(), 4);
+    EXPECT_FALSE(evaluate("big * big").isInteger());
+    EXPECT_EQ(evaluate("half + 1").asNumber(), 3.5);
+    EXPECT_FALSE(evaluate("max(half, 1)").isInteger());
+}
+
+TEST_F(ExprEvaluatorTest, PrintIntegerOverflowAsDouble) {
+    JSONValue root = JSONParser("{\"m\": 9223372036854775807, \"n\": -9223372036854775808}").parse();
+    auto evaluate = [&root](const std::string &expression) {
+        ExprPtr expr = ExprParser(expression).parse();
+        ExprEvaluator evaluator(root);
+        expr->accept(evaluator);
+        return ExprEvaluator::jsonValueToString(evaluator.result);
+    };
+    EXPECT_EQ(evaluate("m"), "9223372036854775807");
+    EXPECT_EQ(evaluate("n"), "-9223372036854775808");
+    EXPECT_EQ(evaluate("m + 1"), "9.22337e+18");
+    EXPECT_EQ(evaluate("m * 2"), "1.84467e+19");
+    EXPECT_EQ(evaluate("n - 1"), "-9.22337e+18");
+    EXPECT_EQ(evaluate("n / -1"), "9.22337e+18");
+    EXPECT_EQ(evaluate("sum(m, m)"), "1.84467e+19");
+    EXPECT_EQ(evaluate("m + 1 - 1"), "9.22337e+18");
+    // Back in range, a whole double prints as an integer again
+    EXPECT_EQ(evaluate("(m + 1) / 2"), "4611686018427387904");
+    EXPECT_EQ(ExprEvaluator::jsonValueToString(JSONValue(-0x1p62)), "-4611686018427387904");
+    EXPECT_EQ(ExprEvaluator::jsonValueToString(JSONValue(HUGE_VAL)), "inf");
+    EXPECT_EQ(ExprEvaluator::jsonValueToString(JSONValue(-HUGE_VAL)), "-inf");
+}
+
+TEST_F(ExprEvaluatorTest, EvaluateWildcardProjection) {
+    const char *document = R"({"items": [{"price": 3, "tags": [1, 2]}, {"price": 2.5, "tags": []}, {"name": "x"},
+                               {"price": "7", "tags": [5]}], "k": "price", "n": 0})";
+    JSONValue root = JSONParser(document).parse();
+    JSONTape tape = JSONTapeParser(document).parse();
+    auto evaluate = [&](const std::string &expression) {
+        ExprPtr expr = ExprParser(expression).parse();
+        ExprEvaluator evaluator(root);
+        expr->accept(evaluator);
+        ExprEvaluator tapeEvaluator(tape);
+        expr->accept(tapeEvaluator);
+        std::string result = ExprEvaluator::jsonValueToString(evaluator.result);
+        EXPECT_EQ(ExprEvaluator::jsonValueToString(tapeEvaluator.result), result) << expression;
+        return result;
+    };
+    EXPECT_EQ(evaluate("items[*].price"), "[ 3, 2.5, 7 ]");
+    EXPECT_EQ(evaluate("items[*][k]"), "[ 3, 2.5, 7 ]");
+    EXPECT_EQ(evaluate("items[*].tags[*]"), "[ 1, 2, 5 ]");
+    EXPECT_EQ(evaluate("items[*].tags[n]"), "[ 1, 5 ]");
+    EXPECT_EQ(evaluate("size(items[*])"), "4");
+    // Aggregates take the numbers among the projected values, like they take them from an array
+    EXPECT_EQ(evaluate("min(items[*].price)"), "2.5");
+    EXPECT_EQ(evaluate("max(items[*].price, 10) + size(items[*].price)"), "13");
+    EXPECT_EQ(evaluate("average(items[*].tags[*], items[*].price)"), "2.7");
+    EXPECT_THROW(evaluate("average(items[*].name)"), std::runtime_error);
+    EXPECT_THROW(evaluate("k[*]"), std::runtime_error);
+    EXPECT_THROW(evaluate("size(k[*].price)"), std::runtime_error);
+}
+
+TEST_F(ExprEvaluatorTest, EvaluateWildcardOverLargeArrays) {
+    // Enough elements for parallel chunks when the shared pool has more than one thread
+    std::string document = "{\"items\": [";
+    for (size_t i = 0; i < 2 * parallelSummaryThreshold / 3; ++i) {
+        document += (i == 0 ? "{" : ",{") + (i % 7 == 0 ? std::string() : "\"p\": " + std::to_string(i % 1000) + ",") +
+                    "\"q\": [" + std::to_string(i) + "]}";
+    }
+    document += "]}";
+    JSONTape tape = JSONTapeParser(document).parse();
+    JSONValue root = tape.root().toJSONValue();
+    for (const char *expression: {"min(items[*].p)", "max(items[*].q[*])", "average(items[*].p)", "size(items[*].p)",
+                                  "sum(items[*].q[*])", "variance(items[*].p)", "median(items[*].p)"}) {
+        // The fused aggregate against the same aggregate over the projected array
+        ExprPtr fused = ExprParser(expression).parse();
+        ExprEvaluator evaluator(root);
+        fused->accept(evaluator);
+        ExprEvaluator tapeEvaluator(tape);
+        fused->accept(tapeEvaluator);
+
+        std::string callee(expression, std::string(expression).find('('));
+        std::string argument(std::string(expression).substr(callee.size() + 1));
+        argument.pop_back();
+        ExprPtr projection = ExprParser(argument).parse();
+        ExprEvaluator projector(root);
+        projection->accept(projector);
+        JSONValueRef projected = JSONValueRef::to(projector.result);
+        JSONValue expected = findBuiltinFunction(callee)(&projected, 1);
+        EXPECT_EQ(ExprEvaluator::jsonValueToString(evaluator.result), ExprEvaluator::jsonValueToString(expected));
+        EXPECT_EQ(ExprEvaluator::jsonValueToString(tapeEvaluator.result), ExprEvaluator::jsonValueToString(expected));
+    }
+}
+
+TEST_F(ExprEvaluatorTest, EvaluateStatistics) {
+    const char *document = R"({"xs": [4, 1, 3, 2, "x"], "ys": [2, 4, 4, 4, 5, 5, 7, 9], "half": 0.5,
+                               "items": [{"ms": 10}, {"ms": 30}, {}, {"ms": 20}], "p": 50})";
+    JSONValue root = JSONParser(document).parse();
+    JSONTape tape = JSONTapeParser(document).parse();
+    auto evaluate = [&](const std::string &expression) {
+        ExprPtr expr = ExprParser(expression).parse();
+        ExprEvaluator evaluator(root);
+        expr->accept(evaluator);
+        ExprEvaluator tapeEvaluator(tape);
+        expr->accept(tapeEvaluator);
+        std::string result = ExprEvaluator::jsonValueToString(evaluator.result);
+        EXPECT_EQ(ExprEvaluator::jsonValueToString(tapeEvaluator.result), result) << expression;
+        return result;
+    };
+    EXPECT_EQ(evaluate("sum(xs, 5)"), "15");
+    EXPECT_EQ(evaluate("sum(xs, half)"), "10.5");
+    EXPECT_EQ(evaluate("count(xs, ys)"), "12");
+    EXPECT_EQ(evaluate("count(items)"), "0");
+    EXPECT_EQ(evaluate("variance(ys)"), "4");
+    EXPECT_EQ(evaluate("stddev(ys)"), "2");
+    EXPECT_EQ(evaluate("median(xs)"), "2.5");
+    EXPECT_EQ(evaluate("median(xs, 10)"), "3");
+    EXPECT_EQ(evaluate("percentile(xs, 25)"), "1.75");
+    EXPECT_EQ(evaluate("percentile(ys, 100)"), "9");
+    // Few numbers are estimated exactly
+    EXPECT_EQ(evaluate("approx_median(xs)"), "2.5");
+    EXPECT_EQ(evaluate("approx_percentile(ys, p)"), "4.5");
+    // Fused with projections
+    EXPECT_EQ(evaluate("sum(items[*].ms)"), "60");
+    EXPECT_EQ(evaluate("percentile(items[*].ms, p)"), "20");
+    EXPECT_EQ(evaluate("stddev(items[*].ms, 20)"), "7.07107");
+
+    for (const char *expression: {"sum()", "median(xs[4])", "variance(items)", "median(items)",
+                                  "approx_median(items)", "percentile(xs)", "percentile(xs, 101)",
+                                  "percentile(xs, xs)", "percentile(items[*].ms, -1)", "percentile(xs, 5, 5)"}) {
+        EXPECT_THROW(evaluate(expression), std::runtime_error) << expression;
+    }
+}
+
+// Call that counts how often an ExprEvaluator visits it
+class CountedCallExpr : public CallExpr {
+public:
+    CountedCallExpr(std::string callee, std::vector<ExprPtr> arguments, std::atomic<int> &visits)
+            : CallExpr(std::move(callee), std::move(arguments)), visits(visits) {}
+
+    void accept(ExprVisitor &visitor) const override {
+        if (dynamic_cast<ExprEvaluator *>(&visitor) != nullptr) {
+            ++visits;
+        }
+        CallExpr::accept(visitor);
+    }
+
+private:
+    std::atomic<int> &visits;
+};
+
+TEST_F(ExprEvaluatorTest, EvaluateSharedNodesOnceAcrossThreads) {
+    std::atomic<int> visits{0};
+    auto path = std::make_shared<MemberExpr>(std::make_shared<IdentifierExpr>("a"), "b");
+    auto size = std::make_shared<CountedCallExpr>("size", std::vector<ExprPtr>{path}, visits);
+    size->shared = true;
+    // sum(size(a.b) + 1, size(a.b) + 2, size(a.b) + 3), where the first two operands go to the pool
+    std::vector<ExprPtr> operands;
+    for (int64_t i = 1; i <= 3; ++i) {
+        operands.push_back(std::make_shared<BinaryExpr>(size, BinaryExpr::Operator::Add,
+                                                        std::make_shared<NumberExpr>(static_cast<double>(i), i)));
+    }
+    CallExpr sum("sum", operands);
+
+    ThreadPool pool(4);
+    ExprEvaluator evaluator(jsonRoot);
+    evaluator.setThreadPool(pool);
+    sum.accept(evaluator);
+    EXPECT_EQ(ExprEvaluator::jsonValueToString(evaluator.result), "18");
+    EXPECT_EQ(visits, 1);
+}
+
 TEST_F(ExprEvaluatorTest, EvaluateInvalidMemberAccess) {
     ExprParser parser("a.x");
     ExprPtr expr = parser.parse();
@@ -0,0 +1,86 @@
+#include "expr_optimizer.h"
+#include "expr_bytecode.h"
+#include "expr_evaluator.h"
+#include "expr_parser.h"
+#include "stream_evaluator.h"
+#include "byte_source.h"
+#include "gtest/gtest.h"
+
+// clang-format off
+namespace {
+
+const char *document = "{\"a\": {\"b\": [1, 2, {\"c\": \"test\"}, [11, 12]], \"s\": \"xyz\"}}";
+
+std::string explain(const std::string &expression) {
+    return ExprOptimizer::explain(*ExprOptimizer::optimize(*ExprParser(expression).parse()));
+}
+
+std::string evaluate(const Expr &expr) {
+    JSONValue root = JSONParser(document).parse();
+    ExprEvaluator evaluator(root);
+    expr.accept(evaluator);
+    return ExprEvaluator::jsonValueToString(evaluator.result);
+}
+
+}
+
+TEST(ExprOptimizerTest, FoldConstants) {
+    EXPECT_EQ(explain("2 * 60 * 60"), "7200\n");
+    EXPECT_EQ(explain("a.b[1 + 1] * (10 / 4)"), "a.b[2] * 2.5\n");
+    EXPECT_EQ(explain("max(1, 2, 3) + size(\"abc\") + min(a.b[3])"), "6 + min(a.b[3])\n");
+}
+
+TEST(ExprOptimizerTest, KeepFailingConstants) {
+    EXPECT_EQ(explain("1 / 0"), "1 / 0\n");
+    EXPECT_EQ(explain("size(1)"), "size(1)\n");
+    EXPECT_EQ(explain("unknown(1)"), "unknown(1)\n");
+}
+
+TEST(ExprOptimizerTest, ShareRepeatedSubexpressions) {
+    EXPECT_EQ(explain("max(a.b[0], a.b[1]) + size(a.b) - min(a.b[3])"),
+              "$1 = a.b\n"
+              "(max($1[0], $1[1]) + size($1)) - min($1[3])\n");
+    EXPECT_EQ(explain("size(a.b) * size(a.b) + a.b[0]"),
+              "$1 = a.b\n"
+              "$2 = size($1)\n"
+              "($2 * $2) + $1[0]\n");
+}
+
+TEST(ExprOptimizerTest, ShareWildcards) {
+    EXPECT_EQ(explain("min(a.b[*][1 + 0]) + size(a.b[*][1])"),
+              "$1 = a.b[*][1]\n"
+              "min($1) + size($1)\n");
+}
+
+TEST(ExprOptimizerTest, EvaluateOptimizedLikeOriginal) {
+    for (const char *expression: {"max(a.b[0], a.b[1]) + size(a.b) - min(a.b[3])", "a.b[a.b[1]].c",
+                                  "size(a.b) * size(a.b) + a.b[3][1] * (2 - 1)", "a.s", "size(a.s) + size(a.s)"}) {
+        ExprPtr original = ExprParser(expression).parse();
+        ExprPtr optimized = ExprOptimizer::optimize(*original);
+        std::string expected = evaluate(*original);
+        EXPECT_EQ(evaluate(*optimized), expected) << expression;
+
+        ExprProgram program = ExprProgram::compile(*optimized);
+        ExprVM vm(program);
+        JSONValue root = JSONParser(document).parse();
+        EXPECT_EQ(ExprEvaluator::jsonValueToString(vm.run(root).toJSONValue()), expected) << expression;
+
+        StreamEvaluator streamEvaluator(*optimized);
+        MemoryByteSource source(document);
+        streamEvaluator.read(source);
+        EXPECT_EQ(ExprEvaluator::jsonValueToString(streamEvaluator.evaluate()), expected) << expression;
+    }
+}
+
+TEST(ExprOptimizerTest, CompileSharedNodesOnce) {
+    ExprPtr optimized = ExprOptimizer::optimize(*ExprParser("a.b[0] + a.b[1]").parse());
+    EXPECT_EQ(ExprProgram::compile(*optimized).toString(),
+              "r1 = root.a.b\n"
+              "r0 = r1\n"
+              "r2 = 0\n"
+              "r0 = r0[r2]\n"
+              "r2 = r1\n"
+              "r3 = 1\n"
+              "r2 = r2[r3]\n"
+              "r0 = r0 + r2\n");
+}
@@ -29,6 +29,15 @@ EXPECT_NE(strExpr, nullptr);
 EXPECT_EQ(strExpr->value, "test");
 }
 
+TEST(ExprParserTest, ParseUnicodeEscapes) {
+    ExprPtr expr = ExprParser(R"("caf\u00e9 \ud83d\ude00")").parse();
+    auto stringExpr = std::dynamic_pointer_cast<StringExpr>(expr);
+    ASSERT_NE(stringExpr, nullptr);
+    EXPECT_EQ(stringExpr->value, "caf\xc3\xa9 \xf0\x9f\x98\x80");
+    EXPECT_THROW(ExprParser(R"("\ude00")").parse(), std::runtime_error);
+    EXPECT_THROW(ExprParser("\"\xff\"").parse(), std::runtime_error);
+}
+
 TEST(ExprParserTest, ParseMemberExpression) {
 ExprParser parser("a.b");
 ExprPtr expr = parser.parse();
@@ -74,6 +83,25 @@ EXPECT_NE(binExpr, nullptr);
 EXPECT_EQ(binExpr->op, BinaryExpr::Operator::Add);
 }
 
+TEST(ExprParserTest, ParseWildcardExpression) {
+ExprParser parser("a.items[ * ].tags[*][0].name");
+ExprPtr expr = parser.parse();
+auto wildcard = std::dynamic_pointer_cast<WildcardExpr>(expr);
+ASSERT_NE(wildcard, nullptr);
+EXPECT_NE(std::dynamic_pointer_cast<MemberExpr>(wildcard->array), nullptr);
+ASSERT_EQ(wildcard->steps.size(), 4u);
+EXPECT_EQ(wildcard->steps[0].kind, WildcardExpr::Step::Kind::Member);
+EXPECT_EQ(wildcard->steps[0].member, "tags");
+EXPECT_EQ(wildcard->steps[1].kind, WildcardExpr::Step::Kind::Each);
+EXPECT_EQ(wildcard->steps[2].kind, WildcardExpr::Step::Kind::Index);
+EXPECT_NE(std::dynamic_pointer_cast<NumberExpr>(wildcard->steps[2].index), nullptr);
+EXPECT_EQ(wildcard->steps[3].member, "name");
+
+EXPECT_NE(std::dynamic_pointer_cast<BinaryExpr>(ExprParser("min(a[*].b) * 2").parse()), nullptr);
+EXPECT_THROW(ExprParser("a[*.b]").parse(), std::runtime_error);
+EXPECT_THROW(ExprParser("a[*").parse(), std::runtime_error);
+}
+
 TEST(ExprParserTest, InvalidExpression) {
 ExprParser parser("a + ");
 EXPECT_THROW(parser.parse(), std::runtime_error);
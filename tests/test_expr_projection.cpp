@@ -0,0 +1,88 @@
+#include "expr_projection.h"
+#include "expr_parser.h"
+#include "expr_evaluator.h"
+#include "json_parser.h"
+#include "gtest/gtest.h"
+
+// clang-format off
+namespace {
+
+ProjectionNode collect(const std::string &expression) {
+    ExprParser parser(expression);
+    return ProjectionCollector::collect(*parser.parse());
+}
+
+const std::string jsonContent = R"({
+  "a": {
+    "b": [1, 2, {"c": "test", "d": [5, 6]}, [11, 12]],
+    "skipped": {"deep": [[[{"x": "]}"}]]]}
+  },
+  "other": [1, 2, 3]
+})";
+
+JSONValue evaluate(const JSONValue &root, const std::string &expression) {
+    ExprParser parser(expression);
+    ExprPtr expr = parser.parse();
+    ExprEvaluator evaluator(root);
+    expr->accept(evaluator);
+    return evaluator.result;
+}
+
+} // namespace
+
+TEST(ProjectionCollectorTest, CollectsStaticPaths) {
+    ProjectionNode root = collect("a.b[1] + size(a.b[2].c)");
+    EXPECT_FALSE(root.whole);
+    ASSERT_EQ(root.members.size(), 1);
+    const auto &b = *root.members.at("a")->members.at("b");
+    EXPECT_FALSE(b.whole);
+    EXPECT_TRUE(b.elements.at(1)->whole);
+    EXPECT_TRUE(b.elements.at(2)->members.at("c")->whole);
+}
+
+TEST(ProjectionCollectorTest, DynamicSubscriptKeepsContainer) {
+    ProjectionNode root = collect("a.b[a.b[1]].c");
+    const auto &b = *root.members.at("a")->members.at("b");
+    EXPECT_TRUE(b.whole);
+}
+
+TEST(ProjectionCollectorTest, WildcardKeepsArray) {
+    ProjectionNode root = collect("max(a.b[*].c[k])");
+    EXPECT_TRUE(root.members.at("a")->members.at("b")->whole);
+    EXPECT_TRUE(root.members.at("k")->whole);
+}
+
+TEST(ProjectionCollectorTest, LiteralsAreNotPaths) {
+    ProjectionNode root = collect("max(1, true, \"s\")");
+    EXPECT_TRUE(root.members.empty());
+}
+
+TEST(ProjectionParserTest, BuildsOnlyProjectedSubtrees) {
+    ProjectionNode projection = collect("a.b[2].c");
+    JSONValue root = JSONParser(jsonContent, &projection).parse();
+    EXPECT_EQ(root.asObject().size(), 1);
+    const auto &a = root.asObject().at("a").asObject();
+    EXPECT_EQ(a.count("skipped"), 0);
+    const auto &b = a.at("b").asArray();
+    EXPECT_EQ(b.size(), 3);
+    EXPECT_TRUE(b[0].isNull());
+    EXPECT_EQ(b[2].asObject().size(), 1);
+}
+
+TEST(ProjectionParserTest, MatchesFullParse) {
+    JSONValue full = JSONParser(jsonContent).parse();
+    for (const std::string expression: {"a.b[1]", "a.b[a.b[1]].c", "min(a.b[3]) + size(a.b)",
+                                        "a.b[2].d[1] * other[2]", "size(a)", "a.b[3]"}) {
+        ProjectionNode projection = collect(expression);
+        JSONValue projected = JSONParser(jsonContent, &projection).parse();
+        ExprEvaluator evaluator(full);
+        EXPECT_EQ(evaluator.jsonValueToString(evaluate(projected, expression)),
+                  evaluator.jsonValueToString(evaluate(full, expression))) << expression;
+    }
+}
+
+TEST(ProjectionParserTest, ReportsErrorsInSkippedContainers) {
+    ProjectionNode projection = collect("a");
+    EXPECT_THROW(JSONParser(R"({"a": 1, "b": [1, 2)", &projection).parse(), std::runtime_error);
+    EXPECT_THROW(JSONParser(R"({"a": 1, "b": })", &projection).parse(), std::runtime_error);
+}
@@ -0,0 +1,46 @@
+#include "json_input.h"
+#include "json_parser.h"
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <fstream>
+
+// clang-format off
+class JSONInputTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path = ::testing::TempDir() + "json_input_test.json";
+        std::ofstream out(path);
+        out << "{\"a\": [1, 2, 3]}";
+    }
+
+    void TearDown() override {
+        std::remove(path.c_str());
+    }
+
+    std::string path;
+};
+
+TEST_F(JSONInputTest, MapsRegularFile) {
+    JSONInput input(path);
+    EXPECT_TRUE(input.isMapped());
+    EXPECT_EQ(input.view(), "{\"a\": [1, 2, 3]}");
+}
+
+TEST_F(JSONInputTest, ParsesFromMappedView) {
+    JSONInput input(path);
+    JSONParser parser(input.view());
+    JSONValue value = parser.parse();
+    EXPECT_TRUE(value.isObject());
+    EXPECT_EQ(value.asObject().at("a").asArray().size(), 3);
+}
+
+TEST_F(JSONInputTest, EmptyFileFallsBackToBuffer) {
+    std::ofstream(path, std::ios::trunc).close();
+    JSONInput input(path);
+    EXPECT_FALSE(input.isMapped());
+    EXPECT_TRUE(input.view().empty());
+}
+
+TEST_F(JSONInputTest, MissingFile) {
+    EXPECT_THROW(JSONInput("/nonexistent/file.json"), std::runtime_error);
+}
@@ -0,0 +1,177 @@
+#include "json_numeric.h"
+#include "json_tape.h"
+#include "json_value_ref.h"
+#include "gtest/gtest.h"
+#include <mutex>
+#include <random>
+
+// clang-format off
+namespace {
+
+// Array of numbers with runs of doubles, of integers and of both, broken up by other values
+std::string mixedArray(size_t count) {
+    std::mt19937_64 random(42);
+    std::string json = "[";
+    for (size_t i = 0; i < count; ++i) {
+        if (i != 0) {
+            json += ", ";
+        }
+        size_t kind = (i / 37) % 4;
+        if (kind == 0 || (kind == 2 && random() % 2 == 0)) {
+            json += std::to_string(static_cast<int64_t>(random() % 2000001) - 1000000);
+        } else if (kind == 3 && i % 11 == 0) {
+            json += i % 2 == 0 ? "\"skip\"" : "[1, {\"x\": 2}]";
+        } else {
+            json += std::to_string(static_cast<double>(random() % 2000001) / 7.0 - 140000.0);
+        }
+    }
+    return json + "]";
+}
+
+NumericSummary summarizeRoot(const JSONTape &tape, NumericKernel kernel) {
+    NumericSummary summary;
+    const uint64_t *words = tape.wordData();
+    size_t end = tape.payload(0);
+    for (size_t i = 1; i < end;) {
+        i += summarizeNumberRun(words + i, end - i, summary, kernel);
+        if (i < end) {
+            i = tape.skip(i);
+        }
+    }
+    return summary;
+}
+
+}
+
+TEST(JSONNumericTest, KernelsMatchTreeSummary) {
+    for (size_t count: {0, 1, 3, 4, 7, 8, 9, 17, 1000}) {
+        std::string json = mixedArray(count);
+        JSONValue tree = JSONParser(json).parse();
+        JSONTape tape = JSONTapeParser(json).parse();
+        NumericSummary expected;
+        JSONValueRef::to(tree).summarizeNumbers(expected);
+        for (NumericKernel kernel: {NumericKernel::Scalar, NumericKernel::AVX2, NumericKernel::AVX512}) {
+            if (!isNumericKernelSupported(kernel)) {
+                continue;
+            }
+            NumericSummary summary = summarizeRoot(tape, kernel);
+            SCOPED_TRACE(std::string(numericKernelName(kernel)) + " " + std::to_string(count));
+            EXPECT_EQ(summary.doubles, expected.doubles);
+            EXPECT_EQ(summary.integers, expected.integers);
+            EXPECT_EQ(summary.min(0).asNumber(), expected.min(0).asNumber());
+            EXPECT_EQ(summary.max(0).asNumber(), expected.max(0).asNumber());
+            EXPECT_EQ(summary.min(0).isInteger(), expected.min(0).isInteger());
+            EXPECT_NEAR(summary.total(), expected.total(), 1e-6);
+        }
+    }
+}
+
+TEST(JSONNumericTest, RunStopsAtFirstNonNumber) {
+    JSONTape tape = JSONTapeParser("[1, 2.5, 3, 4, 5, 6, 7, 8, 9, 10, \"x\", 11]").parse();
+    for (NumericKernel kernel: {NumericKernel::Scalar, NumericKernel::AVX2, NumericKernel::AVX512}) {
+        NumericSummary summary;
+        EXPECT_EQ(summarizeNumberRun(tape.wordData() + 1, tape.payload(0) - 1, summary, kernel), 20u);
+        EXPECT_EQ(summary.count(), 10u);
+        EXPECT_EQ(summary.total(), 55.5);
+        EXPECT_EQ(summary.max(0).asNumber(), 10.0);
+    }
+}
+
+TEST(JSONNumericTest, IntegersStayExact) {
+    NumericSummary summary;
+    summary.addInteger(9007199254740993);
+    summary.addInteger(9007199254740995);
+    EXPECT_EQ(summary.min(0).asInteger(), 9007199254740993);
+    EXPECT_EQ(summary.max(0).asInteger(), 9007199254740995);
+    summary.addDouble(0.5);
+    EXPECT_FALSE(summary.min(0).isInteger());
+    EXPECT_EQ(summary.min(0).asNumber(), 0.5);
+    EXPECT_EQ(NumericSummary().min(7).asNumber(), 7.0);
+}
+
+TEST(JSONNumericTest, SumIsCompensated) {
+    NumericSummary summary;
+    summary.addDouble(1e16);
+    for (int i = 0; i < 1000; ++i) {
+        summary.addDouble(1.0);
+    }
+    summary.addDouble(-1e16);
+    EXPECT_EQ(summary.total(), 1000.0);
+
+    std::string json = "[1e16";
+    for (int i = 0; i < 1000; ++i) {
+        json += ", 1.0";
+    }
+    json += ", -1e16]";
+    JSONTape tape = JSONTapeParser(json).parse();
+    NumericSummary vectorized;
+    tape.root().summarizeNumbers(vectorized);
+    EXPECT_EQ(vectorized.total(), 1000.0);
+}
+
+TEST(JSONNumericTest, ChunksMergeToSerialSummary) {
+    ThreadPool pool(4);
+    std::string json = "[";
+    for (size_t i = 0; i < 300000; ++i) {
+        json += (i == 0 ? "" : ",") + (i % 3 == 0 ? std::to_string(i) : std::to_string(i) + ".25");
+    }
+    json += "]";
+    JSONTape tape = JSONTapeParser(json).parse();
+    NumericSummary serial = summarizeRoot(tape, bestNumericKernel());
+    const uint64_t *words = tape.wordData();
+    size_t chunks = 0;
+    std::mutex mutex;
+    auto chunked = summarizeChunks(tape.payload(0) - 1, 2, [&](size_t begin, size_t end, NumericSummary &partial) {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++chunks;
+        return summarizeNumberRun(words + 1 + begin, end - begin, partial) == end - begin;
+    }, pool);
+    ASSERT_TRUE(chunked);
+    EXPECT_GT(chunks, 1u);
+    EXPECT_EQ(chunked->count(), serial.count());
+    EXPECT_EQ(chunked->min(0).asNumber(), 0.0);
+    EXPECT_EQ(chunked->max(0).asNumber(), 299999.25);
+    EXPECT_NEAR(chunked->total(), serial.total(), 1e-3);
+
+    ThreadPool single(1);
+    EXPECT_FALSE(summarizeChunks(1000000, 1, [](size_t, size_t, NumericSummary &) { return true; }, single));
+}
+
+TEST(JSONNumericTest, ReduceChunksInOrder) {
+    struct Positions {
+        std::vector<size_t> values;
+
+        void merge(Positions &&other) { values.insert(values.end(), other.values.begin(), other.values.end()); }
+    };
+    ThreadPool pool(4);
+    auto reduced = reduceChunks<Positions>(300000, 1, [](size_t begin, size_t end, Positions &partial) {
+        for (size_t i = begin; i < end; ++i) {
+            partial.values.push_back(i);
+        }
+        return true;
+    }, pool);
+    ASSERT_TRUE(reduced);
+    ASSERT_EQ(reduced->values.size(), 300000u);
+    for (size_t i = 0; i < reduced->values.size(); ++i) {
+        ASSERT_EQ(reduced->values[i], i);
+    }
+}
+
+TEST(JSONNumericTest, LargeArraysMatchOnTreeAndTape) {
+    // Two words per element on average without being all numbers, so parallel chunks have to be given up
+    std::string json = "[";
+    for (size_t i = 0; i < parallelSummaryThreshold; ++i) {
+        json += i == 0 ? "" : ",";
+        json += i % 4 == 0 ? "[[]]" : i % 4 == 3 ? std::to_string(i % 1000) : "\"s\"";
+    }
+    json += "]";
+    JSONValue tree = JSONParser(json).parse();
+    JSONTape tape = JSONTapeParser(json).parse();
+    NumericSummary fromTree;
+    NumericSummary fromTape;
+    JSONValueRef::to(tree).summarizeNumbers(fromTree);
+    tape.root().summarizeNumbers(fromTape);
+    EXPECT_EQ(fromTape.integers, fromTree.integers);
+    EXPECT_EQ(fromTape.total(), fromTree.total());
+    EXPECT_EQ(fromTape.max(0).asInteger(), 999);
+}
@@ -0,0 +1,108 @@
+#include "json_parallel_parser.h"
+#include "expr_parser.h"
+#include "expr_projection.h"
+#include "expr_evaluator.h"
+#include "gtest/gtest.h"
+#include <random>
+
+// clang-format off
+namespace {
+
+std::string randomDocument(unsigned seed) {
+    std::mt19937 rng(seed);
+    std::string json = "{\"meta\": {\"v\": 1}, \"a\": {\"samples\": [";
+    for (int i = 0; i < 2000; ++i) {
+        json += (i > 0 ? ", " : "") + std::to_string(rng() % 1000) + "." + std::to_string(rng() % 10);
+    }
+    json += "], \"items\": [";
+    for (int i = 0; i < 500; ++i) {
+        json += (i > 0 ? "," : "") + std::string("\n  {\"id\": ") + std::to_string(i) +
+                ", \"name\": \"n,]\\\"}" + std::to_string(rng() % 50) + "\", \"tags\": [true, null, {}]}";
+    }
+    json += "]}, \"dup\": 1, \"tail\": [[1, 2], [3, [4, 5]]], \"dup\": 2}";
+    return json;
+}
+
+std::string toString(const JSONValue &value) {
+    return ExprEvaluator::jsonValueToString(value);
+}
+
+JSONValue parseParallel(const std::string &json, const ProjectionNode *projection = nullptr) {
+    ParallelJSONParser parser(json, projection, 4);
+    parser.setMinParallelBytes(64);
+    return parser.parse();
+}
+
+JSONValue evaluate(const JSONValue &root, const std::string &expression) {
+    ExprParser parser(expression);
+    ExprPtr expr = parser.parse();
+    ExprEvaluator evaluator(root);
+    expr->accept(evaluator);
+    return evaluator.result;
+}
+
+}
+
+TEST(ParallelJSONParserTest, MatchesSequentialParse) {
+    for (unsigned seed = 0; seed < 4; ++seed) {
+        std::string json = randomDocument(seed);
+        JSONValue sequential = JSONParser(json).parse();
+        JSONValue parallel = parseParallel(json);
+        for (const std::string expression : {"meta", "a.samples", "a.items", "dup", "tail", "size(a.items)"}) {
+            EXPECT_EQ(toString(evaluate(parallel, expression)), toString(evaluate(sequential, expression)))
+                    << seed << " " << expression;
+        }
+    }
+}
+
+TEST(ParallelJSONParserTest, SplitsTopLevelArrays) {
+    std::string json = "[";
+    for (int i = 0; i < 10000; ++i) {
+        json += (i > 0 ? ", " : "") + std::string("[\"x\\\\\", ") + std::to_string(i) + "]";
+    }
+    json += "]";
+    JSONValue value = parseParallel(json);
+    ASSERT_EQ(value.asArray().size(), 10000);
+    EXPECT_EQ(value.asArray()[9999].asArray()[1].asNumber(), 9999);
+    EXPECT_EQ(value.asArray()[17].asArray()[0].asString(), "x\\");
+}
+
+TEST(ParallelJSONParserTest, HonoursProjection) {
+    std::string json = randomDocument(7);
+    JSONValue full = JSONParser(json).parse();
+    for (const std::string expression : {"a.items[3].name", "a.samples[a.items[2].id]", "max(a.samples) + dup",
+                                         "a.items[499].tags[0]", "tail[1][1][0]"}) {
+        ExprParser parser(expression);
+        ExprPtr expr = parser.parse();
+        ProjectionNode projection = ProjectionCollector::collect(*expr);
+        JSONValue projected = parseParallel(json, &projection);
+        EXPECT_EQ(toString(evaluate(projected, expression)), toString(evaluate(full, expression))) << expression;
+    }
+}
+
+TEST(ParallelJSONParserTest, EmptyContainers) {
+    EXPECT_TRUE(parseParallel("[                                                                   ]").asArray().empty());
+    EXPECT_TRUE(parseParallel("{                                                                   }").asObject().empty());
+}
+
+TEST(ParallelJSONParserTest, ReportsSequentialErrors) {
+    std::string padding(100, ' ');
+    for (const std::string json : {"[1, 2,, 3]", "[1, 2, 3", "{\"a\": 1, \"b\" 2}", "[1, 2] 3", "[1, {]}",
+                                   "[1, 2, tru]", "{\"a\": [1, 2}"}) {
+        std::string padded = json + padding;
+        std::string expected;
+        try {
+            JSONParser(padded).parse();
+        } catch (const std::runtime_error &ex) {
+            expected = ex.what();
+        }
+        ASSERT_FALSE(expected.empty()) << json;
+        try {
+            parseParallel(padded);
+            ADD_FAILURE() << json;
+        } catch (const std::runtime_error &ex) {
+            EXPECT_EQ(std::string(ex.what()), expected) << json;
+        }
+    }
+}
+// clang-format on
@@ -1,5 +1,7 @@
 #include "json_parser.h"
 #include "gtest/gtest.h"
+#include <cmath>
+#include <limits>
 
 // clang-format off
 TEST(JSONParserTest, ParseNull) {
@@ -32,6 +34,44 @@ TEST(JSONParserTest, ParseNumber) {
     EXPECT_EQ(value.asNumber(), -456.78);
 }
 
+TEST(JSONParserTest, ParseIntegersExactly) {
+    JSONValue value = JSONParser("[9007199254740993, -9223372036854775808, 9223372036854775808, 1e2, -0]").parse();
+    const auto &arr = value.asArray();
+    EXPECT_TRUE(arr[0].isInteger());
+    EXPECT_EQ(arr[0].asInteger(), 9007199254740993);
+    EXPECT_EQ(arr[1].asInteger(), std::numeric_limits<int64_t>::min());
+    EXPECT_FALSE(arr[2].isInteger());
+    EXPECT_EQ(arr[2].asNumber(), 9223372036854775808.0);
+    EXPECT_FALSE(arr[3].isInteger());
+    EXPECT_EQ(arr[3].asNumber(), 100);
+    EXPECT_TRUE(std::signbit(arr[4].asNumber()));
+}
+
+TEST(JSONParserTest, RejectsMalformedNumbers) {
+    for (const std::string json : {"-", "1.", "1e", "1e+", "-inf", "1e400"}) {
+        EXPECT_THROW(JSONParser(json).parse(), std::runtime_error) << json;
+    }
+}
+
+TEST(JSONParserTest, DecodeUnicodeEscapes) {
+    for (StringStorage storage: {StringStorage::Copy, StringStorage::Borrow}) {
+        JSONValue value = JSONParser(R"({"\u0061": ["\u00e9\u20AC", "\ud83d\ude00!", "\u0000"]})", nullptr, storage).parse();
+        const auto &arr = value.asObject().at("a").asArray();
+        EXPECT_EQ(arr[0].asString().str(), "\xc3\xa9\xe2\x82\xac");
+        EXPECT_EQ(arr[1].asString().str(), "\xf0\x9f\x98\x80!");
+        EXPECT_EQ(arr[2].asString().str(), std::string(1, '\0'));
+    }
+}
+
+TEST(JSONParserTest, RejectInvalidStrings) {
+    for (const std::string json : {R"("\u12")", R"("\u12G4")", R"("\ud83d")", R"("\ud83d\u0041")", R"("\ude00")",
+                                   "\"\xc3\"", "\"\xed\xa0\x80\"", "\"abc\xff\""}) {
+        for (StringStorage storage: {StringStorage::Copy, StringStorage::Borrow}) {
+            EXPECT_THROW(JSONParser(json, nullptr, storage).parse(), std::runtime_error) << json;
+        }
+    }
+}
+
 TEST(JSONParserTest, ParseString) {
     JSONParser parser("\"hello\"");
     JSONValue value = parser.parse();
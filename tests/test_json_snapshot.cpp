@@ -0,0 +1,145 @@
+#include "json_snapshot.h"
+#include "expr_parser.h"
+#include "expr_evaluator.h"
+#include "gtest/gtest.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+// clang-format off
+class JSONSnapshotTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        sourcePath = ::testing::TempDir() + "json_snapshot_test.json";
+        snapshotPath = ::testing::TempDir() + "json_snapshot_test.snap";
+        std::ofstream(sourcePath) << json;
+        std::remove(snapshotPath.c_str());
+    }
+
+    void TearDown() override {
+        std::remove(sourcePath.c_str());
+        std::remove(snapshotPath.c_str());
+    }
+
+    static std::string evaluate(const JSONTape &tape, const std::string &expression) {
+        ExprPtr expr = ExprParser(expression).parse();
+        ExprEvaluator evaluator(tape);
+        expr->accept(evaluator);
+        return ExprEvaluator::jsonValueToString(evaluator.result);
+    }
+
+    const std::string json = R"({"a": {"b": [1, 2.5, {"c": "te\"st"}, [11, -12]], "flags": [true, false, null]}})";
+    std::string sourcePath;
+    std::string snapshotPath;
+};
+
+TEST_F(JSONSnapshotTest, RoundTrip) {
+    SourceStamp stamp = SourceStamp::of(sourcePath);
+    JSONSnapshot::write(snapshotPath, JSONTapeParser(json).parse(), stamp);
+
+    std::optional<JSONTape> tape = JSONSnapshot::load(snapshotPath, stamp);
+    ASSERT_TRUE(tape.has_value());
+    EXPECT_EQ(evaluate(*tape, "a.b[2].c"), "te\"st");
+    EXPECT_EQ(evaluate(*tape, "a.b[3][1]"), "-12");
+    EXPECT_EQ(evaluate(*tape, "max(a.b[0], a.b[1])"), "2.5");
+    EXPECT_EQ(evaluate(*tape, "a.flags"), "[ true, false, null ]");
+    EXPECT_EQ(tape->memoryUsage(), 0u);
+}
+
+TEST_F(JSONSnapshotTest, SnapshotOfLoadedSnapshot) {
+    SourceStamp stamp = SourceStamp::of(sourcePath);
+    JSONSnapshot::write(snapshotPath, JSONTapeParser(json).parse(), stamp);
+    std::optional<JSONTape> tape = JSONSnapshot::load(snapshotPath, stamp);
+    ASSERT_TRUE(tape.has_value());
+
+    std::string copyPath = snapshotPath + ".copy";
+    JSONSnapshot::write(copyPath, *tape, stamp);
+    std::optional<JSONTape> copy = JSONSnapshot::load(copyPath, stamp);
+    std::remove(copyPath.c_str());
+    ASSERT_TRUE(copy.has_value());
+    EXPECT_EQ(evaluate(*copy, "a.b[2].c"), "te\"st");
+}
+
+TEST_F(JSONSnapshotTest, RejectStaleSnapshots) {
+    SourceStamp stamp = SourceStamp::of(sourcePath);
+    JSONSnapshot::write(snapshotPath, JSONTapeParser(json).parse(), stamp);
+
+    SourceStamp resized = stamp;
+    resized.size += 1;
+    EXPECT_FALSE(JSONSnapshot::load(snapshotPath, resized).has_value());
+
+    SourceStamp touched = stamp;
+    touched.mtimeNanoseconds += 1;
+    EXPECT_FALSE(JSONSnapshot::load(snapshotPath, touched).has_value());
+}
+
+TEST_F(JSONSnapshotTest, RejectMissingAndMalformedSnapshots) {
+    SourceStamp stamp = SourceStamp::of(sourcePath);
+    EXPECT_FALSE(JSONSnapshot::load(snapshotPath, stamp).has_value());
+
+    std::ofstream(snapshotPath) << "not a snapshot";
+    EXPECT_FALSE(JSONSnapshot::load(snapshotPath, stamp).has_value());
+
+    // Truncated after a valid header
+    JSONSnapshot::write(snapshotPath, JSONTapeParser(json).parse(), stamp);
+    std::string bytes;
+    {
+        std::ifstream in(snapshotPath, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    std::ofstream(snapshotPath, std::ios::binary | std::ios::trunc) << bytes.substr(0, bytes.size() - 3);
+    EXPECT_FALSE(JSONSnapshot::load(snapshotPath, stamp).has_value());
+}
+
+TEST_F(JSONSnapshotTest, RejectCorruptedTapes) {
+    SourceStamp stamp = SourceStamp::of(sourcePath);
+    JSONTape parsed = JSONTapeParser(json).parse();
+    JSONSnapshot::write(snapshotPath, parsed, stamp);
+    std::string bytes;
+    {
+        std::ifstream in(snapshotPath, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    size_t words = parsed.wordCount();
+    size_t header = bytes.size() - words * sizeof(uint64_t) - parsed.arenaBytes().size();
+    auto corrupted = [&](size_t index, uint64_t word) {
+        std::string copy = bytes;
+        std::memcpy(&copy[header + index * sizeof(uint64_t)], &word, sizeof(word));
+        std::ofstream(snapshotPath, std::ios::binary | std::ios::trunc) << copy;
+        return JSONSnapshot::load(snapshotPath, stamp).has_value();
+    };
+    auto tagged = [](char tag, uint64_t payload) { return (static_cast<uint64_t>(tag) << JSONTape::tagShift) | payload; };
+    EXPECT_TRUE(corrupted(0, tagged('{', words - 1)));
+    // The sizes in the header still match, but the words do not
+    EXPECT_FALSE(corrupted(0, tagged('x', words - 1)));
+    EXPECT_FALSE(corrupted(0, tagged('{', words + 100)));
+    EXPECT_FALSE(corrupted(0, tagged('{', words - 2)));
+    EXPECT_FALSE(corrupted(1, tagged('s', 1u << 20)));
+    EXPECT_FALSE(corrupted(1, tagged('n', 0)));
+    EXPECT_FALSE(corrupted(words - 1, tagged('}', 7)));
+}
+
+TEST_F(JSONSnapshotTest, ConcurrentWritersPublishWholeSnapshots) {
+    SourceStamp stamp = SourceStamp::of(sourcePath);
+    JSONTape parsed = JSONTapeParser(json).parse();
+    std::vector<std::thread> writers;
+    for (int writer = 0; writer < 4; ++writer) {
+        writers.emplace_back([&] {
+            for (int i = 0; i < 25; ++i) {
+                JSONSnapshot::write(snapshotPath, parsed, stamp);
+                std::optional<JSONTape> tape = JSONSnapshot::load(snapshotPath, stamp);
+                ASSERT_TRUE(tape.has_value());
+                EXPECT_EQ(evaluate(*tape, "a.b[3][1]"), "-12");
+            }
+        });
+    }
+    for (auto &writer: writers) {
+        writer.join();
+    }
+}
+
+TEST_F(JSONSnapshotTest, StampNeedsRegularFile) {
+    EXPECT_THROW(SourceStamp::of(::testing::TempDir() + "missing_json_snapshot_test.json"), std::runtime_error);
+}
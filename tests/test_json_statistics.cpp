@@ -0,0 +1,99 @@
+#include "json_statistics.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// clang-format off
+namespace {
+
+std::vector<double> exponentialNumbers(size_t count) {
+    std::mt19937_64 random(7);
+    std::exponential_distribution<double> distribution(0.01);
+    std::vector<double> numbers(count);
+    for (double &number: numbers) {
+        number = distribution(random);
+    }
+    return numbers;
+}
+
+// Share of numbers below value, which has to lie within tolerance of q for an accurate estimate
+double rankOf(const std::vector<double> &sorted, double value) {
+    return static_cast<double>(std::lower_bound(sorted.begin(), sorted.end(), value) - sorted.begin()) /
+           static_cast<double>(sorted.size());
+}
+
+}
+
+TEST(JSONStatisticsTest, MomentsMergeLikeOnePass) {
+    NumericMoments all;
+    NumericMoments left;
+    NumericMoments right;
+    std::vector<double> numbers = {2, 4, 4, 4, 5, 5, 7, 9};
+    for (size_t i = 0; i < numbers.size(); ++i) {
+        all.addDouble(numbers[i]);
+        (i < 3 ? left : right).addDouble(numbers[i]);
+    }
+    EXPECT_DOUBLE_EQ(all.mean, 5);
+    EXPECT_DOUBLE_EQ(all.variance(), 4);
+    left.merge(right);
+    EXPECT_EQ(left.count, 8u);
+    EXPECT_DOUBLE_EQ(left.mean, 5);
+    EXPECT_DOUBLE_EQ(left.variance(), 4);
+
+    // Welford does not cancel catastrophically around a large mean
+    NumericMoments shifted;
+    for (double number: numbers) {
+        shifted.addDouble(number + 1e9);
+    }
+    EXPECT_NEAR(shifted.variance(), 4, 1e-6);
+}
+
+TEST(JSONStatisticsTest, ExactQuantileInterpolatesBetweenRanks) {
+    std::vector<double> numbers = {4, 1, 3, 2};
+    EXPECT_EQ(exactQuantile(numbers, 0.5), 2.5);
+    EXPECT_EQ(exactQuantile(numbers, 0), 1);
+    EXPECT_EQ(exactQuantile(numbers, 1), 4);
+    EXPECT_EQ(exactQuantile(numbers, 0.25), 1.75);
+    std::vector<double> single = {3};
+    EXPECT_EQ(exactQuantile(single, 0.9), 3);
+}
+
+TEST(JSONStatisticsTest, SketchIsExactForFewNumbers) {
+    std::vector<double> numbers = exponentialNumbers(150);
+    QuantileSketch sketch;
+    for (double number: numbers) {
+        sketch.addDouble(number);
+    }
+    for (double q: {0.0, 0.01, 0.25, 0.5, 0.9, 0.99, 1.0}) {
+        std::vector<double> copy = numbers;
+        EXPECT_DOUBLE_EQ(sketch.quantile(q), exactQuantile(copy, q)) << q;
+    }
+}
+
+TEST(JSONStatisticsTest, SketchStaysAccurateInBoundedMemory) {
+    std::vector<double> numbers = exponentialNumbers(1000000);
+    QuantileSketch sketch;
+    std::vector<QuantileSketch> chunks(8);
+    for (size_t i = 0; i < numbers.size(); ++i) {
+        sketch.addDouble(numbers[i]);
+        chunks[i * chunks.size() / numbers.size()].addDouble(numbers[i]);
+    }
+    for (size_t i = 1; i < chunks.size(); ++i) {
+        chunks[0].merge(chunks[i]);
+    }
+    EXPECT_LE(sketch.centroidCount(), static_cast<size_t>(QuantileSketch::defaultCompression));
+    EXPECT_LE(chunks[0].centroidCount(), static_cast<size_t>(QuantileSketch::defaultCompression));
+    EXPECT_EQ(chunks[0].count(), numbers.size());
+
+    std::sort(numbers.begin(), numbers.end());
+    for (double q: {0.001, 0.01, 0.1, 0.5, 0.9, 0.99, 0.999}) {
+        // Rank errors shrink towards the ends of the distribution
+        double tolerance = 0.02 * std::sqrt(q * (1 - q)) + 1e-4;
+        EXPECT_NEAR(rankOf(numbers, sketch.quantile(q)), q, tolerance) << q;
+        EXPECT_NEAR(rankOf(numbers, chunks[0].quantile(q)), q, tolerance) << q;
+    }
+    EXPECT_EQ(sketch.quantile(0), numbers.front());
+    EXPECT_EQ(sketch.quantile(1), numbers.back());
+}
+// clang-format on
@@ -0,0 +1,86 @@
+#include "json_parser.h"
+#include "json_parallel_parser.h"
+#include "expr_parser.h"
+#include "expr_evaluator.h"
+#include "gtest/gtest.h"
+
+// clang-format off
+TEST(JSONStringTest, OwnedAndBorrowedCompareEqual) {
+    std::string text = "hello";
+    JSONString owned("hello");
+    JSONString borrowed = JSONString::borrow(text);
+    EXPECT_EQ(owned, borrowed);
+    EXPECT_EQ(std::hash<JSONString>()(owned), std::hash<JSONString>()(borrowed));
+    EXPECT_NE(owned, JSONString("hellO"));
+    EXPECT_EQ(borrowed.size(), 5);
+}
+
+TEST(JSONStringTest, PrehashedMatchesComputedHash) {
+    JSONString prehashed = JSONString::prehashed("key");
+    EXPECT_EQ(prehashed, JSONString("key"));
+    EXPECT_EQ(std::hash<JSONString>()(prehashed), std::hash<JSONString>()(JSONString("key")));
+    EXPECT_EQ(std::hash<JSONString>()(prehashed), std::hash<JSONString>()(JSONString::borrowEscaped(R"("k\u0065y")")));
+}
+
+TEST(JSONStringTest, EscapesAreDecodedOnDemand) {
+    JSONString escaped = JSONString::borrowEscaped(R"("a\"b\\c\nd")");
+    EXPECT_TRUE(escaped.hasEscapes());
+    EXPECT_EQ(escaped.str(), "a\"b\\c\nd");
+    EXPECT_EQ(escaped.size(), 7);
+    EXPECT_EQ(escaped, JSONString("a\"b\\c\nd"));
+    EXPECT_EQ(std::hash<JSONString>()(escaped), std::hash<JSONString>()(JSONString("a\"b\\c\nd")));
+}
+
+TEST(JSONStringTest, BorrowedParseMatchesCopiedParse) {
+    std::string json = R"({"plain": "text", "esc": "q\"uote\\", "k\"ey": [ "x", "y\/z" ], "n": 1})";
+    JSONValue copied = JSONParser(json).parse();
+    JSONValue borrowed = JSONParser(json, nullptr, StringStorage::Borrow).parse();
+    EXPECT_EQ(ExprEvaluator::jsonValueToString(copied), ExprEvaluator::jsonValueToString(borrowed));
+
+    const auto &obj = borrowed.asObject();
+    EXPECT_FALSE(obj.at("plain").asString().hasEscapes());
+    EXPECT_TRUE(obj.at("esc").asString().hasEscapes());
+    EXPECT_EQ(obj.at("esc").asString().str(), "q\"uote\\");
+    // Keys are unescaped while parsing
+    EXPECT_EQ(obj.at("k\"ey").asArray()[1].asString().str(), "y/z");
+}
+
+TEST(JSONStringTest, BorrowedStringsPointIntoInput) {
+    std::string json = R"(["abc", "d\ne"])";
+    JSONValue value = JSONParser(json, nullptr, StringStorage::Borrow).parse();
+    const auto &plain = value.asArray()[0].asString();
+    plain.withText([&json](std::string_view text) {
+        EXPECT_EQ(text.data(), json.data() + 2);
+    });
+    EXPECT_EQ(value.asArray()[1].asString().str(), "d\ne");
+}
+
+TEST(JSONStringTest, ParallelParserBorrowsToo) {
+    std::string json = "{";
+    for (int i = 0; i < 200; ++i) {
+        json += (i > 0 ? ", " : "") + std::string("\"key") + std::to_string(i) + "\": [\"v\\t" + std::to_string(i) + "\", \"w\"]";
+    }
+    json += "}";
+    ParallelJSONParser parser(json, nullptr, 4, StringStorage::Borrow);
+    parser.setMinParallelBytes(64);
+    JSONValue parallel = parser.parse();
+    JSONValue sequential = JSONParser(json).parse();
+    ASSERT_EQ(parallel.asObject().size(), sequential.asObject().size());
+    for (const auto &[key, value] : sequential.asObject()) {
+        EXPECT_EQ(ExprEvaluator::jsonValueToString(parallel.asObject().at(key)), ExprEvaluator::jsonValueToString(value));
+    }
+}
+
+TEST(JSONStringTest, EvaluatorLooksUpBorrowedKeys) {
+    std::string json = R"({"a": {"b c": "x\ty", "s": "str"}})";
+    JSONValue root = JSONParser(json, nullptr, StringStorage::Borrow).parse();
+    for (const auto &[expression, expected] : std::vector<std::pair<std::string, std::string>>{
+            {"a[\"b c\"]", "x\ty"}, {"size(a[\"b c\"])", "3"}, {"size(a.s)", "3"}}) {
+        ExprParser parser(expression);
+        ExprPtr expr = parser.parse();
+        ExprEvaluator evaluator(root);
+        expr->accept(evaluator);
+        EXPECT_EQ(ExprEvaluator::jsonValueToString(evaluator.result), expected) << expression;
+    }
+}
+// clang-format on
@@ -0,0 +1,112 @@
+#include "json_structural_index.h"
+#include "json_parser.h"
+#include "gtest/gtest.h"
+#include <random>
+
+// clang-format off
+namespace {
+
+// Byte-at-a-time definition of what stage one is supposed to produce
+std::vector<size_t> referenceIndex(std::string_view input) {
+    std::vector<size_t> positions;
+    bool inString = false;
+    bool escaped = false;
+    bool prevNonQuoteScalar = false;
+    for (size_t i = 0; i < input.size(); ++i) {
+        char chr = input[i];
+        bool isEscaped = escaped;
+        escaped = chr == '\\' && !isEscaped;
+        bool isQuote = chr == '"' && !isEscaped;
+        bool isOp = chr == '{' || chr == '}' || chr == '[' || chr == ']' || chr == ':' || chr == ',';
+        bool isWhitespace = std::isspace(static_cast<unsigned char>(chr)) != 0;
+        bool wasInString = inString;
+        if (isQuote) {
+            inString = !inString;
+        }
+        bool scalar = !isOp && !isWhitespace;
+        bool scalarStart = scalar && !prevNonQuoteScalar;
+        prevNonQuoteScalar = scalar && !isQuote;
+        if (!wasInString && (isOp || scalarStart)) {
+            positions.push_back(i);
+        }
+    }
+    return positions;
+}
+
+std::vector<size_t> collect(std::string_view input, StructuralKernel kernel) {
+    StructuralIndex index(input, kernel);
+    std::vector<size_t> positions;
+    for (size_t pos = index.next(); pos != input.size(); pos = index.next()) {
+        positions.push_back(pos);
+    }
+    return positions;
+}
+
+std::vector<StructuralKernel> supportedKernels() {
+    std::vector<StructuralKernel> kernels;
+    for (auto kernel: {StructuralKernel::Scalar, StructuralKernel::SSE42, StructuralKernel::AVX2}) {
+        if (isStructuralKernelSupported(kernel)) {
+            kernels.push_back(kernel);
+        }
+    }
+    return kernels;
+}
+
+} // namespace
+
+TEST(StructuralIndexTest, IndexesStructuralsAndScalarStarts) {
+    std::string_view input = R"({"a": [1, true, "x,y"]})";
+    std::vector<size_t> expected = {0, 1, 4, 6, 7, 8, 10, 14, 16, 21, 22};
+    for (auto kernel: supportedKernels()) {
+        EXPECT_EQ(collect(input, kernel), expected) << structuralKernelName(kernel);
+    }
+}
+
+TEST(StructuralIndexTest, EscapedQuotesStayInsideStrings) {
+    std::string_view input = R"(["a\"]", "b\\", 1])";
+    for (auto kernel: supportedKernels()) {
+        EXPECT_EQ(collect(input, kernel), referenceIndex(input)) << structuralKernelName(kernel);
+    }
+}
+
+TEST(StructuralIndexTest, KernelsMatchReferenceOnRandomInput) {
+    const std::string alphabet = "{}[]:,\"\\ \n\tab1-";
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> pick(0, alphabet.size() - 1);
+    std::uniform_int_distribution<size_t> length(0, 400);
+    for (int round = 0; round < 500; ++round) {
+        std::string input(length(rng), ' ');
+        for (auto &chr: input) {
+            chr = alphabet[pick(rng)];
+        }
+        auto expected = referenceIndex(input);
+        for (auto kernel: supportedKernels()) {
+            ASSERT_EQ(collect(input, kernel), expected) << structuralKernelName(kernel) << " on " << input;
+        }
+    }
+}
+
+TEST(StructuralIndexTest, SpansManyWindows) {
+    std::string input = "[";
+    for (int i = 0; i < 100000; ++i) {
+        input += "\"k\\\"\", ";
+    }
+    input += "0]";
+    for (auto kernel: supportedKernels()) {
+        EXPECT_EQ(collect(input, kernel), referenceIndex(input)) << structuralKernelName(kernel);
+    }
+}
+
+TEST(StructuralIndexTest, ParserRejectsGluedScalars) {
+    EXPECT_THROW(JSONParser("[12ab]").parse(), std::runtime_error);
+    EXPECT_THROW(JSONParser("truex").parse(), std::runtime_error);
+    EXPECT_THROW(JSONParser("[1 2]").parse(), std::runtime_error);
+    EXPECT_THROW(JSONParser("\"open").parse(), std::runtime_error);
+}
+
+TEST(StructuralIndexTest, ParserKeepsStructuralsInsideStrings) {
+    JSONParser parser(R"({"k{": "[1, 2]", "e": "q\"}"})");
+    JSONValue value = parser.parse();
+    EXPECT_EQ(value.asObject().at("k{").asString(), "[1, 2]");
+    EXPECT_EQ(value.asObject().at("e").asString(), "q\"}");
+}
@@ -0,0 +1,92 @@
+#include "json_tape.h"
+#include "expr_parser.h"
+#include "expr_evaluator.h"
+#include "gtest/gtest.h"
+
+// clang-format off
+class JSONTapeTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        std::string json_content = "{\n"
+                                   "  \"a\": {\n"
+                                   "    \"b\": [\n"
+                                   "      1,\n"
+                                   "      2,\n"
+                                   "      {\n"
+                                   "        \"c\": \"test\"\n"
+                                   "      },\n"
+                                   "      [\n"
+                                   "        11,\n"
+                                   "        12\n"
+                                   "      ]\n"
+                                   "    ],\n"
+                                   "    \"flags\": [true, false, null],\n"
+                                   "    \"e\": \"q\\\"uote\"\n"
+                                   "  }\n"
+                                   "}";
+        tape = JSONTapeParser(json_content).parse();
+    }
+
+    JSONValue evaluate(const std::string &expression) {
+        ExprParser parser(expression);
+        ExprPtr expr = parser.parse();
+        ExprEvaluator evaluator(tape);
+        expr->accept(evaluator);
+        return evaluator.result;
+    }
+
+    JSONTape tape;
+};
+
+TEST_F(JSONTapeTest, NavigatesObjectsAndArrays) {
+    JSONTapeView root = tape.root();
+    EXPECT_TRUE(root.isObject());
+    EXPECT_EQ(root.size(), 1);
+    auto a = root.find("a");
+    ASSERT_TRUE(a.has_value());
+    auto b = a->find("b");
+    ASSERT_TRUE(b.has_value());
+    EXPECT_TRUE(b->isArray());
+    EXPECT_EQ(b->size(), 4);
+    EXPECT_EQ(b->at(1).asNumber(), 2);
+    EXPECT_EQ(b->at(2).find("c")->asString(), "test");
+    EXPECT_EQ(b->at(3).at(1).asNumber(), 12);
+    EXPECT_FALSE(root.find("missing").has_value());
+    EXPECT_THROW((void) b->at(4), std::runtime_error);
+}
+
+TEST_F(JSONTapeTest, StoresLiteralsAndEscapedStrings) {
+    JSONTapeView a = *tape.root().find("a");
+    JSONTapeView flags = *a.find("flags");
+    EXPECT_TRUE(flags.at(0).asBool());
+    EXPECT_FALSE(flags.at(1).asBool());
+    EXPECT_TRUE(flags.at(2).isNull());
+    EXPECT_EQ(a.find("e")->asString(), "q\"uote");
+}
+
+TEST_F(JSONTapeTest, ConvertsToJSONValue) {
+    JSONValue value = tape.root().toJSONValue();
+    const auto &b = value.asObject().at("a").asObject().at("b").asArray();
+    EXPECT_EQ(b.size(), 4);
+    EXPECT_EQ(b[2].asObject().at("c").asString(), "test");
+}
+
+TEST_F(JSONTapeTest, EvaluatesExpressions) {
+    EXPECT_EQ(evaluate("a.b[1]").asNumber(), 2);
+    EXPECT_EQ(evaluate("a.b[a.b[1]].c").asString(), "test");
+    EXPECT_EQ(evaluate("min(a.b[3]) + size(a.b)").asNumber(), 15);
+    EXPECT_EQ(evaluate("average(a.b[3], 5)").asNumber(), 28.0 / 3);
+    EXPECT_TRUE(evaluate("a.b").isArray());
+    EXPECT_THROW(evaluate("a.x"), std::runtime_error);
+}
+
+TEST(JSONTapeParserTest, DuplicateKeysKeepLastValue) {
+    JSONTape tape = JSONTapeParser(R"({"k": 1, "k": 2})").parse();
+    EXPECT_EQ(tape.root().find("k")->asNumber(), 2);
+}
+
+TEST(JSONTapeParserTest, InvalidJSON) {
+    EXPECT_THROW(JSONTapeParser("{invalid_json}").parse(), std::runtime_error);
+    EXPECT_THROW(JSONTapeParser("[1, 2").parse(), std::runtime_error);
+    EXPECT_THROW(JSONTapeParser("[1] 2").parse(), std::runtime_error);
+}
@@ -0,0 +1,86 @@
+#include "json_utf8.h"
+#include "gtest/gtest.h"
+#include <random>
+
+// clang-format off
+namespace {
+
+std::vector<StructuralKernel> supportedKernels() {
+    std::vector<StructuralKernel> kernels;
+    for (StructuralKernel kernel: {StructuralKernel::Scalar, StructuralKernel::SSE42, StructuralKernel::AVX2}) {
+        if (isStructuralKernelSupported(kernel)) {
+            kernels.push_back(kernel);
+        }
+    }
+    return kernels;
+}
+
+// Pads text on both sides so the SIMD kernels see it at every offset within a chunk and across chunks
+std::vector<std::string> placements(const std::string &text) {
+    std::vector<std::string> placed;
+    for (size_t before: {0, 1, 13, 15, 31, 33}) {
+        placed.push_back(std::string(before, 'a') + text + std::string(40, 'b'));
+        placed.push_back(std::string(before, 'a') + text);
+    }
+    return placed;
+}
+
+}
+
+TEST(JSONUTF8Test, AcceptWellFormedText) {
+    for (const std::string text : {"", "plain ascii", "\xc2\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80",
+                                   "\xed\x9f\xbf", "\xee\x80\x80", "\xf4\x8f\xbf\xbf", "gr\xc3\xbc\xc3\x9f" "e \xe4\xb8\x96\xe7\x95\x8c"}) {
+        for (StructuralKernel kernel: supportedKernels()) {
+            for (const std::string &placed: placements(text)) {
+                EXPECT_TRUE(isValidUTF8(placed, kernel)) << structuralKernelName(kernel) << ": " << placed;
+            }
+        }
+    }
+}
+
+TEST(JSONUTF8Test, RejectMalformedText) {
+    for (const std::string text : {"\x80", "\xbf", "\xc0\x80", "\xc1\xbf", "\xc2", "\xc2\x41", "\xe0\x80\x80",
+                                   "\xe0\x9f\xbf", "\xed\xa0\x80", "\xed\xbf\xbf", "\xe2\x82", "\xf0\x8f\xbf\xbf",
+                                   "\xf4\x90\x80\x80", "\xf5\x80\x80\x80", "\xff", "\xf0\x9f\x98", "\xc2\xa9\xa9"}) {
+        for (StructuralKernel kernel: supportedKernels()) {
+            for (const std::string &placed: placements(text)) {
+                EXPECT_FALSE(isValidUTF8(placed, kernel)) << structuralKernelName(kernel) << ": " << placed;
+            }
+        }
+    }
+}
+
+TEST(JSONUTF8Test, KernelsAgreeOnRandomInput) {
+    std::mt19937 random(7);
+    // Mostly well-formed text with a few corrupted bytes, so both outcomes are common
+    const std::vector<std::string> pieces = {"a", "z ", "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80", "\x80", "\xe2", "\xed\xa0\x80"};
+    for (int round = 0; round < 2000; ++round) {
+        std::string text;
+        size_t count = random() % 40;
+        for (size_t i = 0; i < count; ++i) {
+            size_t piece = random() % pieces.size();
+            text += pieces[random() % 8 == 0 ? piece : piece % 5];
+        }
+        bool expected = isValidUTF8(text, StructuralKernel::Scalar);
+        for (StructuralKernel kernel: supportedKernels()) {
+            EXPECT_EQ(isValidUTF8(text, kernel), expected) << structuralKernelName(kernel) << ": " << text;
+        }
+    }
+}
+
+TEST(JSONUTF8Test, FindQuoteOrBackslash) {
+    bool nonASCII = false;
+    std::string text = std::string(40, 'x') + "\xc3\xa9" + "\"";
+    EXPECT_EQ(findQuoteOrBackslash(text, 0, nonASCII), 42u);
+    EXPECT_TRUE(nonASCII);
+
+    // Non-ASCII bytes after the quote are not part of the run
+    nonASCII = false;
+    text = std::string(20, 'x') + "\\" + "\xc3\xa9";
+    EXPECT_EQ(findQuoteOrBackslash(text, 3, nonASCII), 20u);
+    EXPECT_FALSE(nonASCII);
+
+    nonASCII = false;
+    EXPECT_EQ(findQuoteOrBackslash("abc", 0, nonASCII), 3u);
+    EXPECT_FALSE(nonASCII);
+}
@@ -0,0 +1,65 @@
+#include "json_value_ref.h"
+#include "gtest/gtest.h"
+
+// clang-format off
+namespace {
+
+const char *document = "{\"a\": [1, 2.5, \"x\\\"y\", [3]], \"o\": {\"k\": true, \"k\": false}}";
+
+// Sum of the numbers in an array, read through forEachElement
+double sumNumbers(const JSONValueRef &array) {
+    double sum = 0;
+    array.forEachElement([&sum](const auto &element) {
+        if (element.isNumber()) {
+            sum += element.asNumber();
+        }
+    });
+    return sum;
+}
+
+}
+
+TEST(JSONValueRefTest, ReadTreeAndTapeAlike) {
+    JSONValue root = JSONParser(document).parse();
+    JSONTape tape = JSONTapeParser(document).parse();
+    for (const JSONValueRef &ref: {JSONValueRef::to(root), JSONValueRef::to(tape.root())}) {
+        ASSERT_TRUE(ref.isObject());
+        JSONValueRef array = *ref.find("a");
+        EXPECT_TRUE(array.isArray());
+        EXPECT_EQ(array.size(), 4u);
+        EXPECT_TRUE(array.at(0).isInteger());
+        EXPECT_EQ(array.at(0).asInteger(), 1);
+        EXPECT_DOUBLE_EQ(array.at(1).asNumber(), 2.5);
+        EXPECT_EQ(array.at(2).size(), 3u);
+        EXPECT_EQ(array.at(2).withString([](std::string_view text) { return std::string(text); }), "x\"y");
+        EXPECT_DOUBLE_EQ(sumNumbers(array), 3.5);
+        EXPECT_FALSE(ref.find("o")->find("k")->asBool());
+        EXPECT_FALSE(ref.find("missing"));
+        JSONValue copy = array.at(3).toJSONValue();
+        ASSERT_EQ(copy.asArray().size(), 1u);
+        EXPECT_EQ(copy.asArray()[0].asInteger(), 3);
+    }
+}
+
+TEST(JSONValueRefTest, ThrowOnWrongTypeOrIndex) {
+    JSONValue root = JSONParser(document).parse();
+    JSONTape tape = JSONTapeParser(document).parse();
+    for (const JSONValueRef &ref: {JSONValueRef::to(root), JSONValueRef::to(tape.root())}) {
+        EXPECT_THROW((void) ref.at(0), std::runtime_error);
+        EXPECT_THROW((void) ref.find("a")->at(4), std::runtime_error);
+        EXPECT_THROW((void) ref.find("a")->find("k"), std::runtime_error);
+    }
+}
+
+TEST(JSONValueRefTest, HoldComputedValues) {
+    JSONValueRef number = JSONValueRef::holding(int64_t{42});
+    EXPECT_TRUE(number.isInteger());
+    EXPECT_EQ(number.asInteger(), 42);
+    EXPECT_TRUE(JSONValueRef().isNull());
+
+    JSONValueRef array = JSONValueRef::holding(JSONArray{1, 2});
+    JSONValueRef element = array.at(1);
+    array = JSONValueRef();
+    // Elements of a held value are copied out, so they outlive it
+    EXPECT_EQ(element.asInteger(), 2);
+}
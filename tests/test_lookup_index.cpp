@@ -0,0 +1,105 @@
+#include "lookup_index.h"
+#include "expr_evaluator.h"
+#include "expr_functions.h"
+#include "expr_parser.h"
+#include "json_parser.h"
+#include "json_tape.h"
+#include "gtest/gtest.h"
+
+// clang-format off
+namespace {
+
+const char *document = R"({"users": [{"id": 7, "name": "a"}, "x", {"id": "7", "name": "b"}, {"name": "c"},
+                           {"id": 7.0, "name": "d"}, {"id": 2.5, "name": "e"}, {"id": [1], "name": "f"},
+                           {"id": null, "name": "g"}, {"id": true, "name": "h"}]})";
+
+std::string key(const std::string &json) {
+    return *lookupKey(JSONValueRef::to(JSONParser(json).parse()));
+}
+
+std::string nameOf(const std::optional<JSONValueRef> &found) {
+    if (!found) {
+        return "";
+    }
+    return found->find("name")->withString([](std::string_view name) { return std::string(name); });
+}
+
+}
+
+TEST(LookupIndexTest, KeyComparesNumbersByValue) {
+    EXPECT_EQ(key("7"), key("7.0"));
+    EXPECT_EQ(key("-0.0"), key("0"));
+    EXPECT_NE(key("7"), key("\"7\""));
+    EXPECT_NE(key("2.5"), key("2"));
+    EXPECT_NE(key("true"), key("null"));
+    EXPECT_FALSE(lookupKey(JSONValueRef::to(JSONParser("[1]").parse())));
+}
+
+TEST(LookupIndexTest, IndexMatchesScan) {
+    JSONValue root = JSONParser(document).parse();
+    JSONTape tape = JSONTapeParser(document).parse();
+    for (const JSONValueRef &users: {JSONValueRef::to(root.asObject().at(JSONString("users"))),
+                                     *JSONValueRef::to(tape.root()).find("users")}) {
+        LookupIndex index(users, "id");
+        EXPECT_EQ(index.size(), 5u);
+        for (const char *value: {"7", "\"7\"", "2.5", "null", "true", "8", "\"name\""}) {
+            std::string bytes = key(value);
+            EXPECT_EQ(nameOf(index.find(bytes)), nameOf(scanLookup(users, "id", bytes))) << value;
+        }
+        EXPECT_EQ(nameOf(index.find(key("7"))), "a");
+        EXPECT_EQ(nameOf(index.find(key("\"7\""))), "b");
+    }
+}
+
+TEST(LookupIndexTest, ShardedBuildKeepsFirstMatch) {
+    std::string json = "[";
+    for (size_t i = 0; i < parallelIndexThreshold + 1000; ++i) {
+        json += (i == 0 ? "{" : ",{") + std::string("\"id\": ") + std::to_string(i % 50000) + ", \"at\": " +
+                std::to_string(i) + "}";
+    }
+    json += "]";
+    JSONTape tape = JSONTapeParser(json).parse();
+    JSONValue root = tape.root().toJSONValue();
+    ThreadPool pool(4);
+    ThreadPool single(1);
+    for (const LookupIndex &index: {LookupIndex(JSONValueRef::to(tape.root()), "id", pool),
+                                    LookupIndex(JSONValueRef::to(root), "id", pool),
+                                    LookupIndex(JSONValueRef::to(tape.root()), "id", single)}) {
+        EXPECT_EQ(index.size(), 50000u);
+        for (int64_t id: {0, 1, 12345, 49999}) {
+            auto found = index.find(key(std::to_string(id)));
+            ASSERT_TRUE(found);
+            EXPECT_EQ(found->find("at")->asInteger(), id);
+        }
+        EXPECT_FALSE(index.find(key("50000")));
+    }
+}
+
+TEST(LookupIndexTest, EvaluatorBuildsIndexOncePerArrayAndKey) {
+    JSONValue root = JSONParser(document).parse();
+    LookupIndexes indexes;
+    auto evaluate = [&](const std::string &expression, LookupIndexes *with) {
+        ExprPtr expr = ExprParser(expression).parse();
+        ExprEvaluator evaluator(root);
+        evaluator.setLookupIndexes(with);
+        expr->accept(evaluator);
+        return ExprEvaluator::jsonValueToString(evaluator.result);
+    };
+    for (const char *expression: {"find(users, \"id\", 7).name", "find(users, \"id\", \"7\").name",
+                                  "find(users, \"id\", 99)", "find(users, \"name\", \"e\").id"}) {
+        EXPECT_EQ(evaluate(expression, &indexes), evaluate(expression, nullptr)) << expression;
+    }
+    EXPECT_EQ(evaluate("find(users, \"id\", 7).name", &indexes), "a");
+    EXPECT_EQ(evaluate("find(users, \"id\", 99)", &indexes), "null");
+    EXPECT_EQ(indexes.size(), 2u);
+
+    // A projected array is computed, so it is scanned instead of indexed
+    EXPECT_EQ(evaluate("find(users[*], \"id\", 2.5).name", &indexes), "e");
+    EXPECT_EQ(indexes.size(), 2u);
+
+    for (const char *expression: {"find(users, \"id\")", "find(users[0], \"id\", 1)", "find(users, 1, 1)",
+                                  "find(users, \"id\", users)"}) {
+        EXPECT_THROW(evaluate(expression, &indexes), std::runtime_error) << expression;
+        EXPECT_THROW(evaluate(expression, nullptr), std::runtime_error) << expression;
+    }
+}
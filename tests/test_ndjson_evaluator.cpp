@@ -0,0 +1,83 @@
+#include "ndjson_evaluator.h"
+#include "expr_parser.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <sstream>
+
+// clang-format off
+namespace {
+
+struct NDJSONRun {
+    std::string output;
+    std::string errors;
+    size_t failures;
+};
+
+NDJSONRun runNDJSON(const std::string &input, const std::string &expression, size_t threads = 4, bool ordered = true) {
+    ExprPtr expr = ExprParser(expression).parse();
+    NDJSONEvaluator evaluator(*expr, threads);
+    evaluator.setOrdered(ordered);
+    std::ostringstream out, err;
+    size_t failures = evaluator.run(input, out, err);
+    return {out.str(), err.str(), failures};
+}
+
+}
+
+TEST(NDJSONEvaluatorTest, EvaluateEveryRecord) {
+    NDJSONRun run = runNDJSON("{\"a\": [1, 2, 3]}\n{\"a\": [4]}\n{\"a\": []}\n", "size(a) + 1");
+    EXPECT_EQ(run.output, "4\n2\n1\n");
+    EXPECT_EQ(run.errors, "");
+    EXPECT_EQ(run.failures, 0u);
+}
+
+TEST(NDJSONEvaluatorTest, SkipBlankLinesAndHandleMissingFinalNewline) {
+    NDJSONRun run = runNDJSON("\n{\"a\": \"x\"}\r\n  \n{\"a\": \"y\"}", "a");
+    EXPECT_EQ(run.output, "x\ny\n");
+    EXPECT_EQ(run.failures, 0u);
+}
+
+TEST(NDJSONEvaluatorTest, ReportFailedRecordsWithLineNumbers) {
+    NDJSONRun run = runNDJSON("{\"a\": 1}\n{\"a\": \n{\"b\": 2}\n{\"a\": 3}\n", "a");
+    EXPECT_EQ(run.output, "1\n3\n");
+    EXPECT_EQ(run.failures, 2u);
+    EXPECT_NE(run.errors.find("Line 2: JSON parsing error: "), std::string::npos);
+    EXPECT_NE(run.errors.find("Line 3: Evaluation error: Key not found: a"), std::string::npos);
+}
+
+TEST(NDJSONEvaluatorTest, KeepInputOrderAcrossBatches) {
+    // Enough records for many batches, so several workers take part
+    std::string input;
+    std::string expected;
+    for (int i = 0; i < 20000; ++i) {
+        input += "{\"id\": " + std::to_string(i) + ", \"values\": [0, " + std::to_string(i) + "]}\n";
+        expected += std::to_string(i * 2) + "\n";
+    }
+    NDJSONRun run = runNDJSON(input, "id + max(values)");
+    EXPECT_EQ(run.output, expected);
+    EXPECT_EQ(run.failures, 0u);
+}
+
+TEST(NDJSONEvaluatorTest, UnorderedOutputHasEveryResult) {
+    std::string input;
+    std::vector<std::string> expected;
+    for (int i = 0; i < 20000; ++i) {
+        input += "{\"id\": " + std::to_string(i) + "}\n";
+        expected.push_back(std::to_string(i));
+    }
+    NDJSONRun run = runNDJSON(input, "id", 4, false);
+    std::vector<std::string> lines;
+    std::istringstream stream(run.output);
+    for (std::string line; std::getline(stream, line);) {
+        lines.push_back(line);
+    }
+    std::sort(lines.begin(), lines.end());
+    std::sort(expected.begin(), expected.end());
+    EXPECT_EQ(lines, expected);
+}
+
+TEST(NDJSONEvaluatorTest, EmptyInput) {
+    NDJSONRun run = runNDJSON("", "a");
+    EXPECT_EQ(run.output, "");
+    EXPECT_EQ(run.failures, 0u);
+}
@@ -0,0 +1,122 @@
+#include "query_server.h"
+#include "gtest/gtest.h"
+#include <cstring>
+#include <fstream>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// clang-format off
+namespace {
+
+const char *document = R"({"a": {"b": [1, 2, {"c": "test"}, [11, 12]], "s": "x\ny"}})";
+
+// Sends requests over one end of a socket pair served by server on the other, and returns all responses
+std::string converse(const QueryServer &server, const std::string &requests) {
+    int fds[2];
+    EXPECT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    std::thread serving([&server, fd = fds[1]] {
+        server.serveConnection(fd, fd);
+        close(fd);
+    });
+    EXPECT_EQ(write(fds[0], requests.data(), requests.size()), static_cast<ssize_t>(requests.size()));
+    shutdown(fds[0], SHUT_WR);
+    std::string responses;
+    char buffer[4096];
+    ssize_t count;
+    while ((count = read(fds[0], buffer, sizeof(buffer))) > 0) {
+        responses.append(buffer, static_cast<size_t>(count));
+    }
+    close(fds[0]);
+    serving.join();
+    return responses;
+}
+
+}
+
+TEST(QueryServerTest, AnswerFrames) {
+    JSONValue root = JSONParser(document).parse();
+    QueryServer server(root);
+    EXPECT_EQ(server.answer("a.b[2].c"), "ok 4\ntest");
+    EXPECT_EQ(server.answer("max(a.b[3]) + 1"), "ok 2\n13");
+    EXPECT_EQ(server.answer("a.s"), "ok 3\nx\ny");
+    EXPECT_EQ(server.answer("a.missing"), "error 40\nEvaluation error: Key not found: missing");
+    EXPECT_EQ(server.answer("a.").substr(0, 32), "error 45\nExpression parsing erro");
+}
+
+TEST(QueryServerTest, AnswerOnTape) {
+    JSONTape tape = JSONTapeParser(document).parse();
+    QueryServer server(tape);
+    EXPECT_EQ(server.answer("size(a.b) * 10"), "ok 2\n40");
+}
+
+TEST(QueryServerTest, ReportCacheStats) {
+    JSONValue root = JSONParser(document).parse();
+    QueryServer server(root);
+    EXPECT_EQ(server.answer("max(a.b[3]) + 1"), "ok 2\n13");
+    EXPECT_EQ(server.answer("max(a.b[3]) + 1"), "ok 2\n13");
+    std::string stats = server.answer(":stats");
+    EXPECT_EQ(stats.rfind("ok ", 0), 0u);
+    EXPECT_NE(stats.find("hits 1 misses 2 entries 2 bytes "), std::string::npos);
+}
+
+TEST(QueryServerTest, ServeFramesAndLines) {
+    JSONValue root = JSONParser(document).parse();
+    QueryServer server(root);
+    EXPECT_EQ(converse(server, "6\na.b[0]a.b[1]\n\n3\n1+2"), "ok 1\n1ok 1\n2ok 1\n3");
+    EXPECT_EQ(converse(server, "a.b[3][1]\r\n"), "ok 2\n12");
+    EXPECT_EQ(converse(server, "10\na.b"), "error 34\nConnection closed inside a request");
+}
+
+TEST(QueryServerTest, ServeConnectionsConcurrently) {
+    JSONValue root = JSONParser(document).parse();
+    QueryServer server(root);
+    std::string requests;
+    std::string expected;
+    for (int i = 0; i < 200; ++i) {
+        requests += "min(a.b[3]) + " + std::to_string(i) + "\n";
+        expected += "ok " + std::to_string(std::to_string(11 + i).size()) + "\n" + std::to_string(11 + i);
+    }
+    std::vector<std::thread> clients;
+    std::vector<std::string> responses(8);
+    for (size_t i = 0; i < responses.size(); ++i) {
+        clients.emplace_back([&, i] { responses[i] = converse(server, requests); });
+    }
+    for (auto &client: clients) {
+        client.join();
+    }
+    for (const auto &response: responses) {
+        EXPECT_EQ(response, expected);
+    }
+}
+
+TEST(QueryServerTest, RefuseToReplaceWhatIsNotAStaleSocket) {
+    JSONValue root = JSONParser(document).parse();
+    QueryServer server(root);
+
+    std::string filePath = ::testing::TempDir() + "query_server_test.json";
+    std::ofstream(filePath) << document;
+    EXPECT_THROW(server.listen(filePath), std::runtime_error);
+    struct stat info{};
+    ASSERT_EQ(lstat(filePath.c_str(), &info), 0);
+    EXPECT_TRUE(S_ISREG(info.st_mode));
+    std::remove(filePath.c_str());
+
+    // A socket another server is listening on
+    std::string socketPath = ::testing::TempDir() + "query_server_test.sock";
+    std::remove(socketPath.c_str());
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+    int other = socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_EQ(bind(other, reinterpret_cast<const sockaddr *>(&address), sizeof(address)), 0);
+    ASSERT_EQ(::listen(other, 1), 0);
+    EXPECT_THROW(server.listen(socketPath), std::runtime_error);
+    ASSERT_EQ(lstat(socketPath.c_str(), &info), 0);
+    EXPECT_TRUE(S_ISSOCK(info.st_mode));
+    close(other);
+    std::remove(socketPath.c_str());
+}
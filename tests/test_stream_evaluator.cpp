@@ -0,0 +1,178 @@
+#include "stream_evaluator.h"
+#include "json_parser.h"
+#include "expr_parser.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <cstring>
+
+// clang-format off
+namespace {
+
+// Serves a string in chunks of at most chunkSize bytes, the way a pipe would
+class StringByteSource : public ByteSource {
+public:
+    explicit StringByteSource(std::string data, size_t chunkSize = 7) : data(std::move(data)), chunkSize(chunkSize) {}
+
+    size_t read(char *out, size_t size) override {
+        size_t count = std::min({size, chunkSize, data.size() - position});
+        std::memcpy(out, data.data() + position, count);
+        position += count;
+        return count;
+    }
+
+private:
+    std::string data;
+    size_t chunkSize;
+    size_t position = 0;
+};
+
+// Records the events as a compact string
+class RecordingHandler : public JSONHandler {
+public:
+    std::string events;
+    HandlerAction onStart = HandlerAction::Continue;
+
+    HandlerAction startObject() override { events += "{"; return onStart; }
+    HandlerAction key(std::string_view key) override { events += std::string(key) + ":"; return HandlerAction::Continue; }
+    HandlerAction endObject() override { events += "}"; return HandlerAction::Continue; }
+    HandlerAction startArray() override { events += "["; return onStart; }
+    HandlerAction endArray() override { events += "]"; return HandlerAction::Continue; }
+    HandlerAction null() override { events += "n,"; return HandlerAction::Continue; }
+    HandlerAction boolean(bool value) override { events += value ? "t," : "f,"; return HandlerAction::Continue; }
+    HandlerAction integer(int64_t value) override { events += std::to_string(value) + "i,"; return HandlerAction::Continue; }
+    HandlerAction number(double value) override { events += std::to_string(static_cast<int>(value)) + ","; return HandlerAction::Continue; }
+    HandlerAction string(std::string_view value) override { events += "'" + std::string(value) + "',"; return HandlerAction::Continue; }
+};
+
+const std::string document = "{\n"
+                             "  \"a\": {\n"
+                             "    \"b\": [1, 2, {\"c\": \"test\"}, [11, 12]],\n"
+                             "    \"samples\": [4, -2.5, 10, 7],\n"
+                             "    \"e\": \"q\\\"uote\"\n"
+                             "  },\n"
+                             "  \"meta\": {\"version\": 3, \"name\": \"x\"},\n"
+                             "  \"idx\": 1\n"
+                             "}";
+
+JSONValue evaluateStreamed(const std::string &json, const std::string &expression, size_t bufferSize = 16) {
+    ExprParser parser(expression);
+    ExprPtr expr = parser.parse();
+    StreamEvaluator evaluator(*expr);
+    StringByteSource source(json);
+    evaluator.read(source, bufferSize);
+    return evaluator.evaluate();
+}
+
+JSONValue evaluateParsed(const std::string &json, const std::string &expression) {
+    ExprParser parser(expression);
+    ExprPtr expr = parser.parse();
+    JSONValue root = JSONParser(json).parse();
+    ExprEvaluator evaluator(root);
+    expr->accept(evaluator);
+    return evaluator.result;
+}
+
+}
+
+TEST(JSONStreamReaderTest, ReportsEventsAcrossChunks) {
+    StringByteSource source("{\"k\": [true, null, \"s\\\"t\", -12, 2.5], \"o\": {}}", 3);
+    JSONStreamReader reader(source, 4);
+    RecordingHandler handler;
+    EXPECT_TRUE(reader.parse(handler));
+    EXPECT_EQ(handler.events, "{k:[t,n,'s\"t',-12i,2,]o:{}}");
+}
+
+TEST(JSONStreamReaderTest, DecodesUnicodeAcrossChunks) {
+    StringByteSource source(R"(["\u00e9\ud83d\ude00", "x\u0041"])" "[\"\xc3\xa9\"]", 3);
+    JSONStreamReader reader(source, 4);
+    RecordingHandler handler;
+    EXPECT_THROW(reader.parse(handler), std::runtime_error);
+    EXPECT_EQ(handler.events, "['\xc3\xa9\xf0\x9f\x98\x80','xA',]");
+
+    for (const std::string json : {R"(["\ud83d"])", R"(["\ud83d\n"])", "[\"\xc3\"]"}) {
+        StringByteSource bad(json, 3);
+        JSONStreamReader badReader(bad, 4);
+        EXPECT_THROW(badReader.parse(handler), std::runtime_error) << json;
+    }
+}
+
+TEST(JSONStreamReaderTest, SkipsContainers) {
+    StringByteSource source("[[1, \"]\", [2]], {\"a\": \"}\\\\\"}, 3]");
+    JSONStreamReader reader(source, 4);
+    RecordingHandler handler;
+    handler.onStart = HandlerAction::Skip;
+    EXPECT_TRUE(reader.parse(handler));
+    EXPECT_EQ(handler.events, "[");
+}
+
+TEST(JSONStreamReaderTest, RejectsMalformedInput) {
+    for (const std::string json : {"{\"a\" 1}", "[1, 2", "[1 2]", "tru", "[1] x", "{\"a\": [}"}) {
+        StringByteSource source(json);
+        JSONStreamReader reader(source, 4);
+        RecordingHandler handler;
+        EXPECT_THROW(reader.parse(handler), std::runtime_error) << json;
+    }
+}
+
+TEST(StreamEvaluatorTest, MatchesParsedEvaluation) {
+    for (const std::string expression : {"a.b[1]", "a.b[2].c", "a.b", "a.e", "a.b[a.b[1]].c", "a.b[idx]",
+                                         "min(a.samples)", "max(a.samples, 20)", "average(a.samples)",
+                                         "size(a)", "size(a.b)", "size(a.e)", "a.b[0] + size(a.samples) * 2",
+                                         "max(a.b[0], a.b[1], a.b[3])", "min(a.samples) + size(a.samples)",
+                                         "size(a.b) + a.b[0]", "min(a.b[3], a.b[3][0])", "meta",
+                                         "sum(a.samples, 1)", "count(a.b)", "variance(a.samples)",
+                                         "stddev(a.samples, a.b[3])", "median(a.samples)", "percentile(a.samples, 90)",
+                                         "approx_median(a.b, a.samples)", "approx_percentile(a.samples, 25)",
+                                         "percentile(a.samples, idx)"}) {
+        EXPECT_EQ(ExprEvaluator::jsonValueToString(evaluateStreamed(document, expression)),
+                  ExprEvaluator::jsonValueToString(evaluateParsed(document, expression))) << expression;
+    }
+}
+
+TEST(StreamEvaluatorTest, StopsOnceValuesAreKnown) {
+    std::string json = "{\"meta\": {\"version\": 7}, \"data\": [";
+    for (int i = 0; i < 10000; ++i) {
+        json += std::to_string(i) + ", ";
+    }
+    json += "0]}";
+
+    ExprParser parser("meta.version");
+    ExprPtr expr = parser.parse();
+    StreamEvaluator evaluator(*expr);
+    StringByteSource source(json, 64);
+    evaluator.read(source, 64);
+    EXPECT_TRUE(evaluator.stoppedEarly());
+    EXPECT_LE(evaluator.bytesRead(), 64u);
+    EXPECT_EQ(evaluator.evaluate().asNumber(), 7);
+}
+
+TEST(StreamEvaluatorTest, FoldsAggregatesWithoutStoringArrays) {
+    std::string json = "{\"data\": [";
+    for (int i = 0; i < 1000; ++i) {
+        json += std::to_string(i) + ", ";
+    }
+    json += "-1]}";
+    EXPECT_EQ(evaluateStreamed(json, "min(data)").asNumber(), -1);
+    EXPECT_EQ(evaluateStreamed(json, "max(data)").asNumber(), 999);
+    EXPECT_EQ(evaluateStreamed(json, "size(data)").asNumber(), 1001);
+    EXPECT_EQ(evaluateStreamed(json, "sum(data)").asInteger(), 499499);
+    EXPECT_EQ(evaluateStreamed(json, "count(data)").asInteger(), 1001);
+    EXPECT_EQ(evaluateStreamed(json, "median(data)").asNumber(), 499);
+    EXPECT_NEAR(evaluateStreamed(json, "approx_percentile(data, 99)").asNumber(), 989, 2);
+}
+
+TEST(StreamEvaluatorTest, FirstOccurrenceOfRepeatedKeyWins) {
+    EXPECT_EQ(evaluateStreamed("{\"a\": 1, \"a\": 2}", "a").asNumber(), 1);
+}
+
+TEST(StreamEvaluatorTest, ReportsErrors) {
+    EXPECT_THROW(evaluateStreamed(document, "min(a)"), std::runtime_error);
+    EXPECT_THROW(evaluateStreamed(document, "size(a.b[0])"), std::runtime_error);
+    EXPECT_THROW(evaluateStreamed(document, "average(a.e)"), std::runtime_error);
+    EXPECT_THROW(evaluateStreamed(document, "percentile(a.samples, 101)"), std::runtime_error);
+    EXPECT_THROW(evaluateStreamed(document, "stddev(a.b[2])"), std::runtime_error);
+    EXPECT_THROW(evaluateStreamed(document, "a.missing"), std::runtime_error);
+    EXPECT_THROW(evaluateStreamed(document, "size(a.missing)"), std::runtime_error);
+    EXPECT_THROW(evaluateStreamed("{\"a\": [1, 2}", "a[0] + size(a)"), std::runtime_error);
+}
+// clang-format on
@@ -0,0 +1,55 @@
+#include "thread_pool.h"
+#include "gtest/gtest.h"
+#include <stdexcept>
+
+// clang-format off
+namespace {
+
+// Sum of [begin, end) computed by splitting the range into tasks down to single elements
+long sumRange(ThreadPool &pool, long begin, long end) {
+    if (end - begin == 1) {
+        return begin;
+    }
+    long middle = begin + (end - begin) / 2;
+    auto left = pool.submit([&pool, begin, middle]() { return sumRange(pool, begin, middle); });
+    long right = sumRange(pool, middle, end);
+    return pool.wait(left) + right;
+}
+
+}
+
+TEST(ThreadPoolTest, RunSubmittedTasks) {
+    ThreadPool pool(4);
+    EXPECT_EQ(pool.concurrency(), 4u);
+    std::vector<std::future<int>> futures;
+    for (int i = 0; i < 100; ++i) {
+        futures.push_back(pool.submit([i]() { return i * i; }));
+    }
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(pool.wait(futures[i]), i * i);
+    }
+}
+
+TEST(ThreadPoolTest, NestedWaitsDoNotDeadlock) {
+    // Far more nested waits than threads: waiting parents have to run their children themselves
+    for (size_t concurrency: {1, 2, 4}) {
+        ThreadPool pool(concurrency);
+        EXPECT_EQ(sumRange(pool, 0, 1000), 999 * 1000 / 2);
+    }
+}
+
+TEST(ThreadPoolTest, WaitRethrowsTaskExceptions) {
+    ThreadPool pool(2);
+    auto future = pool.submit([]() -> int { throw std::runtime_error("task failed"); });
+    EXPECT_THROW(pool.wait(future), std::runtime_error);
+    auto next = pool.submit([]() { return 1; });
+    EXPECT_EQ(pool.wait(next), 1);
+}
+
+TEST(ThreadPoolTest, SingleThreadPoolRunsTasksOnWaiter) {
+    ThreadPool pool(1);
+    EXPECT_EQ(pool.concurrency(), 1u);
+    std::thread::id waiter = std::this_thread::get_id();
+    auto future = pool.submit([]() { return std::this_thread::get_id(); });
+    EXPECT_EQ(pool.wait(future), waiter);
+}
@@ -0,0 +1,121 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace {
+
+// Pool and queue of the worker running on this thread, if any
+thread_local ThreadPool *currentPool = nullptr;
+thread_local size_t currentQueue = 0;
+
+std::atomic<size_t> sharedConcurrency{0};
+
+}
+
+ThreadPool::ThreadPool(size_t concurrency) {
+    if (concurrency == 0) {
+        concurrency = defaultConcurrency();
+    }
+    for (size_t i = 0; i < concurrency; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (size_t i = 0; i + 1 < concurrency; ++i) {
+        workers.emplace_back([this, i]() { work(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &worker: workers) {
+        worker.join();
+    }
+}
+
+ThreadPool &ThreadPool::shared() {
+    static ThreadPool pool(sharedConcurrency.load());
+    return pool;
+}
+
+void ThreadPool::setSharedConcurrency(size_t concurrency) {
+    sharedConcurrency = concurrency;
+}
+
+size_t ThreadPool::defaultConcurrency() {
+    size_t concurrency = sharedConcurrency;
+    return concurrency != 0 ? concurrency : std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ThreadPool::push(Job job) {
+    size_t index = currentPool == this ? currentQueue : queues.size() - 1;
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->jobs.push_back([this, job = std::move(job)]() {
+            job();
+            // Waiters sleep until their task is done
+            notifyAll();
+        });
+    }
+    ++queued;
+    notifyAll();
+}
+
+bool ThreadPool::runOne() {
+    if (queued == 0) {
+        return false;
+    }
+    size_t own = currentPool == this ? currentQueue : queues.size() - 1;
+    Job job;
+    for (size_t offset = 0; offset < queues.size() && !job; ++offset) {
+        Queue &queue = *queues[(own + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty()) {
+            continue;
+        }
+        // Newest first from the own queue (its data is still warm), oldest first when stealing (the
+        // biggest pieces of work, the ones split off earliest)
+        if (offset == 0) {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+        } else {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+        }
+    }
+    if (!job) {
+        return false;
+    }
+    --queued;
+    job();
+    return true;
+}
+
+void ThreadPool::sleepUntil(const std::function<bool()> &done) {
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    // The timeout only guards against a wakeup lost between the checks and the wait
+    wake.wait_for(lock, std::chrono::milliseconds(1), [this, &done]() { return queued > 0 || done(); });
+}
+
+void ThreadPool::notifyAll() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_all();
+}
+
+void ThreadPool::work(size_t index) {
+    currentPool = this;
+    currentQueue = index;
+    while (true) {
+        if (runOne()) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this]() { return queued > 0 || stopping; });
+        if (stopping && queued == 0) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,95 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Bounded work-stealing executor. Every worker owns a deque: it pushes and pops its own tasks at the back
+// and steals from the front of the others' when it runs dry. Tasks submitted from outside the pool go to a
+// shared queue. A thread that waits for a task runs queued tasks itself instead of blocking, so a task can
+// wait for its own children without tying up a thread, and nesting never needs more threads than the pool has
+class ThreadPool {
+public:
+    // concurrency counts the waiting caller too, so concurrency - 1 workers are started.
+    // 0 uses defaultConcurrency()
+    explicit ThreadPool(size_t concurrency = 0);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    [[nodiscard]] size_t concurrency() const { return workers.size() + 1; }
+
+    template<typename Fn>
+    std::future<std::invoke_result_t<Fn>> submit(Fn &&fn) {
+        using Result = std::invoke_result_t<Fn>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<Fn>(fn));
+        std::future<Result> future = task->get_future();
+        push([task]() { (*task)(); });
+        return future;
+    }
+
+    // Result of a submitted task (rethrowing its exception). Runs queued tasks until it is ready
+    template<typename T>
+    T wait(std::future<T> &future) {
+        auto ready = [&future]() { return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready; };
+        while (!ready()) {
+            if (!runOne()) {
+                sleepUntil(ready);
+            }
+        }
+        return future.get();
+    }
+
+    // Pool shared by evaluation and parsing, created on first use
+    static ThreadPool &shared();
+
+    // Concurrency of the shared pool. Only has an effect before its first use
+    static void setSharedConcurrency(size_t concurrency);
+
+    // What setSharedConcurrency configured, std::thread::hardware_concurrency() if nothing was. Also the
+    // thread count of components that run their own threads
+    static size_t defaultConcurrency();
+
+private:
+    using Job = std::function<void()>;
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    // One per worker, then the shared queue for outside submitters
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> queued{0};
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    void push(Job job);
+
+    // Runs one queued task, preferring the calling worker's own. Returns false if there was none
+    bool runOne();
+
+    void sleepUntil(const std::function<bool()> &done);
+
+    void notifyAll();
+
+    void work(size_t index);
+};
+
+#endif // THREAD_POOL_H